@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bl/base/time.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/simulator.h>
+#include <ssc/simulation/simulation.h>
+#include <ssc/simulation/simulation_src.h>
+
+/*----------------------------------------------------------------------------*/
+/* Measures the cost of broadcasting input messages to every fiber on a group
+   and of releasing them when the fibers drop them. */
+/*----------------------------------------------------------------------------*/
+typedef struct bench {
+  bl_uword fibers;
+  bl_uword consumed;
+}
+bench;
+/*----------------------------------------------------------------------------*/
+enum {
+  bench_messages   = 2000,
+  bench_stack_size = 16 * 1024,
+};
+static const bl_uword bench_fiber_counts[] = { 1000, 10000 };
+/*----------------------------------------------------------------------------*/
+/* SIMULATION */
+/*----------------------------------------------------------------------------*/
+static void consumer_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  bench* b = (bench*) sim_context;
+  while (true) {
+    (void) ssc_peek_input_head (h);
+    ssc_drop_input_head (h);
+    ++b->consumed;
+  }
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_sim_on_setup(
+  ssc_handle h, void* simlib_passed_data, void** sim_context
+  )
+{
+  bench* b = (bench*) simlib_passed_data;
+  ssc_fiber_cfg cfg = ssc_fiber_cfg_rv (0, consumer_fiber, nullptr, nullptr, b);
+  cfg.min_stack_size = bench_stack_size;
+  for (bl_uword i = 0; i < b->fibers; ++i) {
+    bl_err err = ssc_add_fiber (h, &cfg);
+    if (err.own) {
+      return err;
+    }
+  }
+  *sim_context = b;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void ssc_sim_on_teardown (void* sim_context) {}
+/*----------------------------------------------------------------------------*/
+void ssc_sim_dealloc(
+  void const* mem, bl_uword size, ssc_group_id id, void* sim_context
+  )
+{}
+/*----------------------------------------------------------------------------*/
+/* BENCHMARK */
+/*----------------------------------------------------------------------------*/
+static void bench_run_until_consumed (ssc* sim, bench* b, bl_uword target)
+{
+  while (b->consumed < target) {
+    (void) ssc_try_run_some (sim);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bl_err bench_run (bl_uword fibers)
+{
+  bench b;
+  b.fibers   = fibers;
+  b.consumed = 0;
+
+  ssc* sim;
+  bl_err err = ssc_create (&sim, "", &b);
+  if (err.own) {
+    fprintf (stderr, "ssc_create error: %s\n", bl_strerror (err));
+    return err;
+  }
+  err = ssc_run_setup (sim);
+  if (err.own) {
+    fprintf (stderr, "ssc_run_setup error: %s\n", bl_strerror (err));
+    goto destroy;
+  }
+  /*let the fibers block on the input queue*/
+  while (ssc_try_run_some (sim).own == bl_ok) {}
+
+  bl_timept64 start = bl_timept64_get();
+  for (bl_uword i = 0; i < bench_messages; ++i) {
+    while (true) {
+      bl_u8* msg = ssc_alloc_write_bytestream (sim, 1);
+      if (!msg) {
+        err = bl_mkerr (bl_alloc);
+        goto teardown;
+      }
+      *msg = (bl_u8) i;
+      if (ssc_write (sim, 0, msg, 1).own == bl_ok) {
+        break;
+      }
+      /*input queue full, let the simulation consume*/
+      (void) ssc_try_run_some (sim);
+    }
+    /*one message at a time is the worst case for the broadcast overhead*/
+    bench_run_until_consumed (sim, &b, (i + 1) * fibers);
+  }
+  bl_timept64 elapsed = bl_timept64_get() - start;
+
+  bl_u64 ns = bl_timept64_to_nsec (elapsed);
+  printf(
+    "fibers: %6lu, messages: %6lu, total: %10.3f ms, per message: %9.3f us, "
+    "per message and fiber: %7.3f ns\n",
+    (unsigned long) fibers,
+    (unsigned long) bench_messages,
+    (double) ns / 1000000.,
+    (double) ns / (1000. * bench_messages),
+    (double) ns / ((double) bench_messages * fibers)
+    );
+teardown:
+  (void) ssc_run_teardown (sim);
+destroy:
+  (void) ssc_destroy (sim);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  for (bl_uword i = 0; i < bl_arr_elems (bench_fiber_counts); ++i) {
+    if (bench_run (bench_fiber_counts[i]).own) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
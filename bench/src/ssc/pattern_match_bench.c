@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bl/base/time.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/pattern_match.h>
+
+/*----------------------------------------------------------------------------*/
+/* Compares the input pattern matching kernels. The inputs are a mix of hits
+   and misses. Most misses on bus traffic are on the first bytes (address), so
+   the misses are placed on the first bytes with a higher probability. */
+/*----------------------------------------------------------------------------*/
+enum {
+  bench_inputs     = 4096, /*power of 2*/
+  bench_iterations = 2000 * bench_inputs,
+  bench_max_len    = 64,
+};
+static const bl_uword bench_lengths[]  = {
+  1, 2, 3, 4, 6, 8, 12, 16, 24, 31, 32, 48, 64
+};
+static const bl_uword bench_hit_pcts[] = { 1, 10, 50 };
+/*----------------------------------------------------------------------------*/
+typedef struct bench_data {
+  bl_u8 match[bench_max_len];
+  bl_u8 mask[bench_max_len];
+  bl_u8 in[bench_inputs][bench_max_len];
+}
+bench_data;
+/*----------------------------------------------------------------------------*/
+static bench_data g_data;
+/*----------------------------------------------------------------------------*/
+static void bench_data_fill (bench_data* d, bl_uword len, bl_uword hit_pct)
+{
+  for (bl_uword i = 0; i < bench_max_len; ++i) {
+    d->mask[i]  = (i == 1) ? 0xf0 : 0xff; /*a masked nibble*/
+    d->match[i] = (bl_u8) rand() & d->mask[i];
+  }
+  for (bl_uword j = 0; j < bench_inputs; ++j) {
+    memcpy (d->in[j], d->match, bench_max_len);
+    d->in[j][1] |= (bl_u8) rand() & 0x0f; /*the masked nibble is random*/
+    if ((bl_uword) (rand() % 100) < hit_pct) {
+      continue;
+    }
+    /*a miss: 3/4 of them on the first two bytes*/
+    bl_uword pos = ((rand() & 3) != 0) ? (rand() & 1) : (rand() % len);
+    pos          = bl_min (pos, len - 1);
+    d->in[j][pos] ^= (pos == 1) ? 0x10 : 0x01;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static double bench_eq (ssc_pmatch_eq_func f, bl_uword len, bl_uword* hits)
+{
+  bl_uword    h     = 0;
+  bl_timept64 start = bl_timept64_get();
+  for (bl_uword i = 0; i < bench_iterations; ++i) {
+    h += f (g_data.in[i & (bench_inputs - 1)], g_data.match, len);
+  }
+  bl_timept64 elapsed = bl_timept64_get() - start;
+  *hits = h;
+  return (double) bl_timept64_to_nsec (elapsed) / bench_iterations;
+}
+/*----------------------------------------------------------------------------*/
+static double bench_masked_eq(
+  ssc_pmatch_masked_eq_func f, bl_uword len, bl_uword* hits
+  )
+{
+  bl_uword    h     = 0;
+  bl_timept64 start = bl_timept64_get();
+  for (bl_uword i = 0; i < bench_iterations; ++i) {
+    h += f (g_data.in[i & (bench_inputs - 1)], g_data.match, g_data.mask, len);
+  }
+  bl_timept64 elapsed = bl_timept64_get() - start;
+  *hits = h;
+  return (double) bl_timept64_to_nsec (elapsed) / bench_iterations;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  ssc_pmatch_impl const* impls[] = {
+    &ssc_pmatch_portable,
+#ifdef SSC_PMATCH_X86
+    &ssc_pmatch_sse2,
+    &ssc_pmatch_avx2,
+#endif
+  };
+  ssc_pmatch_init();
+  printf ("selected implementation: %s\n", ssc_pmatch.name);
+  printf ("%-9s %4s %5s %12s %12s\n", "impl", "len", "hit%", "eq ns", "masked ns");
+
+  srand (1);
+  for (bl_uword h = 0; h < bl_arr_elems (bench_hit_pcts); ++h) {
+    for (bl_uword l = 0; l < bl_arr_elems (bench_lengths); ++l) {
+      bl_uword len = bench_lengths[l];
+      bench_data_fill (&g_data, len, bench_hit_pcts[h]);
+      bl_uword ref_hits = (bl_uword) -1;
+      bl_uword ref_mhits = (bl_uword) -1;
+
+      for (bl_uword i = 0; i < bl_arr_elems (impls); ++i) {
+        if (!ssc_pmatch_is_supported (impls[i])) {
+          continue;
+        }
+        bl_uword hits, mhits;
+        double eq_ns = bench_eq (impls[i]->eq, len, &hits);
+        double m_ns  = bench_masked_eq (impls[i]->masked_eq, len, &mhits);
+        printf(
+          "%-9s %4lu %5lu %12.3f %12.3f\n",
+          impls[i]->name,
+          (unsigned long) len,
+          (unsigned long) bench_hit_pcts[h],
+          eq_ns,
+          m_ns
+          );
+        /*all the implementations have to agree*/
+        if (ref_hits == (bl_uword) -1) {
+          ref_hits  = hits;
+          ref_mhits = mhits;
+        }
+        else if (hits != ref_hits || mhits != ref_mhits) {
+          fprintf (stderr, "%s: results mismatch\n", impls[i]->name);
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <bl/base/time.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/simulator.h>
+#include <ssc/simulation/simulation.h>
+#include <ssc/simulation/simulation_src.h>
+#include <ssc/simulator/context_switch.h>
+
+/*----------------------------------------------------------------------------*/
+/* Measures the cost of a "ssc_yield" round trip: fiber to the group
+   scheduler loop and back to the next fiber. */
+/*----------------------------------------------------------------------------*/
+typedef struct bench {
+  bl_uword fibers;
+  bl_u8    run_flags;
+  bl_uword yields;
+}
+bench;
+/*----------------------------------------------------------------------------*/
+enum {
+  bench_yields     = 4000000,
+  bench_stack_size = 16 * 1024,
+};
+static const bl_uword bench_fiber_counts[] = { 1, 16, 1024 };
+/*----------------------------------------------------------------------------*/
+/* SIMULATION */
+/*----------------------------------------------------------------------------*/
+static void yield_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  bench* b = (bench*) sim_context;
+  while (true) {
+    ssc_yield (h);
+    ++b->yields;
+  }
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_sim_on_setup(
+  ssc_handle h, void* simlib_passed_data, void** sim_context
+  )
+{
+  bench* b = (bench*) simlib_passed_data;
+  ssc_fiber_cfg cfg = ssc_fiber_cfg_rv (0, yield_fiber, nullptr, nullptr, b);
+  cfg.min_stack_size    = bench_stack_size;
+  cfg.run_cfg.run_flags = b->run_flags;
+  for (bl_uword i = 0; i < b->fibers; ++i) {
+    bl_err err = ssc_add_fiber (h, &cfg);
+    if (err.own) {
+      return err;
+    }
+  }
+  *sim_context = b;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void ssc_sim_on_teardown (void* sim_context) {}
+/*----------------------------------------------------------------------------*/
+void ssc_sim_dealloc(
+  void const* mem, bl_uword size, ssc_group_id id, void* sim_context
+  )
+{}
+/*----------------------------------------------------------------------------*/
+/* BENCHMARK */
+/*----------------------------------------------------------------------------*/
+static bl_err bench_run (bl_uword fibers, bl_u8 run_flags, char const* name)
+{
+  bench b;
+  b.fibers    = fibers;
+  b.run_flags = run_flags;
+  b.yields    = 0;
+
+  ssc* sim;
+  bl_err err = ssc_create (&sim, "", &b);
+  if (err.own) {
+    fprintf (stderr, "ssc_create error: %s\n", bl_strerror (err));
+    return err;
+  }
+  err = ssc_run_setup (sim);
+  if (err.own) {
+    fprintf (stderr, "ssc_run_setup error: %s\n", bl_strerror (err));
+    goto destroy;
+  }
+  /*warm up: every fiber started and on its yield loop*/
+  while (b.yields < fibers) {
+    (void) ssc_try_run_some (sim);
+  }
+  bl_uword    first = b.yields;
+  bl_timept64 start = bl_timept64_get();
+  while (b.yields - first < bench_yields) {
+    (void) ssc_try_run_some (sim);
+  }
+  bl_timept64 elapsed = bl_timept64_get() - start;
+  bl_uword    yields  = b.yields - first;
+
+  bl_u64 ns = bl_timept64_to_nsec (elapsed);
+  printf(
+    "%-8s %-8s fibers: %5lu, yields: %8lu, total: %9.3f ms, "
+    "per yield: %7.3f ns\n",
+    SSC_CTX_BACKEND,
+    name,
+    (unsigned long) fibers,
+    (unsigned long) yields,
+    (double) ns / 1000000.,
+    (double) ns / (double) yields
+    );
+  (void) ssc_run_teardown (sim);
+destroy:
+  (void) ssc_destroy (sim);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  for (bl_uword i = 0; i < bl_arr_elems (bench_fiber_counts); ++i) {
+    if (bench_run (bench_fiber_counts[i], 0, "regular").own) {
+      return 1;
+    }
+  }
+  for (bl_uword i = 0; i < bl_arr_elems (bench_fiber_counts); ++i) {
+    bl_u8 flags = fiber_set_shared_stack (0);
+    if (bench_run (bench_fiber_counts[i], flags, "shared").own) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bl/base/time.h>
+#include <bl/base/utility.h>
+#include <bl/base/default_allocator.h>
+#include <bl/base/flat_deadlines.h>
+
+#include <ssc/simulator/timing_wheel.h>
+
+/*----------------------------------------------------------------------------*/
+/* Compares the timing wheel used for the fiber timeouts against the sorted
+   flat array ("bl_flat_deadlines") that was used before. The fiber timeout
+   pattern is simulated: every timer is armed, half of them are cancelled and
+   rearmed (a timed read that got data) and then the time advances until every
+   timer expires. */
+/*----------------------------------------------------------------------------*/
+typedef struct flat_entry {
+  bl_timept32 time;
+  bl_uword    id;
+}
+flat_entry;
+/*----------------------------------------------------------------------------*/
+static inline bl_word flat_entry_cmp (void const* a, void const* b)
+{
+  return (bl_word) ((flat_entry const*) a)->id -
+    (bl_word) ((flat_entry const*) b)->id;
+}
+/*----------------------------------------------------------------------------*/
+bl_define_flat_deadlines_funcs (flat, flat_entry, flat_entry_cmp)
+/*----------------------------------------------------------------------------*/
+enum {
+  bench_max_timeout_us = 2000000,
+  bench_step_us        = 1000,
+  /*the flat array insertion is O(n), bigger sizes take minutes*/
+  bench_flat_max_timers = 10000,
+};
+static const bl_uword bench_timer_counts[] = { 1000, 10000, 100000 };
+/*----------------------------------------------------------------------------*/
+typedef struct bench_result {
+  double arm_ns;
+  double churn_ns;
+  double expire_ns;
+}
+bench_result;
+/*----------------------------------------------------------------------------*/
+static bl_timept32* g_deadlines;
+static bl_uword*    g_churn;
+/*----------------------------------------------------------------------------*/
+static inline double ns_per_op (bl_timept64 start, bl_uword ops)
+{
+  return (double) bl_timept64_to_nsec (bl_timept64_get() - start) / ops;
+}
+/*----------------------------------------------------------------------------*/
+static void bench_data_fill (bl_uword count, bl_timept32 now)
+{
+  for (bl_uword i = 0; i < count; ++i) {
+    g_deadlines[i] =
+      now + bl_usec_to_timept32 (1 + rand() % bench_max_timeout_us);
+    g_churn[i] = rand() % count;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bl_uword bench_twheel (bl_uword count, bl_timept32 now, bench_result* r)
+{
+  ssc_twheel* tw = (ssc_twheel*) malloc (sizeof *tw);
+  ssc_twheel_node* nodes = (ssc_twheel_node*) malloc (count * sizeof *nodes);
+  if (!tw || !nodes) {
+    free (tw);
+    free (nodes);
+    return 0;
+  }
+  ssc_twheel_init (tw, now);
+  for (bl_uword i = 0; i < count; ++i) {
+    ssc_twheel_node_init (&nodes[i]);
+  }
+  bl_timept64 start = bl_timept64_get();
+  for (bl_uword i = 0; i < count; ++i) {
+    ssc_twheel_insert (tw, &nodes[i], g_deadlines[i]);
+  }
+  r->arm_ns = ns_per_op (start, count);
+
+  start = bl_timept64_get();
+  for (bl_uword i = 0; i < count / 2; ++i) {
+    bl_uword id = g_churn[i];
+    ssc_twheel_cancel (tw, &nodes[id]);
+    ssc_twheel_insert (tw, &nodes[id], g_deadlines[i]);
+  }
+  r->churn_ns = ns_per_op (start, count / 2);
+
+  bl_uword expired = 0;
+  start = bl_timept64_get();
+  while (expired < count) {
+    now += bl_usec_to_timept32 (bench_step_us);
+    ssc_twheel_advance (tw, now);
+    while (ssc_twheel_pop_expired (tw)) {
+      ++expired;
+    }
+  }
+  r->expire_ns = ns_per_op (start, count);
+  free (nodes);
+  free (tw);
+  return expired;
+}
+/*----------------------------------------------------------------------------*/
+static bl_uword bench_flat (bl_uword count, bl_timept32 now, bench_result* r)
+{
+  bl_alloc_tbl      alloc = bl_get_default_alloc();
+  bl_flat_deadlines fd;
+  if (flat_init (&fd, now, count, &alloc).own) {
+    return 0;
+  }
+  flat_entry e;
+  bl_timept64 start = bl_timept64_get();
+  for (bl_uword i = 0; i < count; ++i) {
+    e.time = g_deadlines[i];
+    e.id   = i;
+    (void) flat_insert (&fd, &e);
+  }
+  r->arm_ns = ns_per_op (start, count);
+
+  start = bl_timept64_get();
+  for (bl_uword i = 0; i < count / 2; ++i) {
+    flat_entry match, dummy;
+    match.id = g_churn[i];
+    if (flat_try_get_and_drop (&fd, &dummy, &match)) {
+      e.time = g_deadlines[i];
+      e.id   = match.id;
+      (void) flat_insert (&fd, &e);
+    }
+  }
+  r->churn_ns = ns_per_op (start, count / 2);
+
+  bl_uword expired = 0;
+  start = bl_timept64_get();
+  while (expired < count) {
+    now += bl_usec_to_timept32 (bench_step_us);
+    while (flat_get_head_if_expired (&fd, true, now)) {
+      flat_drop_head (&fd);
+      ++expired;
+    }
+  }
+  r->expire_ns = ns_per_op (start, count);
+  flat_destroy (&fd, &alloc);
+  return expired;
+}
+/*----------------------------------------------------------------------------*/
+int main (int argc, char const* argv[])
+{
+  bl_uword max = 0;
+  for (bl_uword i = 0; i < bl_arr_elems (bench_timer_counts); ++i) {
+    max = bl_max (max, bench_timer_counts[i]);
+  }
+  g_deadlines = (bl_timept32*) malloc (max * sizeof *g_deadlines);
+  g_churn     = (bl_uword*) malloc (max * sizeof *g_churn);
+  if (!g_deadlines || !g_churn) {
+    fprintf (stderr, "allocation error\n");
+    return 1;
+  }
+  printf(
+    "%-7s %7s %10s %10s %10s\n",
+    "impl", "timers", "arm ns", "churn ns", "expire ns"
+    );
+  srand (1);
+  for (bl_uword i = 0; i < bl_arr_elems (bench_timer_counts); ++i) {
+    bl_uword     count = bench_timer_counts[i];
+    bl_timept32  now   = bl_timept32_get();
+    bench_result r;
+    bench_data_fill (count, now);
+
+    if (bench_twheel (count, now, &r) != count) {
+      fprintf (stderr, "twheel: wrong expiration count\n");
+      return 1;
+    }
+    printf(
+      "%-7s %7lu %10.1f %10.1f %10.1f\n",
+      "twheel", (unsigned long) count, r.arm_ns, r.churn_ns, r.expire_ns
+      );
+    if (count > bench_flat_max_timers) {
+      printf ("%-7s %7lu %10s\n", "flat", (unsigned long) count, "skipped");
+      continue;
+    }
+    if (bench_flat (count, now, &r) != count) {
+      fprintf (stderr, "flat: wrong expiration count\n");
+      return 1;
+    }
+    printf(
+      "%-7s %7lu %10.1f %10.1f %10.1f\n",
+      "flat", (unsigned long) count, r.arm_ns, r.churn_ns, r.expire_ns
+      );
+  }
+  free (g_churn);
+  free (g_deadlines);
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
@@ -26,7 +26,7 @@ void print_time (program* p, bl_timept32 t)
 void process_read_message (program* p, ssc_output_data* od)
 {
   print_time (p, od->time);
-  switch ((od->type & ~ssc_type_is_dynamic_mask)) {
+  switch ((od->type & ~ssc_type_flags_mask)) {
   case ssc_type_bytes: {
     bl_memr16 data = ssc_output_read_as_bytes (od);
     int ret = bl_bytes_to_hex_string(
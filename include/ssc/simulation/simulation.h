@@ -63,10 +63,37 @@ extern SSC_EXPORT
 /* ssc_add_fiber: */
 /*----------------------------------------------------------------------------*/
 static inline bl_err ssc_add_fiber (ssc_handle h, ssc_fiber_cfg const* cfg);
+/*----------------------------------------------------------------------------*/
+/* ssc_set_dealloc_batch: Optional. Replaces the "ssc_sim_dealloc" calls made
+    by "ssc_dealloc_read_data_batch" by a single call to "f" with the whole
+    array, so the simulation can free or recycle the buffers at once.
+
+    "f" receives all the entries passed to "ssc_dealloc_read_data_batch" and
+    has to deallocate the ones with "ssc_output_is_dynamic" and skip the rest.
+    It is only called if there is at least one of them. This function has to
+    be thread-safe. */
+/*----------------------------------------------------------------------------*/
+static inline bl_err ssc_set_dealloc_batch(
+  ssc_handle h, ssc_sim_dealloc_batch_func f
+  );
 /*============================================================================*/
 /* Fiber API: functions to be called inside the fiber function */
 /*============================================================================*/
 /*----------------------------------------------------------------------------*/
+/* ssc_spawn_fiber: creates a fiber at runtime on the group of the calling
+    fiber ("cfg->id" has to be that group). "cfg->min_queue_size" can't be
+    bigger than the biggest queue of the fibers added on "ssc_sim_on_setup"
+    to that group ("bl_invalid").
+
+    The "setup" function of "cfg" is called from here and "teardown" when the
+    spawned fiber finishes. The fiber starts on the next scheduler run and only
+    receives the input arriving after its creation.
+
+    The nodes and stacks of finished spawned fibers are recycled, so spawning
+    doesn't allocate after the maximum spawned fiber count is reached. */
+/*----------------------------------------------------------------------------*/
+static inline bl_err ssc_spawn_fiber (ssc_handle h, ssc_fiber_cfg const* cfg);
+/*----------------------------------------------------------------------------*/
 /* ssc_yield: yields the fiber time slice. */
 /*----------------------------------------------------------------------------*/
 static inline void ssc_yield (ssc_handle h);
@@ -136,6 +163,27 @@ static inline void ssc_produce_dynamic_string(
   ssc_handle h, char const* str, bl_uword size_incl_trail_null
   );
 /*----------------------------------------------------------------------------*/
+/* ssc_output_reserve: Returns "size" bytes of simulator owned memory to write
+    an output message into, or null if the memory arena of the group is full
+    or disabled (see "ssc_cfg.out_arena_size").
+
+    The reservation is sent with "ssc_output_commit". It is discarded if the
+    fiber reserves again or if another fiber of the group reserves, which
+    can happen when it calls a function that can context switch before
+    committing it. */
+/*----------------------------------------------------------------------------*/
+static inline void* ssc_output_reserve (ssc_handle h, bl_u16 size);
+/*----------------------------------------------------------------------------*/
+/* ssc_output_commit: Sends the first "size" bytes of the last reservation to
+    the output queue (retrieved by ssc_read) as bytes. "size" can be smaller
+    than the reserved size. Returns "bl_invalid" if the reservation was
+    discarded (see "ssc_output_reserve") or "size" is bigger than it.
+
+    There is no allocation nor "ssc_sim_dealloc(...)" call: the memory goes
+    back to the arena when the message is deallocated by the reader. */
+/*----------------------------------------------------------------------------*/
+static inline bl_err ssc_output_commit (ssc_handle h, bl_u16 size);
+/*----------------------------------------------------------------------------*/
 /*ssc_peek_input_head: peeks the input queue blocking as long as it's necessary
     until data is available. The input queue head isn't consumed. */
 /*----------------------------------------------------------------------------*/
@@ -198,6 +246,14 @@ static inline bl_memr16 ssc_timed_peek_input_head_match(
   return ssc_timed_peek_input_head_match_mask (h, match, bl_memr16_null(), us);
 }
 /*----------------------------------------------------------------------------*/
+/*ssc_set_callback_match: Stackless fibers only (see "ssc_fiber_callbacks").
+  Changes the input that the fiber waits for and its timeout. Takes effect
+  after the running callback returns.*/
+/*----------------------------------------------------------------------------*/
+static inline void ssc_set_callback_match(
+  ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+  );
+/*----------------------------------------------------------------------------*/
 /*ssc_fiber_get_run_cfg: Gets the fiber runtime parameters*/
 /*----------------------------------------------------------------------------*/
 static inline ssc_fiber_run_cfg ssc_fiber_get_run_cfg (ssc_handle h);
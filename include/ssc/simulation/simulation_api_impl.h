@@ -15,6 +15,10 @@ extern ssc_simulator_ftable ssc_sim_tbl;
 /*----------------------------------------------------------------------------*/
 #define SSC_API_INVOKE_PRIV(name) ssc_api_##name
 extern bl_err ssc_api_add_fiber (ssc_handle h, ssc_fiber_cfg const* cfg);
+extern bl_err ssc_api_set_dealloc_batch(
+  ssc_handle h, ssc_sim_dealloc_batch_func f
+  );
+extern bl_err ssc_api_spawn_fiber (ssc_handle h, ssc_fiber_cfg const* cfg);
 extern void ssc_api_yield (ssc_handle h);
 extern void ssc_api_wake (ssc_handle h, bl_uword_d2 wait_id, bl_uword_d2 count);
 extern bool ssc_api_wait (ssc_handle h, bl_uword_d2 wait_id, bl_timeoft32 us);
@@ -36,12 +40,17 @@ extern void ssc_api_produce_static_string(
 extern void ssc_api_produce_dynamic_string(
   ssc_handle h, char const* str, bl_uword size_incl_trail_null
   );
+extern void* ssc_api_output_reserve (ssc_handle h, bl_u16 size);
+extern bl_err ssc_api_output_commit (ssc_handle h, bl_u16 size);
 extern bl_memr16 ssc_api_peek_input_head_match_mask(
   ssc_handle h, bl_memr16 match, bl_memr16 mask
   );
 extern bl_memr16 ssc_api_timed_peek_input_head_match_mask(
   ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
   );
+extern void ssc_api_set_callback_match(
+  ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+  );
 extern ssc_fiber_run_cfg ssc_api_fiber_get_run_cfg (ssc_handle h);
 extern bl_err ssc_api_fiber_set_run_cfg(
   ssc_handle h, ssc_fiber_run_cfg const* c
@@ -55,6 +64,18 @@ static inline bl_err ssc_add_fiber (ssc_handle h, ssc_fiber_cfg const* cfg)
   return SSC_API_INVOKE_PRIV (add_fiber) (h, cfg);
 }
 /*----------------------------------------------------------------------------*/
+static inline bl_err ssc_set_dealloc_batch(
+  ssc_handle h, ssc_sim_dealloc_batch_func f
+  )
+{
+  return SSC_API_INVOKE_PRIV (set_dealloc_batch) (h, f);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err ssc_spawn_fiber (ssc_handle h, ssc_fiber_cfg const* cfg)
+{
+  return SSC_API_INVOKE_PRIV (spawn_fiber) (h, cfg);
+}
+/*----------------------------------------------------------------------------*/
 static inline void ssc_yield (ssc_handle h)
 {
   SSC_API_INVOKE_PRIV (yield) (h);
@@ -140,6 +161,16 @@ static inline void ssc_produce_dynamic_string(
     );
 }
 /*----------------------------------------------------------------------------*/
+static inline void* ssc_output_reserve (ssc_handle h, bl_u16 size)
+{
+  return SSC_API_INVOKE_PRIV (output_reserve) (h, size);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err ssc_output_commit (ssc_handle h, bl_u16 size)
+{
+  return SSC_API_INVOKE_PRIV (output_commit) (h, size);
+}
+/*----------------------------------------------------------------------------*/
 static inline bl_memr16 ssc_peek_input_head_match_mask(
   ssc_handle h, bl_memr16 match, bl_memr16 mask
   )
@@ -156,6 +187,13 @@ static inline bl_memr16 ssc_timed_peek_input_head_match_mask(
     );
 }
 /*----------------------------------------------------------------------------*/
+static inline void ssc_set_callback_match(
+  ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+  )
+{
+  SSC_API_INVOKE_PRIV (set_callback_match) (h, match, mask, us);
+}
+/*----------------------------------------------------------------------------*/
 static inline ssc_fiber_run_cfg ssc_fiber_get_run_cfg (ssc_handle h)
 {
   return SSC_API_INVOKE_PRIV (fiber_get_run_cfg) (h);
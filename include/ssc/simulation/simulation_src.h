@@ -23,6 +23,8 @@ void SSC_EXPORT ssc_manual_link_to_simulator(
 {
   bl_assert_always (t);
   bl_assert_always (t->add_fiber);
+  bl_assert_always (t->set_dealloc_batch);
+  bl_assert_always (t->spawn_fiber);
   bl_assert_always (t->yield);
   bl_assert_always (t->wake);
   bl_assert_always (t->wait);
@@ -38,8 +40,11 @@ void SSC_EXPORT ssc_manual_link_to_simulator(
   bl_assert_always (t->produce_error);
   bl_assert_always (t->produce_static_string);
   bl_assert_always (t->produce_dynamic_string);
+  bl_assert_always (t->output_reserve);
+  bl_assert_always (t->output_commit);
   bl_assert_always (t->consume_input_head_match_mask);
   bl_assert_always (t->timed_consume_input_head_match_mask);
+  bl_assert_always (t->set_callback_match);
   bl_assert_always (t->fiber_get_run_cfg);
   bl_assert_always (t->fiber_set_run_cfg);
   ssc_sim_tbl = *t;
@@ -12,7 +12,11 @@ typedef struct ssc_simulator_ftable {
   bl_err (*add_fiber)(
     ssc_handle h, ssc_fiber_cfg const* cfg
     );
+  bl_err (*set_dealloc_batch)(
+    ssc_handle h, ssc_sim_dealloc_batch_func f
+    );
   /*FIBER FUNCS---------------------------------------------------------------*/
+  bl_err    (*spawn_fiber)            (ssc_handle h, ssc_fiber_cfg const* cfg);
   void      (*yield)                  (ssc_handle h);
   void      (*wake)(
     ssc_handle h, bl_uword_d2 id, bl_uword_d2 cnt
@@ -38,12 +42,17 @@ typedef struct ssc_simulator_ftable {
   void      (*produce_dynamic_string)(
     ssc_handle h, char const* str, bl_uword size_incl_trail_null
     );
+  void*     (*output_reserve)         (ssc_handle h, bl_u16 size);
+  bl_err    (*output_commit)          (ssc_handle h, bl_u16 size);
   bl_memr16 (*consume_input_head_match_mask)(
     ssc_handle h, bl_memr16 match, bl_memr16 mask
     );
   bl_memr16 (*timed_consume_input_head_match_mask)(
     ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
     );
+  void      (*set_callback_match)(
+    ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+    );
   ssc_fiber_run_cfg (*fiber_get_run_cfg) (ssc_handle h);
   bl_err     (*fiber_set_run_cfg) (ssc_handle h, ssc_fiber_run_cfg const* c);
   /*--------------------------------------------------------------------------*/
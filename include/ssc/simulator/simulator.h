@@ -27,6 +27,36 @@ extern SSC_SIM_EXPORT
     char const* simlib_path,
     void*       simlib_passed_data
     );
+/*------------------------------------------------------------------------------
+  ssc_cfg_init: Initializes "cfg" to the defaults used by "ssc_create".
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  void ssc_cfg_init (ssc_cfg* cfg);
+/*------------------------------------------------------------------------------
+  ssc_create_with_cfg: "ssc_create" with non-default settings. "cfg" has to be
+    initialized with "ssc_cfg_init" before modifying it.
+
+    With "cfg->time_mode == ssc_time_virtual" the simulation runs as fast as
+    possible: the timestamps seen by the fibers, the ones of the input
+    messages and the release of delayed output messages on "ssc_read" follow
+    a virtual clock that only advances when the simulation has nothing to run.
+    "ssc_run_threads" is unsupported (returns "bl_invalid") on this mode.
+
+    With "cfg->stack_profile" set, the peak stack usage of each fiber is saved
+    to that file on "ssc_destroy", and on the next run the fiber stacks are
+    allocated to the saved size plus "cfg->stack_profile_margin" percent
+    instead of to their "min_stack_size". A code path not exercised on the
+    profiled run can still need more stack, so it is recommended to combine
+    this with lazy stacks ("ssc_fiber_lazy_stack"), whose guard page turns an
+    overflow into a crash.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_create_with_cfg(
+    ssc**          instance_out,
+    char const*    simlib_path,
+    void*          simlib_passed_data,
+    ssc_cfg const* cfg
+    );
 /*------------------------------------------------------------------------------
   ssc_destroy: Destroys a simulator instance. You may need to call
     "ssc_run_teardown(...)"  before.
@@ -49,15 +79,115 @@ extern SSC_SIM_EXPORT
 /*------------------------------------------------------------------------------
   ssc_run_some: Executes some iterations of the simulation or blocks until the
   timeout if there is nothing to do.
+
+  On virtual time mode instead of blocking it advances the clock to the next
+  fiber deadline and runs it. It only blocks when no fiber has a deadline.
 ------------------------------------------------------------------------------*/
 extern SSC_SIM_EXPORT
   bl_err ssc_run_some (ssc* sim, bl_u32 usec_timeout);
 /*------------------------------------------------------------------------------
-  ssc_run_some: Executes some iterations of the simulation. It returns
+  ssc_try_run_some: Executes some iterations of the simulation. It returns
   immediately if there is nothing to do.
+
+  On virtual time mode "nothing to do" means that no fiber is runnable and no
+  fiber has a deadline, as pending deadlines are run after advancing the
+  clock.
 ------------------------------------------------------------------------------*/
 extern SSC_SIM_EXPORT
   bl_err ssc_try_run_some (ssc* sim);
+/*------------------------------------------------------------------------------
+  ssc_get_pollfds: Returns file descriptors to drive the simulation from an
+  external event loop (e.g. epoll) without dedicated threads. Only available
+  on Linux when the instance was created with "cfg->pollable_fds", otherwise
+  it returns "bl_invalid".
+
+  "run_fd" becomes readable when "ssc_try_run_some" has something to do: new
+  input or a fiber deadline. Call it until it returns "bl_nothing_to_do".
+
+  "read_fd" becomes readable when "ssc_read" has messages to return. Call
+  "ssc_read" with a zero timeout until it returns "bl_timeout".
+
+  They are only cleared by those calls finding nothing to do, so they are
+  fine for level-triggered polling. The descriptors are owned by the
+  simulator, don't read or close them. "run_fd" isn't used with
+  "ssc_run_threads".
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_get_pollfds (ssc* sim, int* run_fd, int* read_fd);
+/*------------------------------------------------------------------------------
+  ssc_run_threads: Runs the simulation setup and starts "thread_count" worker
+  threads that run the simulation from then on. It is an alternative to calling
+  "ssc_run_setup" and then calling "ssc_run_some" from a user thread, so
+  neither "ssc_run_setup", "ssc_run_some" or "ssc_try_run_some" can be called
+  after this.
+
+  A fiber group is run from one thread at a time, so the fibers on the same
+  group don't need locking. Fibers on different groups may run in parallel. At
+  most one thread per fiber group is started.
+
+  Each group has a home thread, where it is queued when it becomes ready to
+  run. Idle threads steal ready groups from the other threads, so a group may
+  run on different threads during its lifetime.
+
+  The threads are stopped and joined by "ssc_run_teardown". If this function
+  fails when starting the threads the simulation is already set up, so
+  "ssc_run_teardown" has to be called anyways.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_run_threads (ssc* sim, bl_uword thread_count);
+/*------------------------------------------------------------------------------
+  ssc_get_worker_stats: Gets the counters of the worker thread with index
+  "worker" (0 to "thread_count - 1" of "ssc_run_threads"). Can be called from
+  any thread while the worker threads are running. Returns "bl_invalid" if
+  "ssc_run_threads" wasn't called or the index is out of range.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_get_worker_stats(
+    ssc* sim, bl_uword worker, ssc_worker_stats* stats
+    );
+/*------------------------------------------------------------------------------
+  ssc_get_bstream_pool_stats: Gets the counters of the pool behind
+  "ssc_alloc_write_bytestream". The freed input bytestreams are kept on size
+  classes (up to 4KB, including a small header) and reused by the next
+  allocations. Each class keeps up to 256KB of freed bytestreams, the rest
+  are freed ("released"). Bigger allocations always go to the allocator and
+  aren't counted. Can be called from any thread.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_get_bstream_pool_stats (ssc* sim, ssc_bstream_pool_stats* stats);
+/*------------------------------------------------------------------------------
+  ssc_get_stack_usage: Measures the peak stack usage of every fiber. Requires
+  "measure_stacks" (or "stack_profile") on "ssc_create_with_cfg", otherwise it
+  returns "bl_preconditions".
+
+  "count" is set to the total fiber count, and the first "capacity" entries
+  are written to "usage", ordered by group and then by fiber. Can't be called
+  while the "ssc_run_threads" threads are running (returns "bl_preconditions"),
+  in single threaded mode it is called from the "ssc_run_some" thread.
+
+  The spawned fibers come after the configured ones of its group. Their
+  memory is reused by the next spawns once they finish, so there is an entry
+  per spawned fiber memory block, with the peak of all the fibers that ran on
+  it. Shared stack fibers are measured each time they suspend, which makes
+  their context switches slower while measuring.
+
+  As the measurements of regular (non lazy) stacks are done by painting them
+  at creation, they are only exact below their size: a peak equal to the size
+  may be an overflow.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_get_stack_usage(
+    ssc*                   sim,
+    ssc_fiber_stack_usage* usage,
+    bl_uword               capacity,
+    bl_uword*              count
+    );
+/*------------------------------------------------------------------------------
+  ssc_get_stack_usage_stats: Sums the entries of "ssc_get_stack_usage", same
+  preconditions. Returns "bl_alloc" if the entries can't be allocated.
+------------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_get_stack_usage_stats (ssc* sim, ssc_stack_usage_stats* stats);
 /*==============================================================================
  Data exchange funcs (Thread safe)
  =============================================================================*/
@@ -68,7 +198,8 @@ extern SSC_SIM_EXPORT
   void ssc_block (ssc* sim);
 /*----------------------------------------------------------------------------*/
 /* ssc_alloc_write_bytestream: allocates memory to use with "ssc_send". Don't
-   assume any alignment. */
+   assume any alignment. The memory comes from a pool recycling the messages
+   already consumed, see "ssc_get_bstream_pool_stats". Thread-safe. */
 /*----------------------------------------------------------------------------*/
 extern SSC_SIM_EXPORT
   bl_u8* ssc_alloc_write_bytestream (ssc* sim, bl_uword capacity);
@@ -85,6 +216,86 @@ extern SSC_SIM_EXPORT
 extern SSC_SIM_EXPORT
   bl_err ssc_write (ssc* sim, ssc_group_id g, bl_u8* bytestream, bl_u16 size);
 /*----------------------------------------------------------------------------*/
+/* ssc_try_write: "ssc_write" where the caller keeps ownership of "bytestream"
+  on error, so it can be retried or sent somewhere else. It returns
+  "bl_would_overflow" when the input queue of the group is full. */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_try_write(
+    ssc* sim, ssc_group_id g, bl_u8* bytestream, bl_u16 size
+    );
+/*----------------------------------------------------------------------------*/
+/* ssc_write_timed: "ssc_write" that waits up to "timeout_us" for room when
+  the input queue of the group is full, instead of failing. The thread sleeps
+  until the group consumes its input. It returns "bl_timeout" when there is no
+  room in time.
+
+  Don't call it from the thread running "ssc_run_some" or "ssc_try_run_some":
+  the group can't consume while that thread sleeps, so a full queue always
+  times out. Use "ssc_try_write" there instead.
+
+  Same memory rules as "ssc_write": "bytestream" is freed after this call
+  (even with an error code). */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_write_timed(
+    ssc*         sim,
+    ssc_group_id g,
+    bl_u8*       bytestream,
+    bl_u16       size,
+    bl_u32       timeout_us
+    );
+/*----------------------------------------------------------------------------*/
+/* ssc_write_inline: Sends a message to a fiber group, copying "data". Unlike
+  "ssc_write" the caller keeps ownership of "data".
+
+  Messages up to "inline_input_size" (see "ssc_cfg") are copied into the slot
+  of the group input queue, so there is no allocation and the fibers read the
+  payload from the group input log itself. Bigger messages are copied to a
+  "ssc_alloc_write_bytestream" bytestream and sent with "ssc_write". */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_write_inline(
+    ssc* sim, ssc_group_id g, void const* data, bl_u16 size
+    );
+/*----------------------------------------------------------------------------*/
+/* ssc_write_batch: Sends "count" messages to a fiber group, as "count" calls
+  to "ssc_write" but cheaper: the messages get the same timestamp, take a
+  single slot on the group input queue and wake the group at most once.
+
+  "bytestreams[i]" has "sizes[i]" bytes. Same memory rules as "ssc_write":
+  all the bytestreams are freed after this call (even with an error code). */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_write_batch(
+    ssc*          sim,
+    ssc_group_id  g,
+    bl_u8* const* bytestreams,
+    bl_u16 const* sizes,
+    bl_uword      count
+    );
+/*----------------------------------------------------------------------------*/
+/* ssc_write_multicast: Sends the same message to the "gid_count" groups on
+  "gids" without copying it. The groups share the bytestream, it is
+  deallocated when the last group is done with it.
+
+  The groups are written in "gids" order, stopping on the first one that
+  can't receive it (e.g. "bl_would_overflow"), whose error is returned.
+  "sent" (can be null) gets the count of groups that received the message:
+  the first "*sent" groups on "gids". The message isn't sent to any group if
+  a group id is invalid. Same memory rules as "ssc_write", so to send to the
+  remaining groups a new bytestream has to be allocated. */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_write_multicast(
+    ssc*                sim,
+    ssc_group_id const* gids,
+    bl_uword            gid_count,
+    bl_u8*              bytestream,
+    bl_u16              size,
+    bl_uword*           sent
+    );
+/*----------------------------------------------------------------------------*/
 /* ssc_read: Reads messages from the simulation.
 
   "d" is an array of structs ssc_output_data.
@@ -94,7 +305,10 @@ extern SSC_SIM_EXPORT
   "d_consumed" contains the number of "ssc_output_data" structs retrieved
     on "d" when the function returns.
 
-  Each of the messages needs to be deallocated by "ssc_dealloc_read_data(...)"*/
+  Each of the messages needs to be deallocated by "ssc_dealloc_read_data(...)"
+
+  When the instance was created with "cfg->out_backpressure" the fibers that
+    find the output queue full wait for this function to make room.*/
 /*----------------------------------------------------------------------------*/
 extern SSC_SIM_EXPORT
   bl_err ssc_read(
@@ -108,10 +322,27 @@ extern SSC_SIM_EXPORT
 /* ssc_dealloc_read_data: Deallocates __one__ message retrieved by ssc_read.
 
    If you retrieved a bulk of them in one ssc_read call you need to deallocate
-   them individually anyways.*/
+   them individually anyways.
+
+   The messages sent with "ssc_output_commit" go back to the memory arena of
+   their group, which can't reuse the memory placed after a message that is
+   still held, so don't keep them for long.*/
 /*----------------------------------------------------------------------------*/
 extern SSC_SIM_EXPORT
   bl_err ssc_dealloc_read_data (ssc* sim, ssc_output_data* read_data);
 /*----------------------------------------------------------------------------*/
+/* ssc_dealloc_read_data_batch: Deallocates "count" messages retrieved by
+   ssc_read, e.g. a whole "ssc_read" result.
+
+   If the simulation registered a batch deallocation function (see
+   "ssc_set_dealloc_batch") the dynamic messages are deallocated with a single
+   call to it. If not, this is the same as calling "ssc_dealloc_read_data" on
+   each message. */
+/*----------------------------------------------------------------------------*/
+extern SSC_SIM_EXPORT
+  bl_err ssc_dealloc_read_data_batch(
+    ssc* sim, ssc_output_data* read_data, bl_uword count
+    );
+/*----------------------------------------------------------------------------*/
 #endif /* __SSC_SIMULATION_H__ */
 
@@ -21,11 +21,14 @@ enum ssc_out_type_e {
   ssc_type_string          = 2,
   ssc_type_error           = 3,
   ssc_type_is_dynamic_mask = 4,
+  ssc_type_is_arena_mask   = 8, /*from "ssc_output_commit"*/
+  ssc_type_flags_mask      = ssc_type_is_dynamic_mask | ssc_type_is_arena_mask,
 
   ssc_type_static_bytes   = ssc_type_bytes,
   ssc_type_dynamic_bytes  = ssc_type_bytes | ssc_type_is_dynamic_mask,
   ssc_type_static_string  = ssc_type_string,
   ssc_type_dynamic_string = ssc_type_string | ssc_type_is_dynamic_mask,
+  ssc_type_arena_bytes    = ssc_type_bytes | ssc_type_is_arena_mask,
 };
 typedef bl_u8 ssc_out_type;
 /*----------------------------------------------------------------------------*/
@@ -44,17 +47,17 @@ static inline bool ssc_output_is_dynamic (ssc_output_data const* d)
 /*----------------------------------------------------------------------------*/
 static inline bool ssc_output_is_bytes (ssc_output_data const* d)
 {
-  return (d->type & ~ssc_type_is_dynamic_mask) == ssc_type_bytes;
+  return (d->type & ~ssc_type_flags_mask) == ssc_type_bytes;
 }
 /*----------------------------------------------------------------------------*/
 static inline bool ssc_output_is_string (ssc_output_data const* d)
 {
-  return (d->type & ~ssc_type_is_dynamic_mask) == ssc_type_string;
+  return (d->type & ~ssc_type_flags_mask) == ssc_type_string;
 }
 /*----------------------------------------------------------------------------*/
 static inline bool ssc_output_is_error (ssc_output_data const* d)
 {
-  return (d->type & ~ssc_type_is_dynamic_mask) == ssc_type_error;
+  return (d->type & ~ssc_type_flags_mask) == ssc_type_error;
 }
 /*----------------------------------------------------------------------------*/
 static inline void ssc_output_read_as_error(
@@ -79,13 +82,106 @@ static inline bl_memr16 ssc_output_read_as_bytes (ssc_output_data const* d)
   return d->data;
 }
 /*----------------------------------------------------------------------------*/
+enum ssc_time_mode_e {
+  /*the simulation time follows the system clock*/
+  ssc_time_realtime = 0,
+  /*discrete event simulation: when there is nothing to run the simulation
+    time jumps to the next fiber deadline instead of waiting for it. Only for
+    single threaded mode ("ssc_run_some" and "ssc_try_run_some"). */
+  ssc_time_virtual  = 1,
+};
+typedef bl_u8 ssc_time_mode;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_cfg {
+  bl_uword      min_out_queue_size; /*messages, per fiber group*/
+  ssc_time_mode time_mode;
+  /*measure the peak stack usage of each fiber, see "ssc_get_stack_usage"*/
+  bool          measure_stacks;
+  /*file with the stack usage measured on a previous run. When set the stacks
+    are allocated with the measured size plus "stack_profile_margin" percent,
+    and the file is rewritten with this run's measurements on "ssc_destroy".
+    Implies "measure_stacks"*/
+  char const*   stack_profile;
+  bl_uword      stack_profile_margin; /*percent*/
+  /*messages written with "ssc_write_inline" up to this size are copied into
+    the slots of the group input queues instead of being allocated. Every
+    queue slot and every slot on the group input logs takes this size, so
+    keep it small. Max 240, 0 disables inline messages*/
+  bl_uword      inline_input_size;
+  /*bytes of the memory arena of each fiber group for "ssc_output_reserve".
+    Rounded up to a power of two and allocated on the first reservation of
+    the group. 0 disables it*/
+  bl_uword      out_arena_size;
+  /*no output message is dropped when the output queue is full: the fibers
+    producing to a full queue are suspended until the "ssc_read" caller makes
+    room, so a slow reader slows down the simulation. Stackless fibers can't
+    be suspended, their output is still dropped. When false the oldest
+    messages are dropped to make room instead. Unsupported on virtual time
+    mode*/
+  bool          out_backpressure;
+  /*creates the file descriptors returned by "ssc_get_pollfds"*/
+  bool          pollable_fds;
+}
+ssc_cfg;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_fiber_stack_usage {
+  ssc_group_id group;
+  /*index on the group, in "ssc_add_fiber" call order and then the spawned
+    fibers, see "ssc_get_stack_usage"*/
+  bl_uword     fiber;
+  bl_uword     size;  /*usable stack bytes*/
+  bl_uword     peak;  /*maximum bytes used*/
+}
+ssc_fiber_stack_usage;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_stack_usage_stats {
+  bl_uword fibers;    /*entries of "ssc_get_stack_usage"*/
+  bl_uword size;      /*sum of the sizes, a shared stack counts on each fiber*/
+  bl_uword peak;      /*sum of the peaks*/
+  bl_uword max_peak;  /*biggest fiber peak*/
+  bl_uword overflows; /*fibers with a peak reaching its size*/
+}
+ssc_stack_usage_stats;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_worker_stats {
+  bl_uword runs;   /*ready fiber groups run by the worker*/
+  bl_uword steals; /*fiber groups run that were taken from other worker*/
+  bl_uword idle;   /*times that the worker found nothing to run and slept*/
+}
+ssc_worker_stats;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_bstream_pool_stats {
+  bl_uword hits;     /*"ssc_alloc_write_bytestream" calls served by the pool*/
+  bl_uword misses;   /*pooled size calls that went to the allocator*/
+  bl_uword released; /*frees that went to the allocator, class full*/
+}
+ssc_bstream_pool_stats;
+/*----------------------------------------------------------------------------*/
 /* SIMULATION */
 /*----------------------------------------------------------------------------*/
 typedef void* ssc_handle;
 /*----------------------------------------------------------------------------*/
+/* deallocates the dynamic entries of an "ssc_dealloc_read_data_batch" array,
+   see "ssc_set_dealloc_batch" */
+typedef void (*ssc_sim_dealloc_batch_func)(
+  ssc_output_data const* d, bl_uword count, void* sim_context
+  );
+/*----------------------------------------------------------------------------*/
 enum ssc_run_flags_e{
   ssc_fiber_produce_only  = 0,
-  ssc_fiber_flags_biggest = ssc_fiber_produce_only /*internal use*/
+  /*the stack is address space reserved behind a guard page, memory is only
+    committed when touched and returned when the fiber finishes. Allows big
+    "min_stack_size" values on many fibers. Ignored where "mmap" isn't
+    available*/
+  ssc_fiber_lazy_stack    = 1,
+  /*the fiber runs on a stack shared by the group, only the used part of its
+    stack is kept (copied to the heap) while it is suspended. For huge fiber
+    counts with shallow stacks, at the cost of a copy on each switch. Pointers
+    to the fiber stack are only valid from the fiber itself. The shared stack
+    size is the biggest "min_stack_size" of the group's shared stack fibers.
+    Takes precedence over "ssc_fiber_lazy_stack"*/
+  ssc_fiber_shared_stack  = 2,
+  ssc_fiber_flags_biggest = ssc_fiber_shared_stack /*internal use*/
 };
 /*----------------------------------------------------------------------------*/
 static inline bool fiber_is_produce_only (bl_u8 run_flags)
@@ -100,6 +196,26 @@ static inline bl_u8 fiber_set_produce_only (bl_u8 run_flags)
   return run_flags | bl_u8_bit (ssc_fiber_produce_only);
 }
 /*----------------------------------------------------------------------------*/
+static inline bool fiber_has_lazy_stack (bl_u8 run_flags)
+{
+  return bl_u8_get_bit (run_flags, ssc_fiber_lazy_stack);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u8 fiber_set_lazy_stack (bl_u8 run_flags)
+{
+  return run_flags | bl_u8_bit (ssc_fiber_lazy_stack);
+}
+/*----------------------------------------------------------------------------*/
+static inline bool fiber_has_shared_stack (bl_u8 run_flags)
+{
+  return bl_u8_get_bit (run_flags, ssc_fiber_shared_stack);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u8 fiber_set_shared_stack (bl_u8 run_flags)
+{
+  return run_flags | bl_u8_bit (ssc_fiber_shared_stack);
+}
+/*----------------------------------------------------------------------------*/
 typedef struct ssc_fiber_run_cfg {
   bl_uword max_func_count; /*max recursion count in a time-slice*/
   bl_uword look_ahead_offset_us; /* maximum time that a time-slice can advance
@@ -131,16 +247,50 @@ typedef void (*ssc_fiber_teardown_func)(
 typedef void (*ssc_fiber_func)(
   ssc_handle ssc, void* fiber_context, void* sim_context
   );
+/*----------------------------------------------------------------------------*/
+/* Stackless (callback) fibers: fibers without a stack whose body is called
+   by the scheduler each time an input message matches, so they don't pay the
+   stack memory and the context switches. For fibers that just react to input.
+
+   The callbacks can't block: "ssc_yield", "ssc_wait" and the blocking
+   "*peek_input*" functions aren't available. The non blocking API (output,
+   "ssc_delay", "ssc_wake", "ssc_try_peek_input_head", ...) has the same
+   semantics than on regular fibers.
+
+   Returning false from a callback finishes the fiber. */
+/*----------------------------------------------------------------------------*/
+/* on_input: "in" is the input queue head, it is dropped after returning (if
+   the callback didn't drop it itself). */
+typedef bool (*ssc_fiber_on_input_func)(
+  ssc_handle ssc, bl_memr16 in, void* fiber_context, void* sim_context
+  );
+/* on_timeout: no input matched during "timeout_us" */
+typedef bool (*ssc_fiber_on_timeout_func)(
+  ssc_handle ssc, void* fiber_context, void* sim_context
+  );
 
+typedef struct ssc_fiber_callbacks {
+  ssc_fiber_on_input_func   on_input;
+  ssc_fiber_on_timeout_func on_timeout; /*optional*/
+  /*the input wanted, as on "ssc_timed_peek_input_head_match_mask". A null
+    "match" accepts any message. Can be changed from the callbacks through
+    "ssc_set_callback_match"*/
+  bl_memr16                 match;
+  bl_memr16                 mask;
+  bl_timeoft32              timeout_us; /*0: no timeout*/
+}
+ssc_fiber_callbacks;
+/*----------------------------------------------------------------------------*/
 typedef struct ssc_fiber_cfg {
   ssc_group_id            id;
-  ssc_fiber_func          fiber;
+  ssc_fiber_func          fiber; /*nullptr on stackless fibers*/
   ssc_fiber_setup_func    setup;
   ssc_fiber_teardown_func teardown;
   void*                   fiber_context;
   bl_uword                   min_stack_size; /*bytes*/
   bl_uword                   min_queue_size; /*messages*/
   ssc_fiber_run_cfg       run_cfg;
+  ssc_fiber_callbacks     callbacks; /*stackless fibers only*/
 }
 ssc_fiber_cfg;
 /*----------------------------------------------------------------------------*/
@@ -165,6 +315,30 @@ static inline ssc_fiber_cfg ssc_fiber_cfg_rv(
 #endif
   ret.min_queue_size = 128;
   ret.run_cfg        = ssc_fiber_run_cfg_rv (50, 40000, 0);
+
+  ret.callbacks.on_input   = nullptr;
+  ret.callbacks.on_timeout = nullptr;
+  ret.callbacks.match      = bl_memr16_null();
+  ret.callbacks.mask       = bl_memr16_null();
+  ret.callbacks.timeout_us = 0;
+  return ret;
+}
+/*----------------------------------------------------------------------------*/
+static inline ssc_fiber_cfg ssc_fiber_cfg_callbacks_rv(
+  ssc_group_id              id,
+  ssc_fiber_on_input_func   on_input,
+  ssc_fiber_on_timeout_func on_timeout,
+  ssc_fiber_setup_func      setup,
+  ssc_fiber_teardown_func   teardown,
+  void*                     fiber_context
+  )
+{
+  ssc_fiber_cfg ret = ssc_fiber_cfg_rv(
+    id, nullptr, setup, teardown, fiber_context
+    );
+  ret.min_stack_size       = 0;
+  ret.callbacks.on_input   = on_input;
+  ret.callbacks.on_timeout = on_timeout;
   return ret;
 }
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+
+#include <ssc/simulator/bstream_pool.h>
+
+/*----------------------------------------------------------------------------*/
+static inline bl_uword bstream_pool_class_size (bl_uword cls)
+{
+  return ((bl_uword) 1) << (cls + ssc_bstream_pool_min_size_log2);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword bstream_pool_class_of (bl_uword size)
+{
+  bl_uword cls = 0;
+  while (cls < ssc_bstream_pool_class_count &&
+    bstream_pool_class_size (cls) < size
+    ) {
+    ++cls;
+  }
+  return cls;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword bstream_pool_class_capacity (bl_uword cls)
+{
+  return ssc_bstream_pool_class_max_bytes / bstream_pool_class_size (cls);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u8** bstream_pool_link (bl_u8* block)
+{
+  return (bl_u8**) block;
+}
+/*----------------------------------------------------------------------------*/
+static void bstream_pool_list_free (bl_u8* list, bl_alloc_tbl const* alloc)
+{
+  while (list) {
+    bl_u8* next = *bstream_pool_link (list);
+    bl_dealloc (alloc, list);
+    list = next;
+  }
+}
+/*----------------------------------------------------------------------------*/
+void ssc_bstream_pool_init (ssc_bstream_pool* p, bl_alloc_tbl const* alloc)
+{
+  bl_assert (p && alloc);
+  memset (p, 0, sizeof *p);
+  p->alloc = alloc;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_bstream_pool_destroy (ssc_bstream_pool* p)
+{
+  bl_assert (p);
+  for (bl_uword i = 0; i < ssc_bstream_pool_class_count; ++i) {
+    ssc_bstream_pool_class* c = &p->cls[i];
+    bstream_pool_list_free (c->stash, p->alloc);
+    bstream_pool_list_free(
+      (bl_u8*) bl_atomic_uword_load_rlx (&c->freed), p->alloc
+      );
+    c->stash = nullptr;
+    bl_atomic_uword_store_rlx (&c->freed, 0);
+    bl_atomic_uword_store_rlx (&c->count, 0);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bl_u8* bstream_pool_class_try_pop (ssc_bstream_pool_class* c)
+{
+  if (bl_atomic_uword_load_rlx (&c->lock) != 0 ||
+    bl_atomic_uword_exchange (&c->lock, 1, bl_mo_acquire) != 0
+    ) {
+    return nullptr;
+  }
+  bl_u8* ret = c->stash;
+  if (!ret) {
+    /*taking the whole stack: no ABA, as nothing else pops from it*/
+    ret = (bl_u8*) bl_atomic_uword_exchange (&c->freed, 0, bl_mo_acquire);
+  }
+  if (ret) {
+    c->stash = *bstream_pool_link (ret);
+    bl_atomic_uword_fetch_sub (&c->count, 1, bl_mo_relaxed);
+    /*only written under the lock, no need for a read-modify-write*/
+    bl_atomic_uword_store_rlx(
+      &c->hits, bl_atomic_uword_load_rlx (&c->hits) + 1
+      );
+  }
+  bl_atomic_uword_store (&c->lock, 0, bl_mo_release);
+  return ret;
+}
+/*----------------------------------------------------------------------------*/
+bl_u8* ssc_bstream_pool_alloc (ssc_bstream_pool* p, bl_uword size, bl_u8* cls)
+{
+  bl_assert (p && cls);
+  bl_uword c = bstream_pool_class_of (size);
+  if (c == ssc_bstream_pool_class_count) {
+    *cls = ssc_bstream_pool_no_class;
+    return bl_alloc (p->alloc, size);
+  }
+  bl_u8* ret = bstream_pool_class_try_pop (&p->cls[c]);
+  if (!ret) {
+    bl_atomic_uword_fetch_add_rlx (&p->misses, 1);
+    ret = bl_alloc (p->alloc, bstream_pool_class_size (c));
+  }
+  *cls = (bl_u8) c;
+  return ret;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_bstream_pool_dealloc (ssc_bstream_pool* p, bl_u8* block, bl_u8 cls)
+{
+  bl_assert (p && block);
+  if (cls == ssc_bstream_pool_no_class) {
+    bl_dealloc (p->alloc, block);
+    return;
+  }
+  bl_assert (cls < ssc_bstream_pool_class_count);
+  ssc_bstream_pool_class* c = &p->cls[cls];
+  if (bl_atomic_uword_fetch_add_rlx (&c->count, 1) >=
+    bstream_pool_class_capacity (cls)
+    ) {
+    /*above the high-water mark*/
+    bl_atomic_uword_fetch_sub (&c->count, 1, bl_mo_relaxed);
+    bl_atomic_uword_fetch_add_rlx (&p->released, 1);
+    bl_dealloc (p->alloc, block);
+    return;
+  }
+  bl_atomic_uword* freed = &c->freed;
+  bl_uword head          = bl_atomic_uword_load_rlx (freed);
+  do {
+    *bstream_pool_link (block) = (bl_u8*) head;
+  }
+  while (!bl_atomic_uword_strong_cas(
+    freed, &head, (bl_uword) block, bl_mo_release, bl_mo_relaxed
+    ));
+}
+/*----------------------------------------------------------------------------*/
+void ssc_bstream_pool_get_stats(
+  ssc_bstream_pool* p, ssc_bstream_pool_stats* s
+  )
+{
+  bl_assert (p && s);
+  s->hits = 0;
+  for (bl_uword i = 0; i < ssc_bstream_pool_class_count; ++i) {
+    s->hits += bl_atomic_uword_load_rlx (&p->cls[i].hits);
+  }
+  s->misses   = bl_atomic_uword_load_rlx (&p->misses);
+  s->released = bl_atomic_uword_load_rlx (&p->released);
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,88 @@
+#ifndef __SSC_BSTREAM_POOL_H__
+#define __SSC_BSTREAM_POOL_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+#include <bl/base/allocator.h>
+#include <bl/base/atomic.h>
+
+#include <ssc/types.h>
+
+/*----------------------------------------------------------------------------*/
+/* A pool of power of two size classes for the input bytestreams. They are
+   allocated by the "ssc_write" threads and freed by the thread running the
+   last group consuming them, so a plain allocator pays a cross-thread
+   malloc/free per message.
+
+   Each class has a lock-free stack where the freeing threads push the blocks
+   and a stash where the allocating threads pop them from. The stash is
+   protected by a try-lock and it is refilled by taking the whole stack at
+   once, so there is no ABA problem. An allocating thread that finds the lock
+   taken or both lists empty goes to the allocator (a miss) instead of
+   waiting.
+
+   Each class keeps up to "ssc_bstream_pool_class_max_bytes" of freed blocks,
+   the blocks freed above it go back to the allocator. As the contended
+   allocations are misses, the blocks on the pool may outnumber the messages
+   in flight, the cap bounds the memory held by the pool anyways. The rest
+   are kept until "ssc_bstream_pool_destroy". Blocks bigger than the biggest
+   class bypass the pool. The first pointer of a block is used as the link
+   while it is on the pool. */
+/*----------------------------------------------------------------------------*/
+enum ssc_bstream_pool_e {
+  ssc_bstream_pool_min_size_log2   = 6, /*64*/
+  ssc_bstream_pool_class_count     = 7, /*up to 4096*/
+  ssc_bstream_pool_no_class        = 0xff,
+  ssc_bstream_pool_class_max_bytes = 256 * 1024,
+};
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_bstream_pool_class {
+  bl_atomic_uword freed; /*lock-free stack, pushed by the freeing threads*/
+  bl_atomic_uword lock;
+  bl_u8*          stash; /*protected by "lock"*/
+  bl_atomic_uword hits;  /*only written under "lock"*/
+  /*blocks on "freed" and "stash". Incremented before pushing and decremented
+    after popping, so it never is below the real count*/
+  bl_atomic_uword count;
+  /*padding to avoid false sharing between classes*/
+  bl_u8           pad[64 - (4 * sizeof (bl_atomic_uword)) - sizeof (bl_u8*)];
+}
+ssc_bstream_pool_class;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_bstream_pool {
+  ssc_bstream_pool_class cls[ssc_bstream_pool_class_count];
+  bl_atomic_uword        misses;
+  bl_atomic_uword        released;
+  bl_alloc_tbl const*    alloc;
+}
+ssc_bstream_pool;
+/*----------------------------------------------------------------------------*/
+extern void ssc_bstream_pool_init(
+  ssc_bstream_pool* p, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_bstream_pool_destroy: can only be called when no thread is using the
+   pool anymore */
+/*----------------------------------------------------------------------------*/
+extern void ssc_bstream_pool_destroy (ssc_bstream_pool* p);
+/*----------------------------------------------------------------------------*/
+/* ssc_bstream_pool_alloc: "size" is rounded up to its class size. The class
+   is written to "cls", it has to be passed back on deallocation. Thread-safe.
+   */
+/*----------------------------------------------------------------------------*/
+extern bl_u8* ssc_bstream_pool_alloc(
+  ssc_bstream_pool* p, bl_uword size, bl_u8* cls
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_bstream_pool_dealloc: Thread-safe */
+/*----------------------------------------------------------------------------*/
+extern void ssc_bstream_pool_dealloc(
+  ssc_bstream_pool* p, bl_u8* block, bl_u8 cls
+  );
+/*----------------------------------------------------------------------------*/
+extern void ssc_bstream_pool_get_stats(
+  ssc_bstream_pool* p, ssc_bstream_pool_stats* s
+  );
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_BSTREAM_POOL_H__ */
@@ -1,9 +1,18 @@
+#include <ssc/simulator/simulator.h>
 #include <ssc/simulator/cfg.h>
 
 /*----------------------------------------------------------------------------*/
-void ssc_cfg_init (ssc_cfg* cfg)
+SSC_SIM_EXPORT void ssc_cfg_init (ssc_cfg* cfg)
 {
-  cfg->min_out_queue_size = 1024;
+  cfg->min_out_queue_size   = 1024;
+  cfg->time_mode            = ssc_time_realtime;
+  cfg->measure_stacks       = false;
+  cfg->stack_profile        = nullptr;
+  cfg->stack_profile_margin = 25;
+  cfg->inline_input_size    = 0;
+  cfg->out_arena_size       = 64 * 1024;
+  cfg->out_backpressure     = false;
+  cfg->pollable_fds         = false;
 }
 /*----------------------------------------------------------------------------*/
 void ssc_fiber_group_cfg_init (ssc_fiber_group_cfg* cfg)
@@ -7,18 +7,11 @@
 
 #include <ssc/types.h>
 /*----------------------------------------------------------------------------*/
-typedef struct ssc_cfg {
-  bl_uword min_out_queue_size;
-}
-ssc_cfg;
-/*----------------------------------------------------------------------------*/
 typedef struct ssc_fiber_group_cfg {
   bl_uword min_queue_size;
 }
 ssc_fiber_group_cfg;
 /*----------------------------------------------------------------------------*/
-extern void ssc_cfg_init (ssc_cfg* cfg);
-/*----------------------------------------------------------------------------*/
 extern void ssc_fiber_group_cfg_init (ssc_fiber_group_cfg* cfg);
 /*----------------------------------------------------------------------------*/
 bl_define_dynarray_types (ssc_fiber_cfgs, ssc_fiber_cfg)
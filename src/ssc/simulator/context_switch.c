@@ -0,0 +1,145 @@
+#include <ssc/simulator/context_switch.h>
+
+#ifdef SSC_FCTX
+
+#include <bl/base/assert.h>
+
+/*----------------------------------------------------------------------------*/
+/* The suspended context stack pointer points to the saved callee-saved
+   registers, followed by the return address. A new context is a fake
+   suspended one whose return address is "ssc_fctx_entry", which calls the
+   context function with the arguments left on the saved registers. */
+/*----------------------------------------------------------------------------*/
+#if defined (__APPLE__)
+  #define FCTX_SYM(name) "_" #name
+  #define FCTX_FUNC_BEGIN(name)\
+    ".text\n"\
+    ".globl " FCTX_SYM (name) "\n"\
+    ".private_extern " FCTX_SYM (name) "\n"\
+    ".p2align 4\n"\
+    FCTX_SYM (name) ":\n"
+  #define FCTX_FUNC_END(name)
+#else
+  #define FCTX_SYM(name) #name
+  #define FCTX_FUNC_BEGIN(name)\
+    ".text\n"\
+    ".globl " FCTX_SYM (name) "\n"\
+    ".hidden " FCTX_SYM (name) "\n"\
+    ".type " FCTX_SYM (name) ", %function\n"\
+    ".p2align 4\n"\
+    FCTX_SYM (name) ":\n"
+  #define FCTX_FUNC_END(name)\
+    ".size " FCTX_SYM (name) ", .-" FCTX_SYM (name) "\n"
+#endif
+/*----------------------------------------------------------------------------*/
+extern void ssc_fctx_entry (void);
+/*----------------------------------------------------------------------------*/
+#if defined (__x86_64__)
+/*----------------------------------------------------------------------------*/
+/* callee-saved: rbp, rbx, r12-r15. "ssc_fctx_entry" gets the function on r12
+   and its argument on r13 */
+enum {
+  fctx_frame_words = 7, /*6 registers + return address*/
+  fctx_reg_func    = 3, /*r12*/
+  fctx_reg_arg     = 2, /*r13*/
+  fctx_reg_ret     = 6,
+};
+/*----------------------------------------------------------------------------*/
+__asm__(
+  FCTX_FUNC_BEGIN (ssc_fctx_transfer)
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  movq  %rsp, (%rdi)\n"
+  "  movq  (%rsi), %rsp\n"
+  "  popq  %r15\n"
+  "  popq  %r14\n"
+  "  popq  %r13\n"
+  "  popq  %r12\n"
+  "  popq  %rbx\n"
+  "  popq  %rbp\n"
+  "  ret\n"
+  FCTX_FUNC_END (ssc_fctx_transfer)
+  FCTX_FUNC_BEGIN (ssc_fctx_entry)
+  "  movq  %r13, %rdi\n"
+  "  callq *%r12\n"
+  "  ud2\n"
+  FCTX_FUNC_END (ssc_fctx_entry)
+  );
+/*----------------------------------------------------------------------------*/
+#elif defined (__aarch64__)
+/*----------------------------------------------------------------------------*/
+/* callee-saved: x19-x28, x29 (frame pointer), x30 (link register) and the low
+   halves of v8-v15. "ssc_fctx_entry" gets the function on x19 and its
+   argument on x20 */
+enum {
+  fctx_frame_words = 20, /*12 general purpose + 8 floating point registers*/
+  fctx_reg_func    = 0, /*x19*/
+  fctx_reg_arg     = 1, /*x20*/
+  fctx_reg_ret     = 11, /*x30*/
+};
+/*----------------------------------------------------------------------------*/
+__asm__(
+  FCTX_FUNC_BEGIN (ssc_fctx_transfer)
+  "  sub  sp, sp, #160\n"
+  "  stp  x19, x20, [sp, #0]\n"
+  "  stp  x21, x22, [sp, #16]\n"
+  "  stp  x23, x24, [sp, #32]\n"
+  "  stp  x25, x26, [sp, #48]\n"
+  "  stp  x27, x28, [sp, #64]\n"
+  "  stp  x29, x30, [sp, #80]\n"
+  "  stp  d8,  d9,  [sp, #96]\n"
+  "  stp  d10, d11, [sp, #112]\n"
+  "  stp  d12, d13, [sp, #128]\n"
+  "  stp  d14, d15, [sp, #144]\n"
+  "  mov  x9, sp\n"
+  "  str  x9, [x0]\n"
+  "  ldr  x9, [x1]\n"
+  "  mov  sp, x9\n"
+  "  ldp  x19, x20, [sp, #0]\n"
+  "  ldp  x21, x22, [sp, #16]\n"
+  "  ldp  x23, x24, [sp, #32]\n"
+  "  ldp  x25, x26, [sp, #48]\n"
+  "  ldp  x27, x28, [sp, #64]\n"
+  "  ldp  x29, x30, [sp, #80]\n"
+  "  ldp  d8,  d9,  [sp, #96]\n"
+  "  ldp  d10, d11, [sp, #112]\n"
+  "  ldp  d12, d13, [sp, #128]\n"
+  "  ldp  d14, d15, [sp, #144]\n"
+  "  add  sp, sp, #160\n"
+  "  ret\n"
+  FCTX_FUNC_END (ssc_fctx_transfer)
+  FCTX_FUNC_BEGIN (ssc_fctx_entry)
+  "  mov  x0, x20\n"
+  "  blr  x19\n"
+  "  brk  #0\n"
+  FCTX_FUNC_END (ssc_fctx_entry)
+  );
+/*----------------------------------------------------------------------------*/
+#endif
+/*----------------------------------------------------------------------------*/
+void ssc_ctx_create(
+  ssc_ctx* c, ssc_ctx_func f, void* arg, void* sptr, bl_uword ssze
+  )
+{
+  bl_assert (c && f && sptr);
+  /*a null fake frame on the (16 byte aligned) top for debuggers/unwinders.
+    The stack pointer is 16 byte aligned after popping the saved state*/
+  bl_uword top   = ((bl_uword) sptr + ssze) & ~((bl_uword) 15);
+  void**   frame = ((void**) (top - 16));
+  frame[0]       = nullptr;
+  frame[1]       = nullptr;
+  frame -= fctx_frame_words;
+  for (bl_uword i = 0; i < fctx_frame_words; ++i) {
+    frame[i] = nullptr;
+  }
+  frame[fctx_reg_func] = (void*) f;
+  frame[fctx_reg_arg]  = arg;
+  frame[fctx_reg_ret]  = (void*) ssc_fctx_entry;
+  c->sp                = (void*) frame;
+}
+/*----------------------------------------------------------------------------*/
+#endif /* SSC_FCTX */
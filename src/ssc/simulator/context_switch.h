@@ -0,0 +1,97 @@
+#ifndef __SSC_CONTEXT_SWITCH_H__
+#define __SSC_CONTEXT_SWITCH_H__
+
+#include <coro.h>
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+
+/*----------------------------------------------------------------------------*/
+/* The execution context switch used by the fibers. Selected at build time
+   (meson "coro_backend" option):
+
+   -"asm", "ucontext", "sjlj": the libcoro backends ("CORO_ASM",
+    "CORO_UCONTEXT" and "CORO_SJLJ").
+
+   -"fctx" ("SSC_FCTX"): a minimal switch for x86-64 (System V) and AArch64.
+    It only saves the callee-saved registers on the suspended stack and swaps
+    the stack pointers. The floating point control state (MXCSR, x87 control
+    word, FPCR) isn't switched, so fibers must not modify it.
+
+   As in libcoro, the context function can't return.
+
+   "SSC_CTX_HAS_SP" is defined on the backends that save the suspended state
+   on the suspended stack, "ssc_ctx_sp" returns its lowest address then. The
+   others keep it on "ssc_ctx", so nothing below the frame that called
+   "ssc_ctx_transfer" is live while suspended. */
+/*----------------------------------------------------------------------------*/
+typedef void (*ssc_ctx_func)(void* arg);
+/*----------------------------------------------------------------------------*/
+#ifdef SSC_FCTX
+/*----------------------------------------------------------------------------*/
+#if !(defined (__x86_64__) || defined (__aarch64__)) || defined (_WIN32)
+  #error "fctx: unsupported platform, use one of the libcoro backends"
+#endif
+#define SSC_CTX_BACKEND "fctx"
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_ctx {
+  void* sp;
+}
+ssc_ctx;
+/*----------------------------------------------------------------------------*/
+extern void ssc_ctx_create(
+  ssc_ctx* c, ssc_ctx_func f, void* arg, void* sptr, bl_uword ssze
+  );
+/*----------------------------------------------------------------------------*/
+/* implemented in assembly */
+extern void ssc_fctx_transfer (ssc_ctx* from, ssc_ctx* to);
+/*----------------------------------------------------------------------------*/
+static inline void ssc_ctx_transfer (ssc_ctx* from, ssc_ctx* to)
+{
+  ssc_fctx_transfer (from, to);
+}
+/*----------------------------------------------------------------------------*/
+#define SSC_CTX_HAS_SP 1
+static inline void* ssc_ctx_sp (ssc_ctx const* c)
+{
+  return c->sp;
+}
+/*----------------------------------------------------------------------------*/
+#else /* SSC_FCTX */
+/*----------------------------------------------------------------------------*/
+#if defined (CORO_UCONTEXT)
+  #define SSC_CTX_BACKEND "ucontext"
+#elif defined (CORO_SJLJ)
+  #define SSC_CTX_BACKEND "sjlj"
+#elif defined (CORO_ASM)
+  #define SSC_CTX_BACKEND "asm"
+#else
+  #define SSC_CTX_BACKEND "libcoro"
+#endif
+/*----------------------------------------------------------------------------*/
+typedef coro_context ssc_ctx;
+/*----------------------------------------------------------------------------*/
+static inline void ssc_ctx_create(
+  ssc_ctx* c, ssc_ctx_func f, void* arg, void* sptr, bl_uword ssze
+  )
+{
+  coro_create (c, f, arg, sptr, ssze);
+}
+/*----------------------------------------------------------------------------*/
+static inline void ssc_ctx_transfer (ssc_ctx* from, ssc_ctx* to)
+{
+  coro_transfer (from, to);
+}
+/*----------------------------------------------------------------------------*/
+#if defined (CORO_ASM)
+#define SSC_CTX_HAS_SP 1
+static inline void* ssc_ctx_sp (ssc_ctx const* c)
+{
+  return (void*) c->sp; /*the pushed registers*/
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#endif /* SSC_FCTX */
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_CONTEXT_SWITCH_H__ */
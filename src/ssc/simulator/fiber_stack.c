@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/integer_math.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/fiber_stack.h>
+
+#ifdef SSC_FIBER_STACK_LAZY
+  #include <sys/mman.h>
+  #include <unistd.h>
+
+  #if !defined (MAP_ANONYMOUS) && defined (MAP_ANON)
+    #define MAP_ANONYMOUS MAP_ANON
+  #endif
+  #ifndef MAP_NORESERVE
+    #define MAP_NORESERVE 0
+  #endif
+  #ifndef MAP_STACK
+    #define MAP_STACK 0
+  #endif
+#endif
+
+/*----------------------------------------------------------------------------*/
+enum {
+  fiber_stack_paint_byte = 0xa5,
+  fiber_stack_mincore_batch = 256, /*pages*/
+};
+/*----------------------------------------------------------------------------*/
+#ifdef SSC_FIBER_STACK_LAZY
+static bl_err fiber_stack_alloc_lazy (ssc_fiber_stack* s, bl_uword min_size)
+{
+  bl_uword page = (bl_uword) sysconf (_SC_PAGESIZE);
+  bl_uword size = bl_div_ceil (min_size, page) * page;
+  /*MAP_NORESERVE: no swap space is reserved, so big stacks don't count
+    against the overcommit limits until they are touched*/
+  void* map = mmap(
+    nullptr,
+    size + page,
+    PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+    -1,
+    0
+    );
+  if (map == MAP_FAILED) {
+    return bl_mkerr (bl_alloc);
+  }
+  if (mprotect (map, page, PROT_NONE) != 0) {
+    munmap (map, size + page);
+    return bl_mkerr (bl_alloc);
+  }
+  s->map      = map;
+  s->map_size = size + page;
+  s->sptr     = ((bl_u8*) map) + page;
+  s->ssze     = size;
+  return bl_mkok();
+}
+#endif
+/*----------------------------------------------------------------------------*/
+bl_err ssc_fiber_stack_alloc (ssc_fiber_stack* s, bl_uword min_size, bool lazy)
+{
+  bl_assert (s && min_size);
+  memset (s, 0, sizeof *s);
+#ifdef SSC_FIBER_STACK_LAZY
+  if (lazy) {
+    return fiber_stack_alloc_lazy (s, min_size);
+  }
+#else
+  (void) lazy;
+#endif
+  /*libcoro takes the size in pointer units*/
+  if (!coro_stack_alloc (&s->coro, bl_div_ceil (min_size, sizeof (void*)))) {
+    return bl_mkerr (bl_alloc);
+  }
+  s->sptr = s->coro.sptr;
+  s->ssze = s->coro.ssze;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void ssc_fiber_stack_release_pages (ssc_fiber_stack* s)
+{
+  bl_assert (s);
+#if defined (SSC_FIBER_STACK_LAZY) && defined (MADV_DONTNEED)
+  if (ssc_fiber_stack_is_lazy (s)) {
+    /*failing is harmless, the pages just stay committed*/
+    (void) madvise (s->sptr, s->ssze, MADV_DONTNEED);
+  }
+#endif
+}
+/*----------------------------------------------------------------------------*/
+void ssc_fiber_stack_free (ssc_fiber_stack* s)
+{
+  bl_assert (s);
+#ifdef SSC_FIBER_STACK_LAZY
+  if (ssc_fiber_stack_is_lazy (s)) {
+    munmap (s->map, s->map_size);
+    memset (s, 0, sizeof *s);
+    return;
+  }
+#endif
+  if (s->sptr) {
+    coro_stack_free (&s->coro);
+  }
+  memset (s, 0, sizeof *s);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_fiber_stack_paint (ssc_fiber_stack* s)
+{
+  bl_assert (s && s->sptr);
+  ssc_fiber_stack_paint_below (s, ((bl_u8 const*) s->sptr) + s->ssze);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_fiber_stack_paint_below (ssc_fiber_stack* s, void const* end)
+{
+  bl_assert (s && s->sptr);
+  bl_u8* beg = (bl_u8*) s->sptr;
+  bl_assert ((bl_u8 const*) end >= beg && (bl_u8 const*) end <= beg + s->ssze);
+  if (ssc_fiber_stack_is_lazy (s)) {
+    return;
+  }
+  memset (beg, fiber_stack_paint_byte, (bl_uword) ((bl_u8 const*) end - beg));
+  s->painted = true;
+}
+/*----------------------------------------------------------------------------*/
+#ifdef SSC_FIBER_STACK_LAZY
+static bl_uword fiber_stack_peak_lazy (ssc_fiber_stack const* s)
+{
+  /*the stack grows downwards, so the lowest resident page marks the peak*/
+  bl_uword page  = (bl_uword) sysconf (_SC_PAGESIZE);
+  bl_uword pages = s->ssze / page;
+  unsigned char vec[fiber_stack_mincore_batch];
+  for (bl_uword p = 0; p < pages; p += fiber_stack_mincore_batch) {
+    bl_uword count = bl_min (pages - p, (bl_uword) fiber_stack_mincore_batch);
+    bl_u8*   addr  = ((bl_u8*) s->sptr) + (p * page);
+    if (mincore ((void*) addr, count * page, (void*) vec) != 0) {
+      return 0;
+    }
+    for (bl_uword i = 0; i < count; ++i) {
+      if (vec[i] & 1) {
+        return s->ssze - ((p + i) * page);
+      }
+    }
+  }
+  return 0;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+bl_uword ssc_fiber_stack_peak (ssc_fiber_stack const* s)
+{
+  bl_assert (s);
+#ifdef SSC_FIBER_STACK_LAZY
+  if (ssc_fiber_stack_is_lazy (s)) {
+    return fiber_stack_peak_lazy (s);
+  }
+#endif
+  if (!s->painted) {
+    return 0;
+  }
+  bl_u8 const* beg = (bl_u8 const*) s->sptr;
+  bl_u8 const* end = beg + s->ssze;
+  bl_u8 const* p   = beg;
+  while (p < end && *p == fiber_stack_paint_byte) {
+    ++p;
+  }
+  return (bl_uword) (end - p);
+}
+/*----------------------------------------------------------------------------*/
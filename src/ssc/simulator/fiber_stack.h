@@ -0,0 +1,78 @@
+#ifndef __SSC_FIBER_STACK_H__
+#define __SSC_FIBER_STACK_H__
+
+#include <coro.h>
+
+#include <bl/base/platform.h>
+#include <bl/base/error.h>
+#include <bl/base/integer.h>
+
+/*----------------------------------------------------------------------------*/
+/* Fiber stacks. Regular stacks are allocated by libcoro.
+
+   Lazy stacks are a reservation of address space with a guard page at its
+   lowest address (stacks grow downwards). The pages are committed by the OS
+   when the fiber touches them, so the memory used scales with the real stack
+   usage instead of with "min_stack_size". An overflow hits the guard page and
+   crashes instead of silently corrupting neighbouring memory.
+
+   On platforms without "mmap" lazy stacks fall back to regular ones.
+
+   The peak usage of regular stacks can be measured by painting them with a
+   known pattern before they are used and finding how deep the pattern was
+   overwritten. Lazy stacks don't need painting (it would commit them), their
+   peak usage is the span of committed pages. */
+/*----------------------------------------------------------------------------*/
+#if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+  #define SSC_FIBER_STACK_LAZY 1
+#endif
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_fiber_stack {
+  void*             sptr; /*lowest usable address*/
+  bl_uword          ssze; /*usable bytes*/
+  void*             map;  /*lazy stacks: whole mapping, nullptr otherwise*/
+  bl_uword          map_size;
+  struct coro_stack coro; /*regular stacks*/
+  bool              painted;
+}
+ssc_fiber_stack;
+/*----------------------------------------------------------------------------*/
+/* ssc_fiber_stack_alloc: allocates at least "min_size" bytes of usable stack.
+   "lazy" requests a lazy stack, see above. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_fiber_stack_alloc(
+  ssc_fiber_stack* s, bl_uword min_size, bool lazy
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_fiber_stack_release_pages: returns the committed pages of a lazy stack
+   to the OS, keeping the reservation. The contents are lost, so it can only
+   be called on stacks that won't be run again. No-op on regular stacks. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_fiber_stack_release_pages (ssc_fiber_stack* s);
+/*----------------------------------------------------------------------------*/
+extern void ssc_fiber_stack_free (ssc_fiber_stack* s);
+/*----------------------------------------------------------------------------*/
+/* ssc_fiber_stack_paint: prepares the stack for "ssc_fiber_stack_peak". Has to
+   be called before running anything on it. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_fiber_stack_paint (ssc_fiber_stack* s);
+/*----------------------------------------------------------------------------*/
+/* ssc_fiber_stack_paint_below: paints from the lowest address up to "end"
+   (excluded). For stacks that are reused while keeping some live data on
+   them. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_fiber_stack_paint_below (ssc_fiber_stack* s, void const* end);
+/*----------------------------------------------------------------------------*/
+/* ssc_fiber_stack_peak: maximum bytes used. Page granularity on lazy stacks,
+   0 on non painted regular stacks. Lazy stacks with released pages or with
+   pages swapped out are underestimated. */
+/*----------------------------------------------------------------------------*/
+extern bl_uword ssc_fiber_stack_peak (ssc_fiber_stack const* s);
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_fiber_stack_is_lazy (ssc_fiber_stack const* s)
+{
+  return s->map != nullptr;
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_FIBER_STACK_H__ */
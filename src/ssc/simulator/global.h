@@ -1,27 +1,64 @@
 #ifndef __SSC_GLOBAL_DATA_H__
 #define __SSC_GLOBAL_DATA_H__
 
-#include <coro.h>
-
 #include <bl/base/allocator.h>
-#include <bl/task_queue/task_queue.h>
+#include <bl/base/atomic.h>
+#include <bl/base/time.h>
 
 #include <ssc/simulator/out_queue.h>
+#include <ssc/simulator/bstream_pool.h>
+#include <ssc/simulator/pollfd.h>
 
 /*----------------------------------------------------------------------------*/
 typedef struct ssc_global {
-  coro_context                                  main_coro_ctx;
-  bl_taskq*                                     tq;
   ssc_out_q                                     out_queue;
+  ssc_bstream_pool                              bstream_pool; /*input*/
   void*                                         sim_context;
   ssc_sim_dealloc_signature                     sim_dealloc;
+  ssc_sim_dealloc_batch_func                    sim_dealloc_batch; /*opt*/
 #ifdef SSC_BEFORE_FIBER_CONTEXT_SWITCH_EVT
   ssc_sim_before_fiber_context_switch_signature sim_before_fiber_context_switch;
 #endif
   bl_alloc_tbl const*                           alloc;
+  bl_uword                                      in_slot_size; /*input queue*/
+  bl_uword                                      in_inline_max; /*0: none*/
+  bl_atomic_uword                               vnow; /*virtual time clock*/
+  /*"ssc_get_pollfds". "run_waiting": the "ssc_try_run_some" caller ran out
+    of work, the group wake ups have to signal "run_poll"*/
+  ssc_pollfd                                    run_poll;
+  ssc_pollfd                                    read_poll;
+  bl_atomic_uword                               run_waiting;
+  bool                                          virtual_time;
+  bool                                          measure_stacks;
 }
 ssc_global;
 /*----------------------------------------------------------------------------*/
+/* ssc_global_now: the simulation time. On virtual time mode it is only
+   advanced by the simulator thread, but it can be read from any thread (e.g.
+   "ssc_write" and "ssc_read"). */
+/*----------------------------------------------------------------------------*/
+static inline bl_timept32 ssc_global_now (ssc_global const* g)
+{
+  if (bl_likely (!g->virtual_time)) {
+    return bl_timept32_get();
+  }
+  return (bl_timept32) bl_atomic_uword_load_rlx ((bl_atomic_uword*) &g->vnow);
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_global_wake_runner: to be called after posting work for the
+   "ssc_try_run_some" caller. Thread-safe. */
+/*----------------------------------------------------------------------------*/
+static inline void ssc_global_wake_runner (ssc_global* g)
+{
+  /*pairs with the store on "ssc_run_poll_rearm"*/
+  if (ssc_pollfd_enabled (&g->run_poll) &&
+    bl_atomic_uword_load (&g->run_waiting, bl_mo_seq_cst) &&
+    bl_atomic_uword_exchange (&g->run_waiting, 0, bl_mo_relaxed)
+    ) {
+    ssc_pollfd_signal (&g->run_poll);
+  }
+}
+/*----------------------------------------------------------------------------*/
 
 #endif /* __SSC_GLOBAL_DATA_H__ */
 
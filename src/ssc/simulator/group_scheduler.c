@@ -1,31 +1,14 @@
+#include <stddef.h>
+
 #include <bl/base/integer_math.h>
 #include <bl/base/static_integer_math.h>
 
 #include <ssc/log.h>
 #include <ssc/simulator/group_scheduler.h>
 #include <ssc/simulator/in_bstream.h>
+#include <ssc/simulator/pattern_match.h>
+#include <ssc/simulator/out_data_memory.h>
 
-/*----------------------------------------------------------------------------*/
-/* GENERIC DATA STRUCTURES */
-/*----------------------------------------------------------------------------*/
-bl_define_ringb_funcs (gsched_fiber_queue, bl_u8*);
-/*----------------------------------------------------------------------------*/
-typedef struct gsched_timed_entry {
-  bl_timept32          time;
-  gsched_timed_value value;
-}
-gsched_timed_entry;
-/*----------------------------------------------------------------------------*/
-static inline bl_word gsched_fibers_node_cmp (void const* a, void const* b)
-{
-  gsched_timed_entry const* av = (gsched_timed_entry const*) a;
-  gsched_timed_entry const* bv = (gsched_timed_entry const*) b;
-  return ((bl_word) av->value.fn) - ((bl_word) bv->value.fn);
-}
-/*----------------------------------------------------------------------------*/
-bl_define_flat_deadlines_funcs(
-  gsched_timed, gsched_timed_entry, gsched_fibers_node_cmp
-  )
 /*----------------------------------------------------------------------------*/
 /* CONSTANTS */
 /*----------------------------------------------------------------------------*/
@@ -33,6 +16,7 @@ enum gsched_queue_ids{
   q_run, /*queue for actually running fibers*/
   q_blocked, /*queue for blocked fibers*/
   q_queue, /*queue for blocked __on queue__ fibers*/
+  q_output, /*queue for fibers waiting for room on the output queue*/
   q_count,
 };
 /*----------------------------------------------------------------------------*/
@@ -41,12 +25,85 @@ enum gsched_fiber_states{
   fstate_wait, /*state for fibers waiting synchronization (wake)*/
   fstate_onqueue, /*state for fibers that consumed its queue through blocking calls*/
   fstate_timer_reschedule, /*state for fibers just rescheduled by a timer*/
+  fstate_onoutput, /*state for fibers waiting for room on the output queue*/
+  fstate_finished, /*state for fibers that returned*/
+};
+/*----------------------------------------------------------------------------*/
+enum gsched_run_states{
+  rstate_idle, /*not on any ready queue*/
+  rstate_queued, /*on a ready queue*/
+  rstate_running, /*being run by a worker*/
+  rstate_running_requeue, /*being run, became ready again while running*/
 };
 /*----------------------------------------------------------------------------*/
+enum gsched_constants {
+  /*max messages moved from the input queue to the input log at once*/
+  gsched_input_batch = 16,
+  gsched_shared_stack_copy_granularity = 256,
+};
+/*----------------------------------------------------------------------------*/
+#if defined (__GNUC__)
+  #define GSCHED_NOINLINE __attribute__ ((noinline))
+#elif defined (BL_MSC)
+  #define GSCHED_NOINLINE __declspec (noinline)
+#else
+  #define GSCHED_NOINLINE
+#endif
+/*----------------------------------------------------------------------------*/
 bl_static_assert_ns (bl_arr_elems_member (gsched, sq) == q_count);
 #define gsched_foreach_state_queue(gs, vname)\
   for (gsched_fibers* vname = &(gs)->sq[0]; vname < &(gs)->sq[q_count]; ++vname)
 /*----------------------------------------------------------------------------*/
+/* INPUT LOG */
+/*----------------------------------------------------------------------------*/
+static inline ssc_in_slot* gsched_log_slot (gsched* gs, bl_uword seq)
+{
+  bl_u8* slot = gs->log.mem + ((seq & gs->log.mask) * gs->log.stride);
+  return (ssc_in_slot*) slot;
+}
+/*----------------------------------------------------------------------------*/
+/* the slot past the end of the log, for a message consumed before knowing if
+   there is room for it (see "unhandled") */
+static inline ssc_in_slot* gsched_log_spare_slot (gsched* gs)
+{
+  return (ssc_in_slot*) (gs->log.mem + ((gs->log.mask + 1) * gs->log.stride));
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword gsched_log_free_slots (gsched* gs)
+{
+  return gs->log.mask + 1 - (gs->log.head - gs->log.tail);
+}
+/*----------------------------------------------------------------------------*/
+/* TIMERS */
+/*----------------------------------------------------------------------------*/
+static inline gsched_fibers_node* gsched_timeout_owner (ssc_twheel_node* n)
+{
+  return (gsched_fibers_node*)
+    (((bl_u8*) n) - offsetof (gsched_fibers_node, fiber.state.timeout));
+}
+/*----------------------------------------------------------------------------*/
+static gsched_wake_node* gsched_wake_node_alloc (gsched* gs)
+{
+  ssc_twheel_node* n = bl_tailq_first (&gs->free_wakes);
+  if (n) {
+    bl_tailq_remove (&gs->free_wakes, n, hook);
+    return (gsched_wake_node*) n;
+  }
+  gsched_wake_node* w = (gsched_wake_node*) bl_alloc(
+    gs->global->alloc, sizeof *w
+    );
+  if (w) {
+    ssc_twheel_node_init (&w->node);
+  }
+  return w;
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_wake_node_free (gsched* gs, gsched_wake_node* w)
+{
+  bl_assert (!ssc_twheel_node_is_armed (&w->node));
+  bl_tailq_insert_head (&gs->free_wakes, &w->node, hook);
+}
+/*----------------------------------------------------------------------------*/
 /* FIBERS */
 /*----------------------------------------------------------------------------*/
 static inline void node_queue_transfer_tail(
@@ -57,24 +114,167 @@ static inline void node_queue_transfer_tail(
   bl_tailq_insert_tail (to, n, hook);
 }
 /*----------------------------------------------------------------------------*/
+static inline bool fiber_is_stackless (gsched_fiber const* f)
+{
+  return f->cfg.fiber == nullptr;
+}
+/*----------------------------------------------------------------------------*/
+/* SHARED STACK */
+/*----------------------------------------------------------------------------*/
+#ifndef SSC_CTX_HAS_SP
+/*the frame of a non inlined callee is below the stack pointer of its caller*/
+static GSCHED_NOINLINE void shared_stack_below_caller (bl_uword* addr)
+{
+  volatile bl_u8 local = 0;
+  *addr = (bl_uword) &local;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+static void fiber_node_shared_stack_yield (gsched_fibers_node* fn)
+{
+#ifndef SSC_CTX_HAS_SP
+  /*the suspended state is on "coro_ctx", the part of the stack to save ends
+    at the frame of this function*/
+  bl_uword sp;
+  shared_stack_below_caller (&sp);
+  fn->fiber.copy.sp = (bl_u8*) bl_max(
+    sp, (bl_uword) fn->fiber.parent->shared_stack.sptr
+    );
+#endif
+  ssc_ctx_transfer(
+    &fn->fiber.coro_ctx, &fn->fiber.parent->exec->main_coro_ctx
+    );
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u8 const* fiber_stack_copy_rebase(
+  gsched_fiber const* f, bl_u8 const* ptr, bl_u8 const* top
+  )
+{
+  bl_uword p = (bl_uword) ptr;
+  if (p >= (bl_uword) f->copy.sp && p < (bl_uword) top) {
+    return f->copy.mem + (ptr - f->copy.sp);
+  }
+  return ptr;
+}
+/*----------------------------------------------------------------------------*/
+static bool gsched_shared_stack_save (gsched* gs, gsched_fiber* f)
+{
+  bl_u8* top = ((bl_u8*) gs->shared_stack.sptr) + gs->shared_stack.ssze;
+#ifdef SSC_CTX_HAS_SP
+  /*exact, the fiber is suspended*/
+  f->copy.sp = (bl_u8*) ssc_ctx_sp (&f->coro_ctx);
+#endif
+  bl_uword size = (bl_uword) (top - f->copy.sp);
+  if (size > f->copy.capacity) {
+    bl_uword capacity = gsched_shared_stack_copy_granularity *
+      bl_div_ceil (size, gsched_shared_stack_copy_granularity);
+    bl_u8* mem = (bl_u8*) bl_realloc (gs->global->alloc, f->copy.mem, capacity);
+    if (!mem) {
+      return false;
+    }
+    f->copy.mem      = mem;
+    f->copy.capacity = capacity;
+  }
+  memcpy (f->copy.mem, f->copy.sp, size);
+  f->copy.size = size;
+  if (f->state.id == fstate_onqueue) {
+    /*the scheduler matches the input against the patterns of the fibers
+      blocked on their queues, those patterns may be on their stacks*/
+    gsched_fiber_queue_read_data* qr = &f->state.params.qread;
+    qr->match = fiber_stack_copy_rebase (f, qr->match, top);
+    qr->mask  = fiber_stack_copy_rebase (f, qr->mask, top);
+  }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void fiber_function (void* arg);
+/*----------------------------------------------------------------------------*/
+/* libcoro's "coro_create" isn't thread safe on every backend (static
+   variables) and shared stack and spawned fibers are created by the worker
+   threads */
+static bl_atomic_uword gsched_coro_create_lock;
+/*----------------------------------------------------------------------------*/
+static void gsched_ctx_create(
+  gsched_fibers_node* fn, void* sptr, bl_uword ssze
+  )
+{
+  while (bl_atomic_uword_exchange(
+    &gsched_coro_create_lock, 1, bl_mo_acquire
+    )) {
+    continue;
+  }
+  ssc_ctx_create (&fn->fiber.coro_ctx, fiber_function, fn, sptr, ssze);
+  bl_atomic_uword_store (&gsched_coro_create_lock, 0, bl_mo_release);
+}
+/*----------------------------------------------------------------------------*/
+static bool gsched_shared_stack_acquire (gsched* gs, gsched_fibers_node* fn)
+{
+  gsched_fiber* f = &fn->fiber;
+  if (gs->stack_owner == f) {
+    return true;
+  }
+  if (gs->stack_owner && !gsched_shared_stack_save (gs, gs->stack_owner)) {
+    return false;
+  }
+  gs->stack_owner = f;
+  if (gs->global->measure_stacks) {
+    /*what the previous owner left below the restored part would be measured
+      as usage of this fiber, see "fiber_measure_stack"*/
+    ssc_fiber_stack_paint_below(
+      &gs->shared_stack,
+      f->copy.started ?
+        f->copy.sp :
+        ((bl_u8*) gs->shared_stack.sptr) + gs->shared_stack.ssze
+      );
+  }
+  if (f->copy.started) {
+    memcpy (f->copy.sp, f->copy.mem, f->copy.size);
+    return true;
+  }
+  /*the context can't be created before, it lives on the shared stack*/
+  gsched_ctx_create (fn, gs->shared_stack.sptr, gs->shared_stack.ssze);
+  f->copy.started = true;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_shared_stack_release (gsched* gs, gsched_fiber* f)
+{
+  if (gs->stack_owner == f) {
+    gs->stack_owner = nullptr;
+  }
+  if (f->copy.mem) {
+    bl_dealloc (gs->global->alloc, f->copy.mem);
+  }
+  memset (&f->copy, 0, sizeof f->copy);
+  f->copy.started = true; /*it can't be recreated*/
+}
+/*----------------------------------------------------------------------------*/
+/* FIBER */
+/*----------------------------------------------------------------------------*/
 static inline void fiber_node_yield_to_sched (gsched_fibers_node* fn)
 {
+  bl_assert(
+    !fiber_is_stackless (&fn->fiber) &&
+    "blocking call on a stackless fiber"
+    );
   fn->fiber.state.func_count = 0;
-  ssc_global* global         = fn->fiber.parent->global;
 #ifdef SSC_BEFORE_FIBER_CONTEXT_SWITCH_EVT
+  ssc_global* global         = fn->fiber.parent->global;
   global->sim_before_fiber_context_switch (global->sim_context);
 #endif
-  coro_transfer (&fn->fiber.coro_ctx, &global->main_coro_ctx);
+  if (fiber_has_shared_stack (fn->fiber.cfg.run_cfg.run_flags)) {
+    fiber_node_shared_stack_yield (fn);
+    return;
+  }
+  ssc_ctx_transfer(
+    &fn->fiber.coro_ctx, &fn->fiber.parent->exec->main_coro_ctx
+    );
 }
 /*----------------------------------------------------------------------------*/
 static void gsched_fiber_drop_all_input (gsched_fiber* f);
 /*----------------------------------------------------------------------------*/
-static void fiber_function (void* arg)
+static void fiber_node_finish (gsched_fibers_node* f)
 {
-  gsched_fibers_node* f = (gsched_fibers_node*) arg;
-  f->fiber.cfg.fiber(
-    f, f->fiber.cfg.context, f->fiber.parent->global->sim_context
-    );
   node_queue_transfer_tail(
     &f->fiber.parent->finished, &f->fiber.parent->sq[q_run], f
     );
@@ -86,98 +286,302 @@ static void fiber_function (void* arg)
   }
   f->fiber.parent->produce_only_fibers -= produce_only;
   --f->fiber.parent->active_fibers;
+  f->fiber.state.id = fstate_finished;
+}
+/*----------------------------------------------------------------------------*/
+static void fiber_function (void* arg)
+{
+  gsched_fibers_node* f = (gsched_fibers_node*) arg;
+  f->fiber.cfg.fiber(
+    f, f->fiber.cfg.context, f->fiber.parent->global->sim_context
+    );
+  fiber_node_finish (f);
   fiber_node_yield_to_sched (f); /*we can't return on libcoro*/
 }
 /*----------------------------------------------------------------------------*/
+static inline bool fiber_cfg_needs_stack (ssc_fiber_cfg const* cfg)
+{
+  return cfg->fiber && !fiber_has_shared_stack (cfg->run_cfg.run_flags);
+}
+/*----------------------------------------------------------------------------*/
+/* "stack": a stack to reuse (a recycled spawned fiber), nullptr allocates */
 static inline bl_err fiber_init(
-  gsched_fibers_node*  fn,
+  gsched_fibers_node*    fn,
   bl_timept32            t,
-  gsched*              parent,
-  bl_u8**              queue_mem,
-  ssc_fiber_cfg const* cfg
+  gsched*                parent,
+  ssc_fiber_cfg const*   cfg,
+  ssc_fiber_stack const* stack
   )
 {
   gsched_fiber* f = &fn->fiber;
   memset (f, 0, sizeof *f);
   f->parent        = parent;
-  bl_uword stack_size = bl_div_ceil (cfg->min_stack_size, sizeof (void*));
-  int coro_noerr   = coro_stack_alloc (&f->stack, stack_size);
-  if (!coro_noerr) {
-    return bl_mkerr (bl_alloc);
+  /*shared stack fibers are created on its first run, see
+    "gsched_shared_stack_acquire". Stackless fibers have no context*/
+  if (fiber_cfg_needs_stack (cfg)) {
+    if (stack) {
+      f->stack = *stack;
+    }
+    else {
+      bl_err err = ssc_fiber_stack_alloc(
+        &f->stack,
+        cfg->min_stack_size,
+        fiber_has_lazy_stack (cfg->run_cfg.run_flags)
+        );
+      if (err.own) {
+        return err;
+      }
+    }
+    if (parent->global->measure_stacks) {
+      ssc_fiber_stack_paint (&f->stack);
+    }
+    gsched_ctx_create (fn, f->stack.sptr, f->stack.ssze);
   }
-  coro_create(
-    &f->coro_ctx, fiber_function, fn, f->stack.sptr, stack_size
-    );
-  gsched_fiber_queue_init_extern (&f->queue, queue_mem, cfg->min_queue_size);
+  f->cursor        = 0;
+  f->queue_size    = cfg->min_queue_size;
 
-  f->cfg.fiber    = cfg->fiber;
-  f->cfg.teardown = cfg->teardown;
-  f->cfg.context  = cfg->fiber_context;
-  f->cfg.run_cfg  = cfg->run_cfg;
-  f->state.id     = fstate_run;
-  f->state.time   = t;
+  f->cfg.fiber     = cfg->fiber;
+  f->cfg.teardown  = cfg->teardown;
+  f->cfg.context   = cfg->fiber_context;
+  f->cfg.run_cfg   = cfg->run_cfg;
+  f->cfg.callbacks = cfg->callbacks;
+  f->state.id      = fstate_run;
+  f->state.time    = t;
+  ssc_twheel_node_init (&f->state.timeout);
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+static inline bl_uword gsched_fiber_input_count (gsched_fiber* f)
+{
+  /*produce only fibers don't move their cursor*/
+  if (fiber_is_produce_only (f->cfg.run_cfg.run_flags)) {
+    return 0;
+  }
+  bl_uword count = f->parent->log.head - f->cursor;
+  if (bl_unlikely (count > f->queue_size)) {
+    /*queue overflow: the oldest messages are dropped*/
+    f->cursor = f->parent->log.head - f->queue_size;
+    count     = f->queue_size;
+  }
+  return count;
+}
+/*----------------------------------------------------------------------------*/
 static void gsched_fiber_drop_input_head (gsched_fiber* f)
 {
-  if (bl_unlikely (gsched_fiber_queue_size (&f->queue) <= 0 ||
-      fiber_is_produce_only (f->cfg.run_cfg.run_flags))
-    ) {
+  if (bl_unlikely (gsched_fiber_input_count (f) == 0)) {
     bl_assert(
       !fiber_is_produce_only (f->cfg.run_cfg.run_flags) &&
       "produce only fiber is trying to drop"
       );
     return;
   }
-  bl_u8* in_bstream = *gsched_fiber_queue_at_head (&f->queue);
-  bl_u8* refc       = in_bstream_refcount (in_bstream);
-  gsched_fiber_queue_drop_head (&f->queue);
-  bl_assert (*refc > 0);
-  --*refc;
-  if (!*refc) {
-    bl_dealloc (f->parent->global->alloc, in_bstream);
-  }
+  /*reclamation is done in batch by "gsched_log_reclaim"*/
+  ++f->cursor;
 }
 /*----------------------------------------------------------------------------*/
 static void gsched_fiber_drop_all_input (gsched_fiber* f)
 {
-  while (gsched_fiber_queue_size (&f->queue) > 0) {
+  while (gsched_fiber_input_count (f) > 0) {
     gsched_fiber_drop_input_head (f);
   }
 }
 /*----------------------------------------------------------------------------*/
+/* BLOCKED ON QUEUE INDEX */
+/*----------------------------------------------------------------------------*/
+static inline gsched_fibers* gsched_qindex_list (gsched* gs, gsched_fiber* f)
+{
+  gsched_fiber_queue_read_data const* qr = &f->state.params.qread;
+  return qr->indexed ? &gs->qindex[qr->match[0]] : &gs->qscan;
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_qindex_insert (gsched* gs, gsched_fibers_node* fn)
+{
+  /*indexable when the first byte is compared entirely*/
+  gsched_fiber_queue_read_data* qr = &fn->fiber.state.params.qread;
+  qr->indexed =
+    qr->match && qr->match_size &&
+    (!qr->mask || qr->mask_size == 0 || qr->mask[0] == 0xff);
+  bl_tailq_insert_tail (gsched_qindex_list (gs, &fn->fiber), fn, qhook);
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_qindex_remove (gsched* gs, gsched_fibers_node* fn)
+{
+  bl_tailq_remove (gsched_qindex_list (gs, &fn->fiber), fn, qhook);
+  if (fn->fiber.state.params.qread.indexed) {
+    /*the index already checked and discarded the messages until here*/
+    fn->fiber.cursor = gs->log.dispatched;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_log_reclaim (gsched* gs)
+{
+  /*deallocates the messages that every consuming fiber is done with. Done
+    when the log is full instead of on each drop, so the drop path is just a
+    cursor increment and the fiber scan is amortized between many messages*/
+  bl_uword max_lag = 0;
+  gsched_fibers_node* n;
+  for (bl_uword i = 0; i < gsched_qindex_buckets; ++i) {
+    bl_tailq_foreach (n, &gs->qindex[i], qhook) {
+      /*the non dispatched messages are still needed by the indexed fibers*/
+      n->fiber.cursor = gs->log.dispatched;
+    }
+  }
+  for (bl_uword i = 0; i < q_count; ++i) {
+    bl_tailq_foreach (n, &gs->sq[i], hook) {
+      max_lag = bl_max (max_lag, gsched_fiber_input_count (&n->fiber));
+    }
+  }
+  bl_uword oldest_needed = gs->log.head - max_lag;
+  while (gs->log.tail != oldest_needed) {
+    ssc_in_slot_release(
+      gsched_log_slot (gs, gs->log.tail), &gs->global->bstream_pool
+      );
+    ++gs->log.tail;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void fiber_measure_stack (gsched_fiber* f)
+{
+  gsched* gs = f->parent;
+  if (!gs->global->measure_stacks) {
+    return;
+  }
+  if (!fiber_has_shared_stack (f->cfg.run_cfg.run_flags)) {
+    f->stack_peak = bl_max (f->stack_peak, ssc_fiber_stack_peak (&f->stack));
+    return;
+  }
+  /*the shared stack is painted when a fiber takes it, so it only shows the
+    usage of its current owner, measured after each run*/
+  if (gs->stack_owner == f) {
+    f->stack_peak = bl_max(
+      f->stack_peak, ssc_fiber_stack_peak (&gs->shared_stack)
+      );
+  }
+}
+/*----------------------------------------------------------------------------*/
 static void fiber_destroy (gsched_fiber* f)
 {
-  gsched_fiber_drop_all_input (f);
-  coro_stack_free (&f->stack);
+  /*the input log is deallocated by the group*/
+  ssc_fiber_stack_free (&f->stack);
+  gsched_shared_stack_release (f->parent, f);
 }
 /*----------------------------------------------------------------------------*/
-static void fiber_run_teardown (gsched_fiber* f)
+static void fiber_run_teardown (gsched_fiber* f, bool finished)
 {
-  while (gsched_fiber_queue_size (&f->queue) > 0) {
-    gsched_fiber_drop_input_head (f);
+  fiber_measure_stack (f);
+  if (!finished) {
+    /*finished fibers dropped its input and were out of the input log since*/
+    gsched_fiber_drop_all_input (f);
+  }
+  if (f->state.id == fstate_onoutput) {
+    /*the output that it was waiting to send is lost*/
+    ssc_out_memory_dealloc(
+      f->parent->global->sim_dealloc,
+      f->parent->global->sim_context,
+      &f->state.params.output
+      );
   }
   if (f->cfg.teardown) {
     f->cfg.teardown (f->cfg.context, f->parent->global->sim_context);
   }
 }
 /*----------------------------------------------------------------------------*/
-static inline bl_uword fibers_get_chunk_size (ssc_fiber_cfgs const* fiber_cfgs)
+/* SPAWNED FIBERS */
+/*----------------------------------------------------------------------------*/
+static bool fiber_stack_fits(
+  ssc_fiber_stack const* s, ssc_fiber_cfg const* cfg
+  )
+{
+  bool lazy = fiber_has_lazy_stack (cfg->run_cfg.run_flags);
+#ifndef SSC_FIBER_STACK_LAZY
+  lazy = false;
+#endif
+  return s->sptr &&
+    s->ssze >= cfg->min_stack_size &&
+    ssc_fiber_stack_is_lazy (s) == lazy;
+}
+/*----------------------------------------------------------------------------*/
+static gsched_fibers_node* gsched_spawn_node_get(
+  gsched* gs, ssc_fiber_cfg const* cfg, bl_err* err
+  )
+{
+  /*a recycled node with a suitable stack (or without one if not needed)*/
+  bool needs_stack = fiber_cfg_needs_stack (cfg);
+  gsched_fibers_node* fn;
+  bl_tailq_foreach (fn, &gs->spawn_pool, hook) {
+    if (needs_stack ?
+      fiber_stack_fits (&fn->fiber.stack, cfg) : !fn->fiber.stack.sptr
+      ) {
+      bl_tailq_remove (&gs->spawn_pool, fn, hook);
+      ssc_fiber_stack stack = fn->fiber.stack;
+      bl_uword stack_peak   = fn->fiber.stack_peak;
+      *err = fiber_init (fn, gs->vars.now, gs, cfg, &stack);
+      bl_assert (!err->own && "reusing a stack can't fail");
+      /*the peak is reported per node, see "gsched_get_stack_usage"*/
+      fn->fiber.stack_peak = stack_peak;
+      return fn;
+    }
+  }
+  fn = (gsched_fibers_node*) bl_alloc (gs->global->alloc, sizeof *fn);
+  if (!fn) {
+    *err = bl_mkerr (bl_alloc);
+    return nullptr;
+  }
+  *err = fiber_init (fn, gs->vars.now, gs, cfg, nullptr);
+  if (err->own) {
+    bl_dealloc (gs->global->alloc, fn);
+    return nullptr;
+  }
+  return fn;
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_spawn_node_recycle (gsched* gs, gsched_fibers_node* fn)
+{
+  /*the stack is kept, the context is recreated on reuse*/
+  ssc_fiber_stack_release_pages (&fn->fiber.stack);
+  gsched_shared_stack_release (gs, &fn->fiber);
+  bl_tailq_insert_tail (&gs->spawn_pool, fn, hook);
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_fibers_destroy (gsched_fibers* l, bl_alloc_tbl const* alloc)
 {
-  bl_uword size = 0;
+  gsched_fibers_node* fn;
+  while ((fn = bl_tailq_first (l))) {
+    bl_tailq_remove (l, fn, hook);
+    bool spawned = fn->fiber.spawned;
+    fiber_destroy (&fn->fiber);
+    if (spawned) {
+      bl_dealloc (alloc, fn);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword fibers_get_log_size (ssc_fiber_cfgs const* fiber_cfgs)
+{
+  /*a reclamation leaves at most the biggest fiber queue on the log. Twice
+    the biggest queue plus a batch of new messages leaves room for at least
+    the biggest queue plus a batch after a reclamation, so reclamations are
+    spaced*/
+  bl_uword max_queue = 0;
   for (bl_uword i = 0; i < ssc_fiber_cfgs_size (fiber_cfgs); ++i) {
-    bl_static_assert_ns_funcscope(
-      bl_next_offset_aligned_to_type (sizeof (gsched_fibers_node), bl_u8*) ==
-      sizeof (gsched_fibers_node)
+    max_queue = bl_max (
+      max_queue, ssc_fiber_cfgs_at (fiber_cfgs, i)->min_queue_size
       );
-    bl_uword fsize;
-    fsize  = sizeof (gsched_fibers_node);
-    fsize += ssc_fiber_cfgs_at (fiber_cfgs, i)->min_queue_size * sizeof (bl_u8*);
-    fsize  = bl_next_offset_aligned_to_type (fsize, gsched_fibers_node);
-    size  += fsize;
   }
-  return size;
+  return bl_round_next_pow2_u ((max_queue * 2) + gsched_input_batch);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword fibers_get_chunk_size(
+  ssc_fiber_cfgs const* fiber_cfgs, bl_uword slot_size
+  )
+{
+  bl_static_assert_ns_funcscope(
+    bl_next_offset_aligned_to_type (sizeof (gsched_fibers_node), bl_u8*) ==
+    sizeof (gsched_fibers_node)
+    );
+  /*fiber nodes followed by the input log and its spare slot*/
+  bl_uword size = ssc_fiber_cfgs_size (fiber_cfgs) * sizeof (gsched_fibers_node);
+  return size + (fibers_get_log_size (fiber_cfgs) + 1) * slot_size;
 }
 /*----------------------------------------------------------------------------*/
 static void run_wake (gsched* gs, bl_uword_d2 id, bl_uword_d2 count, bl_timept32 now)
@@ -204,21 +608,13 @@ static inline void fiber_node_program_timed(
   gsched* gs, gsched_fibers_node* n, bl_timept32 t
   )
 {
-  gsched_timed_entry e;
-  e.time     = t;
-  e.value.fn = n;
-  bl_assert (gsched_timed_can_insert (&gs->timed));
-  gsched_timed_insert (&gs->timed, &e);
+  ssc_twheel_insert (&gs->timed, &n->fiber.state.timeout, t);
 }
 /*----------------------------------------------------------------------------*/
-static inline void fiber_node_cancel_timed(
-  gsched* gs, gsched_fibers_node* n, bl_timept32 t
-  )
+static inline void fiber_node_cancel_timed (gsched* gs, gsched_fibers_node* n)
 {
-  gsched_timed_entry tv, dummy;
-  tv.time     = t;
-  tv.value.fn = n;
-  gsched_timed_try_get_and_drop (&gs->timed, &dummy, &tv);
+  /*no-op if the timer already expired*/
+  ssc_twheel_cancel (&gs->timed, &n->fiber.state.timeout);
 }
 /*----------------------------------------------------------------------------*/
 static void fiber_node_yield_until_fiber_time(
@@ -237,6 +633,9 @@ static void fiber_node_forward_progress_limit(
   gsched* gs, gsched_fibers_node* fn
   )
 {
+  if (fiber_is_stackless (&fn->fiber)) {
+    return; /*limited by the scheduler between callbacks*/
+  }
   bl_timeoft32 max_offset = bl_usec_to_timept32(
     fn->fiber.cfg.run_cfg.look_ahead_offset_us
     );
@@ -249,6 +648,62 @@ static void fiber_node_forward_progress_limit(
   ++fn->fiber.state.func_count;
 }
 /*----------------------------------------------------------------------------*/
+bl_err ssc_api_spawn_fiber (ssc_handle h, ssc_fiber_cfg const* cfg)
+{
+  gsched_fibers_node* parent = (gsched_fibers_node*) h;
+  gsched*             gs     = parent->fiber.parent;
+  bl_assert (cfg);
+
+  ssc_fiber_cfg c = *cfg;
+  bl_err err      = gsched_fiber_cfg_validate_correct (&c);
+  if (err.own) {
+    return err;
+  }
+  if (c.id != gs->gid) {
+    return bl_mkerr (bl_invalid); /*other groups may run on other threads*/
+  }
+  /*the input log was sized for the queues of the initial fibers, a bigger
+    one would break the room left after a reclamation*/
+  if (c.min_queue_size > ((gs->log.mask + 1) - gsched_input_batch) / 2) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (c.fiber && fiber_has_shared_stack (c.run_cfg.run_flags)) {
+    if (!gs->shared_stack.sptr) {
+      err = ssc_fiber_stack_alloc(
+        &gs->shared_stack, c.min_stack_size, !gs->global->measure_stacks
+        );
+      if (err.own) {
+        return err;
+      }
+    }
+    else if (gs->shared_stack.ssze < c.min_stack_size) {
+      /*can't be resized, the suspended fibers have pointers to it*/
+      return bl_mkerr (bl_invalid);
+    }
+  }
+  gsched_fibers_node* fn = gsched_spawn_node_get (gs, &c, &err);
+  if (!fn) {
+    return err;
+  }
+  fn->fiber.spawned = true;
+  if (c.setup) {
+    err = c.setup (c.fiber_context, gs->global->sim_context);
+    if (err.own) {
+      gsched_spawn_node_recycle (gs, fn);
+      return err;
+    }
+  }
+  fn->fiber.cursor = gs->log.head;
+  ++gs->active_fibers;
+  gs->produce_only_fibers +=
+    (bl_uword) fiber_is_produce_only (c.run_cfg.run_flags);
+  /*runs on this scheduler run if the caller isn't the last on the run queue,
+    otherwise the group is rescheduled because the run queue isn't empty*/
+  bl_tailq_insert_tail (&gs->sq[q_run], fn, hook);
+  fiber_node_forward_progress_limit (gs, parent);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 void ssc_api_yield (ssc_handle h)
 {
   fiber_node_yield_to_sched ((gsched_fibers_node*) h);
@@ -258,21 +713,25 @@ void ssc_api_wake (ssc_handle h, bl_uword_d2 wait_id, bl_uword_d2 count)
 {
   gsched_fibers_node* fn = (gsched_fibers_node*) h;
   gsched*             gs = fn->fiber.parent;
-  bl_timept32diff tdiff;
+  bl_timept32diff     tdiff;
+  gsched_wake_node*   w;
 retry:
   tdiff = bl_timept32_get_diff (fn->fiber.state.time, gs->vars.now);
   if (tdiff == 0) {
     run_wake (gs, wait_id, count, gs->vars.now);
   }
-  else if (gsched_timed_can_insert (&gs->future_wakes)) {
+  else if ((w = gsched_wake_node_alloc (gs))) {
     bl_assert (tdiff > 0);
-    gsched_timed_entry e;
-    e.time             = fn->fiber.state.time;
-    e.value.wake.id    = wait_id;
-    e.value.wake.count = count;
-    gsched_timed_insert (&gs->future_wakes, &e);
+    w->wake.id    = wait_id;
+    w->wake.count = count;
+    ssc_twheel_insert (&gs->future_wakes, &w->node, fn->fiber.state.time);
+  }
+  else if (fiber_is_stackless (&fn->fiber)) {
+    /*out of memory, stackless fibers can't wait: waking early*/
+    run_wake (gs, wait_id, count, gs->vars.now);
   }
   else {
+    /*out of memory, losing the lookahead*/
     fiber_node_yield_until_fiber_time (gs, fn);
     goto retry;
   }
@@ -290,16 +749,16 @@ bool ssc_api_wait (ssc_handle h, bl_uword_d2 wait_id, bl_timeoft32 us)
   node_queue_transfer_tail (&gs->sq[q_blocked], &gs->sq[q_run], fn);
 
   if (us != 0) {
-    gsched_timed_entry e;
-    e.time     = fn->fiber.state.time + bl_usec_to_timept32 (us);
-    e.value.fn = fn;
-    bl_assert_side_effect(
-      gsched_timed_insert (&fn->fiber.parent->timed, &e).own == bl_ok
+    fiber_node_program_timed(
+      gs, fn, fn->fiber.state.time + bl_usec_to_timept32 (us)
       );
   }
   fiber_node_yield_to_sched (fn);
   bool ret           = fn->fiber.state.id != fstate_timer_reschedule;
   fn->fiber.state.id = fstate_run;
+  if (ret) {
+    fiber_node_cancel_timed (gs, fn); /*woken up before the timeout*/
+  }
   return ret;
 }
 /*----------------------------------------------------------------------------*/
@@ -309,12 +768,10 @@ bl_memr16 ssc_api_try_peek_input_head (ssc_handle h)
     implementation, as it is used inside another api functions.
     */
   gsched_fibers_node* fn = (gsched_fibers_node*) h;
-  if (gsched_fiber_queue_size (&fn->fiber.queue)) {
-    bl_u8* in_bstream = *gsched_fiber_queue_at_head (&fn->fiber.queue);
-    return bl_memr16_rv(
-        in_bstream_payload (in_bstream),
-        *in_bstream_payload_size (in_bstream)
-        );
+  if (gsched_fiber_input_count (&fn->fiber)) {
+    return ssc_in_slot_payload(
+      gsched_log_slot (fn->fiber.parent, fn->fiber.cursor)
+      );
   }
   else {
     return bl_memr16_null();
@@ -336,6 +793,7 @@ bl_memr16 ssc_api_peek_input_head (ssc_handle h)
   fn->fiber.state.params.qread.mask  = nullptr;
 
   node_queue_transfer_tail (&gs->sq[q_queue], &gs->sq[q_run], fn);
+  gsched_qindex_insert (gs, fn);
   fiber_node_yield_to_sched (fn);
   /*will be rescheduled when some data is available*/
   fn->fiber.state.id = fstate_run;
@@ -358,15 +816,17 @@ bl_memr16 ssc_api_timed_peek_input_head (ssc_handle h, bl_timeoft32 us)
   fn->fiber.state.params.qread.match = nullptr;
   fn->fiber.state.params.qread.mask  = nullptr;
 
-  bl_timept32 timeout_deadline = fn->fiber.state.time + bl_usec_to_timept32 (us);
-  fiber_node_program_timed (gs, fn, timeout_deadline);
+  fiber_node_program_timed(
+    gs, fn, fn->fiber.state.time + bl_usec_to_timept32 (us)
+    );
   node_queue_transfer_tail (&gs->sq[q_queue], &gs->sq[q_run], fn);
+  gsched_qindex_insert (gs, fn);
   fiber_node_yield_to_sched (fn);
   /*will be rescheduled when some data is available or after timing out*/
   fn->fiber.state.id = fstate_run;
   ret                = ssc_api_try_peek_input_head (h);
   if (!bl_memr16_is_null (ret)) { /*no timeout: self remove from the timed queue*/
-    fiber_node_cancel_timed (gs, fn, timeout_deadline);
+    fiber_node_cancel_timed (gs, fn);
   }
   return ret;
 }
@@ -380,7 +840,11 @@ bool ssc_api_pattern_match (bl_memr16 in, bl_memr16 match)
     ) {
     return false;
   }
-  return memcmp (bl_memr16_beg (in), bl_memr16_beg (match), bl_memr16_size (match)) == 0;
+  return ssc_pmatch_eq(
+    bl_memr16_beg_as (in, bl_u8),
+    bl_memr16_beg_as (match, bl_u8),
+    bl_memr16_size (match)
+    );
 }
 /*----------------------------------------------------------------------------*/
 bool ssc_api_pattern_match_mask (bl_memr16 in, bl_memr16 match, bl_memr16 mask)
@@ -394,87 +858,20 @@ bool ssc_api_pattern_match_mask (bl_memr16 in, bl_memr16 match, bl_memr16 mask)
     ) {
     return false;
   }
+  /*the match bytes without mask are compared as-is*/
   bl_uword with_mask = bl_min (bl_memr16_size (match), bl_memr16_size (mask));
-  bl_uword align_dat = 0;
-  bl_uword align_cmp = 0;
-  bl_uword i         = 0;
-
-#if BL_WORDSIZE == 64
-  bl_uword first_run = with_mask & ~(sizeof (bl_uword) - 1);
-  while (i < first_run) {
-    ((bl_u8*) &align_dat)[0]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[0] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[0]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[1]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[1] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[1]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[2]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[2] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[2]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[3]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[3] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[3]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[4]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[4] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[4]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[5]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[5] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[5]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[6]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[6] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[6]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[7]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[7] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[7]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    if (align_dat != align_cmp) {
-      return false;
-    }
-  }
-#elif BL_WORDSIZE == 32
-  bl_uword first_run = with_mask & ~(sizeof (bl_uword) - 1);
-  while (i < first_run) {
-    ((bl_u8*) &align_dat)[0]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[0] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[0]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[1]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[1] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[1]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[2]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[2] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[2]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    ((bl_u8*) &align_dat)[3]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[3] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[3]  = *bl_memr16_at_as (match, i, bl_u8);
-    ++i;
-    if (align_dat != align_cmp) {
-      return false;
-    }
-  }
-#else
-#error "implement for the remaining platforms"
-#endif
-  for (bl_uword j = 0; i < with_mask; ++i, ++j) {
-    ((bl_u8*) &align_dat)[j]  = *bl_memr16_at_as (in, i, bl_u8);
-    ((bl_u8*) &align_dat)[j] &= *bl_memr16_at_as (mask, i, bl_u8);
-    ((bl_u8*) &align_cmp)[j]  = *bl_memr16_at_as (match, i, bl_u8);
-  }
-  if (align_dat != align_cmp) {
-    return false;
-  }
-  bl_uword with_no_mask = bl_memr16_size (match) - with_mask;
-  return with_no_mask == 0 ||
-    memcmp (bl_memr16_at (in, i), bl_memr16_at (match, i), with_no_mask) == 0;
+  return
+    ssc_pmatch_masked_eq(
+      bl_memr16_beg_as (in, bl_u8),
+      bl_memr16_beg_as (match, bl_u8),
+      bl_memr16_beg_as (mask, bl_u8),
+      with_mask
+      ) &&
+    ssc_pmatch_eq(
+      bl_memr16_at_as (in, with_mask, bl_u8),
+      bl_memr16_at_as (match, with_mask, bl_u8),
+      bl_memr16_size (match) - with_mask
+      );
 }
 /*----------------------------------------------------------------------------*/
 static bool gsched_fiber_try_peek_input_head_match_mask(
@@ -544,18 +941,29 @@ static bl_memr16 ssc_api_peek_input_head_match_mask_impl(
   fn->fiber.state.params.qread.mask       = bl_memr16_beg_as (mask, bl_u8);
   fn->fiber.state.params.qread.mask_size  = bl_memr16_size (mask);
 
-  bl_timept32 timeout_deadline;
   if (timed) {
-    timeout_deadline = fn->fiber.state.time + bl_usec_to_timept32 (us);
-    fiber_node_program_timed (gs, fn, timeout_deadline);
+    fiber_node_program_timed(
+      gs, fn, fn->fiber.state.time + bl_usec_to_timept32 (us)
+      );
   }
   node_queue_transfer_tail (&gs->sq[q_queue], &gs->sq[q_run], fn);
+  gsched_qindex_insert (gs, fn);
   fiber_node_yield_to_sched (fn);
   /*will be rescheduled when matching data is available or after timing out*/
+  bool timed_out     = fn->fiber.state.id == fstate_timer_reschedule;
   fn->fiber.state.id = fstate_run;
+  if (timed_out) {
+    /*the messages received on the same run than the timeout weren't
+      filtered*/
+    found = bl_memr16_is_null (mask) ?
+      gsched_fiber_try_peek_input_head_match (fn, match) :
+      gsched_fiber_try_peek_input_head_match_mask (fn, match, mask);
+    return found ? ssc_api_try_peek_input_head (h) : bl_memr16_null();
+  }
   ret = ssc_api_try_peek_input_head (h);
-  if (!bl_memr16_is_null (ret)) { /*no timeout: self remove from the timed queue*/
-    fiber_node_cancel_timed (gs, fn, timeout_deadline);
+  bl_assert (!bl_memr16_is_null (ret) && "critical bug or design error");
+  if (timed) { /*no timeout: self remove from the timed queue*/
+    fiber_node_cancel_timed (gs, fn);
   }
   return ret;
 }
@@ -594,6 +1002,34 @@ void ssc_api_drop_all_input(ssc_handle h)
   fiber_node_forward_progress_limit (gs, fn);
 }
 /*----------------------------------------------------------------------------*/
+static bl_err fiber_node_produce(
+  gsched* gs, gsched_fibers_node* fn, ssc_output_data* d
+  )
+{
+  ssc_out_q* q = &gs->global->out_queue;
+  bl_err err   = ssc_out_q_produce (q, d);
+  if (bl_likely (err.own != bl_would_overflow) ||
+    !ssc_out_q_has_backpressure (q) ||
+    fiber_is_stackless (&fn->fiber)
+    ) {
+    return err;
+  }
+  /*fibers ahead of the group time ("ssc_delay") can't be on the run queue,
+    the time is restored after waiting*/
+  bl_timept32 time = fn->fiber.state.time;
+  while ((err = ssc_out_q_produce_or_block (q, d)).own == bl_would_overflow) {
+    fn->fiber.state.id            = fstate_onoutput;
+    fn->fiber.state.params.output = *d;
+    fn->fiber.state.time          = gs->vars.now;
+    node_queue_transfer_tail (&gs->sq[q_output], &gs->sq[q_run], fn);
+    fiber_node_yield_to_sched (fn);
+    bl_assert (fn->fiber.state.id == fstate_onoutput);
+    fn->fiber.state.id = fstate_run;
+  }
+  fn->fiber.state.time = bl_timept32_max (fn->fiber.state.time, time);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
 void ssc_api_produce_error(
   ssc_handle h, bl_err err, char const* static_string
   )
@@ -607,7 +1043,7 @@ void ssc_api_produce_error(
   dat.data = bl_memr16_rv ((void*) static_string, err.own);
   dat.time = fn->fiber.state.time;
 
-  bl_err e = ssc_out_q_produce (&gs->global->out_queue, &dat);
+  bl_err e = fiber_node_produce (gs, fn, &dat);
   log_error_if(
     e.own != bl_ok, "unable to produce output data on fiber: %s", bl_strerror (e)
     );
@@ -625,7 +1061,7 @@ static void ssc_produce_output_impl (ssc_handle h, bl_memr16 b, bool dyn)
   dat.data = b;
   dat.time = fn->fiber.state.time;
 
-  bl_err e = ssc_out_q_produce (&gs->global->out_queue, &dat);
+  bl_err e = fiber_node_produce (gs, fn, &dat);
   log_error_if(
     e.own != bl_ok, "unable to produce output data on fiber: %s", bl_strerror (e)
     );
@@ -651,7 +1087,7 @@ static void ssc_produce_string_impl(
   dat.data = bl_memr16_rv ((void*) str, size_incl_trail_null);
   dat.time = fn->fiber.state.time;
 
-  bl_err e = ssc_out_q_produce (&gs->global->out_queue, &dat);
+  bl_err e = fiber_node_produce (gs, fn, &dat);
   log_error_if(
     e.own != bl_ok, "unable to produce output data on fiber: %s", bl_strerror (e)
     );
@@ -682,6 +1118,44 @@ void ssc_api_produce_dynamic_string(
   ssc_produce_string_impl (h, str, size_incl_trail_null, true);
 }
 /*----------------------------------------------------------------------------*/
+void* ssc_api_output_reserve (ssc_handle h, bl_u16 size)
+{
+  gsched_fibers_node* fn = (gsched_fibers_node*) h;
+  gsched*             gs = fn->fiber.parent;
+  return ssc_out_arena_reserve(
+    ssc_out_q_arena (&gs->global->out_queue, gs->gid),
+    size,
+    fn,
+    gs->global->alloc
+    );
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_api_output_commit (ssc_handle h, bl_u16 size)
+{
+  gsched_fibers_node* fn = (gsched_fibers_node*) h;
+  gsched*             gs = fn->fiber.parent;
+
+  bl_u8* mem = ssc_out_arena_commit(
+    ssc_out_q_arena (&gs->global->out_queue, gs->gid), size, fn
+    );
+  if (!mem) {
+    return bl_mkerr (bl_invalid);
+  }
+  ssc_output_data dat;
+  dat.gid  = gs->gid;
+  dat.type = ssc_type_arena_bytes;
+  dat.data = bl_memr16_rv (mem, size);
+  dat.time = fn->fiber.state.time;
+
+  bl_err e = fiber_node_produce (gs, fn, &dat);
+  if (e.own) {
+    log_error ("unable to produce output data on fiber: %s", bl_strerror (e));
+    ssc_out_arena_release (mem);
+  }
+  fiber_node_forward_progress_limit (gs, fn);
+  return e;
+}
+/*----------------------------------------------------------------------------*/
 void ssc_api_delay (ssc_handle h, bl_timeoft32 us)
 {
   gsched_fibers_node* fn = (gsched_fibers_node*) h;
@@ -696,6 +1170,18 @@ bl_timept32 ssc_api_get_timestamp (ssc_handle h)
   return fn->fiber.state.time;
 }
 /*----------------------------------------------------------------------------*/
+void ssc_api_set_callback_match(
+  ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+  )
+{
+  gsched_fibers_node* fn = (gsched_fibers_node*) h;
+  bl_assert (fiber_is_stackless (&fn->fiber));
+  /*the fiber is running, so it isn't on the queue index*/
+  fn->fiber.cfg.callbacks.match      = match;
+  fn->fiber.cfg.callbacks.mask       = mask;
+  fn->fiber.cfg.callbacks.timeout_us = us;
+}
+/*----------------------------------------------------------------------------*/
 ssc_fiber_run_cfg ssc_api_fiber_get_run_cfg (ssc_handle h)
 {
   gsched_fibers_node* fn = (gsched_fibers_node*) h;
@@ -711,7 +1197,7 @@ static inline void set_fiber_as_produce_only (gsched_fibers_node* fn)
 static bool fiber_run_cfg_is_valid (ssc_fiber_run_cfg const* cfg)
 {
   return cfg->max_func_count != 0 &&
-         cfg->run_flags <= ((1 << ssc_fiber_flags_biggest) - 1);
+         cfg->run_flags <= ((1 << (ssc_fiber_flags_biggest + 1)) - 1);
 }
 /*----------------------------------------------------------------------------*/
 bl_err ssc_api_fiber_set_run_cfg(
@@ -728,11 +1214,12 @@ bl_err ssc_api_fiber_set_run_cfg(
     ) {
     return bl_mkerr (bl_invalid);
   }
-  fn->fiber.cfg.run_cfg = *c;
   if (fiber_is_produce_only (c->run_flags)) {
+    /*before setting the flag, produce only fibers have no input*/
     gsched_fiber_drop_all_input (&fn->fiber);
     ++gs->produce_only_fibers;
   }
+  fn->fiber.cfg.run_cfg = *c;
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
@@ -742,32 +1229,47 @@ bl_err gsched_init(
   gsched*                    gs,
   ssc_group_id               id,
   ssc_global*                global,
+  ssc_worker*                worker,
   ssc_fiber_group_cfg const* fgroup_cfg,
   ssc_fiber_cfgs const*      fiber_cfgs,
   bl_alloc_tbl const*        alloc
   )
 {
-  bl_assert (gs && global && fgroup_cfg && fiber_cfgs && alloc);
+  bl_assert (gs && global && worker && fgroup_cfg && fiber_cfgs && alloc);
   memset (gs, 0, sizeof *gs);
 
   gs->gid                 = id;
   gs->global              = global;
+  gs->worker              = worker;
+  gs->exec                = worker;
   gs->fiber_cfgs          = fiber_cfgs;
   gs->active_fibers       = ssc_fiber_cfgs_size (fiber_cfgs);
   gs->produce_only_fibers = 0;
-  gs->vars.now            = bl_timept32_get();
+  gs->vars.now            = ssc_global_now (global);
   gs->vars.has_prog       = false;
+  gs->vars.unhandled      = false;
+  bl_atomic_uword_store_rlx (&gs->run_state, rstate_idle);
+  bl_atomic_uword_store_rlx (&gs->timer_fired, 0);
 
   gsched_foreach_state_queue (gs, q) {
     bl_tailq_init (q);
   }
   bl_tailq_init (&gs->finished);
+  bl_tailq_init (&gs->spawn_pool);
+  for (bl_uword i = 0; i < gsched_qindex_buckets; ++i) {
+    bl_tailq_init (&gs->qindex[i]);
+  }
+  bl_tailq_init (&gs->qscan);
+  /*timers*/
+  ssc_twheel_init (&gs->timed, gs->vars.now);
+  ssc_twheel_init (&gs->future_wakes, gs->vars.now);
+  bl_tailq_init (&gs->free_wakes);
 
   bl_err err = bl_mkok();
-  bl_uword size = fibers_get_chunk_size (fiber_cfgs);
-  if (size == 0) {
+  if (ssc_fiber_cfgs_size (fiber_cfgs) == 0) {
     return bl_mkerr (bl_invalid);
   }
+  bl_uword size = fibers_get_chunk_size (fiber_cfgs, global->in_slot_size);
   /*fiber chunk allocation*/
   gs->mem_chunk = bl_alloc (alloc, size);
   if (!gs->mem_chunk) {
@@ -777,21 +1279,40 @@ bl_err gsched_init(
   memset (gs->mem_chunk, 0xaa, size);
 #endif
 
-  bl_u8* addr                 = gs->mem_chunk;
-  gsched_fibers_node* node = nullptr;
+  gsched_fibers_node* nodes = (gsched_fibers_node*) gs->mem_chunk;
+  gsched_fibers_node* node  = nullptr;
+  /*input log initialization*/
+  gs->log.mem        = (bl_u8*) (nodes + ssc_fiber_cfgs_size (fiber_cfgs));
+  gs->log.stride     = global->in_slot_size;
+  gs->log.mask       = fibers_get_log_size (fiber_cfgs) - 1;
+  gs->log.tail       = 0;
+  gs->log.head       = 0;
+  gs->log.dispatched = 0;
+  memset (gs->log.mem, 0, (gs->log.mask + 2) * gs->log.stride);
 
+  /*shared stack, sized for its most demanding fiber*/
+  bl_uword shared_size = 0;
+  for (bl_uword i = 0; i < ssc_fiber_cfgs_size (fiber_cfgs); ++i) {
+    ssc_fiber_cfg const* cfg = ssc_fiber_cfgs_at (fiber_cfgs, i);
+    if (cfg->fiber && fiber_has_shared_stack (cfg->run_cfg.run_flags)) {
+      shared_size = bl_max (shared_size, cfg->min_stack_size);
+    }
+  }
+  if (shared_size) {
+    /*lazy: committed up to the deepest usage only. Not when measuring, as it
+      is painted on each change of owner*/
+    err = ssc_fiber_stack_alloc(
+      &gs->shared_stack, shared_size, !global->measure_stacks
+      );
+    if (err.own) {
+      goto dealloc_chunk;
+    }
+  }
   /*fiber initialization*/
   for (bl_uword i = 0; i < ssc_fiber_cfgs_size (fiber_cfgs); ++i) {
-
     ssc_fiber_cfg*      cfg  = ssc_fiber_cfgs_at (fiber_cfgs, i);
-    gsched_fibers_node* next = (gsched_fibers_node*) (addr);
-    bl_u8** queue_elems = (bl_u8**) (((bl_u8*) next) + sizeof *next);
-
-    addr = ((bl_u8*) queue_elems) + (cfg->min_queue_size * sizeof *queue_elems);
-    addr = (bl_u8*) bl_next_offset_aligned_to_type(
-      (bl_uword) addr, gsched_fibers_node
-      );
-    err = fiber_init (next, gs->vars.now, gs, queue_elems, cfg);
+    gsched_fibers_node* next = &nodes[i];
+    err = fiber_init (next, gs->vars.now, gs, cfg, nullptr);
     if (err.own) {
       goto rollback;
     }
@@ -805,40 +1326,23 @@ bl_err gsched_init(
   }
   /*MPSC init*/
   err = ssc_in_q_init(
-    &gs->queue,bl_round_next_pow2_u (fgroup_cfg->min_queue_size), alloc
-    );
-  if (err.own) {
-    goto rollback;
-  }
-  bl_timept32 now = bl_timept32_get();
-  /*timed item queue*/
-  err = gsched_timed_init(
-    &gs->timed,
-    now,
-    bl_next_pow2_u (ssc_fiber_cfgs_size (fiber_cfgs)),
+    &gs->queue,
+    bl_round_next_pow2_u (fgroup_cfg->min_queue_size),
+    global->in_slot_size,
     alloc
     );
   if (err.own) {
-    goto destroy_q;
-  }
-  /*future wakes queue*/
-  err = gsched_timed_init (&gs->future_wakes, now, 32, alloc);
-  if (err.own) {
-    goto destroy_timed;
+    goto rollback;
   }
   return err;
 
-destroy_timed:
-  gsched_timed_destroy (&gs->timed, alloc);
-
-destroy_q:
-  ssc_in_q_destroy (&gs->queue, alloc);
-
 rollback:
-  bl_tailq_foreach (node, &gs->sq[q_blocked], hook) { /*variable reuse*/
+  bl_tailq_foreach (node, &gs->finished, hook) { /*variable reuse*/
     fiber_destroy (&node->fiber);
   }
-  bl_tailq_init (&gs->sq[q_blocked]);
+  bl_tailq_init (&gs->finished);
+  ssc_fiber_stack_free (&gs->shared_stack);
+dealloc_chunk:
   bl_dealloc (alloc, gs->mem_chunk);
   gs->mem_chunk = nullptr;
   return err;
@@ -846,19 +1350,30 @@ rollback:
 /*----------------------------------------------------------------------------*/
 void gsched_destroy (gsched* gs, bl_alloc_tbl const* alloc)
 {
-  gsched_timed_destroy (&gs->future_wakes, alloc);
-  gsched_timed_destroy (&gs->timed, alloc);
-  ssc_in_q_destroy (&gs->queue, alloc);
-
-  gsched_fibers_node* fn;
-  bl_tailq_foreach (fn, &gs->finished, hook) {
-    fiber_destroy (&fn->fiber);
+  ssc_twheel_node* n;
+  while ((n = ssc_twheel_pop_any (&gs->future_wakes))) {
+    bl_dealloc (alloc, n);
+  }
+  while ((n = bl_tailq_first (&gs->free_wakes))) {
+    bl_tailq_remove (&gs->free_wakes, n, hook);
+    bl_dealloc (alloc, n);
   }
+  ssc_in_q_destroy (&gs->queue, &gs->global->bstream_pool, alloc);
+  for (bl_uword seq = gs->log.tail; seq != gs->log.head; ++seq) {
+    ssc_in_slot_release (gsched_log_slot (gs, seq), &gs->global->bstream_pool);
+  }
+  if (gs->vars.unhandled) {
+    ssc_in_slot_release(
+      gsched_log_spare_slot (gs), &gs->global->bstream_pool
+      );
+  }
+
+  gsched_fibers_destroy (&gs->finished, alloc);
+  gsched_fibers_destroy (&gs->spawn_pool, alloc);
   gsched_foreach_state_queue (gs, q) {
-    bl_tailq_foreach (fn, q, hook) {
-      fiber_destroy (&fn->fiber);
-    }
+    gsched_fibers_destroy (q, alloc);
   }
+  ssc_fiber_stack_free (&gs->shared_stack);
   if (gs->mem_chunk) {
     bl_dealloc (alloc, gs->mem_chunk);
   }
@@ -915,6 +1430,7 @@ bl_err gsched_run_setup (gsched* gs)
       goto rollback;
     }
     ++i;
+    fn->fiber.cursor = gs->log.head;
     node_queue_transfer_tail (&gs->sq[q_run], &gs->finished, fn);
   }
   err = gsched_program_schedule (gs);
@@ -926,7 +1442,7 @@ bl_err gsched_run_setup (gsched* gs)
 rollback:
   fn = bl_tailq_first (&gs->sq[q_run]);
   for (j = 0; j < i; ++j) {
-    fiber_run_teardown (&fn->fiber);
+    fiber_run_teardown (&fn->fiber, false);
     fn = bl_tailq_next (fn, hook);
   }
   gsched_fibers_transfer_tail_all (&gs->sq[q_run], &gs->finished);
@@ -938,19 +1454,74 @@ void gsched_run_teardown (gsched* gs)
 {
   gsched_fibers_node* fn;
   bl_tailq_foreach (fn, &gs->finished, hook) {
-    fiber_run_teardown (&fn->fiber);
+    fiber_run_teardown (&fn->fiber, true);
   }
   gsched_foreach_state_queue (gs, q) {
     bl_tailq_foreach (fn, q, hook) {
-      fiber_run_teardown (&fn->fiber);
+      fiber_run_teardown (&fn->fiber, false);
     }
   }
+  gsched_log_reclaim (gs);
+}
+/*----------------------------------------------------------------------------*/
+static void fiber_get_stack_usage(
+  gsched_fiber* f, ssc_fiber_stack_usage* u, bl_uword capacity, bl_uword idx
+  )
+{
+  if (idx >= capacity) {
+    return;
+  }
+  gsched* gs = f->parent;
+  fiber_measure_stack (f);
+  u[idx].group = gs->gid;
+  u[idx].fiber = idx;
+  u[idx].size  = f->stack.ssze;
+  if (!fiber_is_stackless (f) &&
+    fiber_has_shared_stack (f->cfg.run_cfg.run_flags)
+    ) {
+    u[idx].size = gs->shared_stack.ssze;
+  }
+  u[idx].peak  = f->stack_peak;
+}
+/*----------------------------------------------------------------------------*/
+bl_uword gsched_get_stack_usage(
+  gsched* gs, ssc_fiber_stack_usage* u, bl_uword capacity
+  )
+{
+  bl_assert (gs && (u || capacity == 0));
+  /*the fiber nodes are on the chunk in configuration order*/
+  gsched_fibers_node* nodes = (gsched_fibers_node*) gs->mem_chunk;
+  bl_uword count            = ssc_fiber_cfgs_size (gs->fiber_cfgs);
+  for (bl_uword i = 0; i < count; ++i) {
+    fiber_get_stack_usage (&nodes[i].fiber, u, capacity, i);
+  }
+  /*then the spawned ones, alive or on the pool*/
+  gsched_fibers_node* fn;
+  gsched_foreach_state_queue (gs, q) {
+    bl_tailq_foreach (fn, q, hook) {
+      if (fn->fiber.spawned) {
+        fiber_get_stack_usage (&fn->fiber, u, capacity, count++);
+      }
+    }
+  }
+  bl_tailq_foreach (fn, &gs->finished, hook) {
+    if (fn->fiber.spawned) {
+      fiber_get_stack_usage (&fn->fiber, u, capacity, count++);
+    }
+  }
+  bl_tailq_foreach (fn, &gs->spawn_pool, hook) {
+    fiber_get_stack_usage (&fn->fiber, u, capacity, count++);
+  }
+  return count;
 }
 /*----------------------------------------------------------------------------*/
 bl_err gsched_fiber_cfg_validate_correct (ssc_fiber_cfg* cfg)
 {
   bl_assert (cfg);
-  if (cfg->min_stack_size == 0 ||
+  /*either a regular or a stackless fiber*/
+  bool stackless = cfg->fiber == nullptr;
+  if (stackless != (cfg->callbacks.on_input != nullptr) ||
+      (!stackless && cfg->min_stack_size == 0) ||
       cfg->min_queue_size == 0 ||
       !fiber_run_cfg_is_valid (&cfg->run_cfg)
     ) {
@@ -962,66 +1533,53 @@ bl_err gsched_fiber_cfg_validate_correct (ssc_fiber_cfg* cfg)
 /*----------------------------------------------------------------------------*/
 static inline bl_uword gsched_consume_inputs (gsched* gs, bl_timept32* now)
 {
-  bl_u8*   input[16];
-  bl_uword count = 0;
-  bl_static_assert_ns_funcscope (bl_is_pow2 (bl_arr_elems (input)));
+  bl_uword count     = 0;
+  bl_uword consumers = gs->active_fibers - gs->produce_only_fibers;
   bl_uword idx;
-  /*consume inputs from the outside*/
+  /*consume inputs from the outside straight into the log slots. Sending data
+    to the fibers is just appending to the log, as every consuming fiber
+    cursor is behind the log head. The fiber queue sizes are enforced lazily
+    when reading the cursors*/
   do {
-    idx = 0;
-    if (gs->vars.unhandled_bstream) {
-      bl_static_assert_ns_funcscope (bl_arr_elems (input) > 1);
-      input[idx] = gs->vars.unhandled_bstream;
-      ++idx;
-      gs->vars.unhandled_bstream = nullptr;
+    if (gsched_log_free_slots (gs) < gsched_input_batch) {
+      gsched_log_reclaim (gs);
+      bl_assert(
+        gsched_log_free_slots (gs) >= gsched_input_batch &&
+        "the log is sized to contain a batch after a reclamation"
+        );
     }
-    do {
-      input[idx] = ssc_in_q_try_consume (&gs->queue);
-      if (input[idx]) {
-        *in_bstream_refcount (input[idx]) =
-          gs->active_fibers - gs->produce_only_fibers;
-        ++idx;
+    for (idx = 0; idx < gsched_input_batch; ++idx) {
+      ssc_in_slot* slot = gsched_log_slot (gs, gs->log.head);
+      if (gs->vars.unhandled) {
+        memcpy (slot, gsched_log_spare_slot (gs), gs->log.stride);
+        gs->vars.unhandled = false;
       }
-      else {
+      else if (!ssc_in_q_try_consume (&gs->queue, slot)) {
         break;
       }
-    }
-    while (idx < bl_arr_elems (input));
-
-    if (idx == 0) {
-      break;
-    }
-    /*send data to fibers*/
-    gsched_foreach_state_queue (gs, q) { /*iterate all the state queues*/
-      gsched_fibers_node* n;
-      bl_tailq_foreach (n, q, hook) { /*iterate every fiber in every state queue*/
-        if (bl_unlikely(
-          fiber_is_produce_only (n->fiber.cfg.run_cfg.run_flags)
-          )) {
-          continue;
-        }
-        for (bl_uword i = 0; i < idx; ++i) {
-          if (!gsched_fiber_queue_can_insert (&n->fiber.queue)) {
-            gsched_fiber_drop_input_head (&n->fiber);
-          }
-          gsched_fiber_queue_insert_tail (&n->fiber.queue, &input[i]);
-        }
+      *now = slot->time;
+      if (bl_unlikely (consumers == 0)) {
+        ssc_in_slot_release (slot, &gs->global->bstream_pool);
+        continue;
       }
+      ++gs->log.head;
     }
     count += idx;
   }
-  while (idx == bl_arr_elems (input));
-  if (count != 0) {
-    *now = *in_bstream_timept32 (input[idx - 1]);
+  while (idx == gsched_input_batch);
+  if (count) {
+    ssc_in_q_wake_writers (&gs->queue); /*"ssc_write_timed"*/
   }
   return count;
 }
 /*----------------------------------------------------------------------------*/
 static inline void cancel_currently_programmed_future_event (gsched* gs)
 {
- bl_taskq_post_try_cancel_delayed(
-    gs->global->tq, gs->vars.prog_id, gs->vars.prog_timept32
-    );
+  if (!gs->global->virtual_time) {
+    bl_taskq_post_try_cancel_delayed(
+      gs->worker->tq, gs->vars.prog_id, gs->vars.prog_timept32
+      );
+  }
   gs->vars.has_prog = false;
 }
 /*----------------------------------------------------------------------------*/
@@ -1031,21 +1589,21 @@ static void gsched_loop_from_timed_event(
 /*----------------------------------------------------------------------------*/
 static inline void gsched_try_schedule_to_nearest_timed_event (gsched* gs)
 {
-  gsched_timed_entry const* timed = gsched_timed_get_head (&gs->timed);
-  gsched_timed_entry const* wake  = gsched_timed_get_head (&gs->future_wakes);
-  bl_timept32                    lowest;
+  bl_timept32 timed, wake, lowest;
+  bool has_timed = ssc_twheel_next_deadline (&gs->timed, &timed);
+  bool has_wake  = ssc_twheel_next_deadline (&gs->future_wakes, &wake);
 
-  switch ((bl_u_bitv (timed != nullptr, 0) | bl_u_bitv (wake != nullptr, 1))) {
+  switch ((bl_u_bitv (has_timed, 0) | bl_u_bitv (has_wake, 1))) {
   case 0:
     return;
   case 1:
-    lowest = timed->time;
+    lowest = timed;
     break;
   case 2:
-    lowest = wake->time;
+    lowest = wake;
     break;
   case 3:
-    lowest = bl_timept32_min (timed->time, wake->time);
+    lowest = bl_timept32_min (timed, wake);
     break;
   default:
     return;
@@ -1059,22 +1617,33 @@ static inline void gsched_try_schedule_to_nearest_timed_event (gsched* gs)
     }
   }
   gs->vars.prog_timept32 = lowest;
+  gs->vars.has_prog      = true;
+  if (gs->global->virtual_time) {
+    return; /*the simulator fires it when advancing the virtual clock*/
+  }
   bl_assert_side_effect(
    bl_taskq_post_delayed_abs(
-      gs->global->tq,
+      gs->worker->tq,
       &gs->vars.prog_id,
       gs->vars.prog_timept32,
      bl_taskq_task_rv (gsched_loop_from_timed_event, gs)
       ).own == bl_ok
     );
-  gs->vars.has_prog = true;
 }
 /*----------------------------------------------------------------------------*/
-static inline void gsched_process_blocked_on_queue (gsched* gs)
+static inline void gsched_fiber_wake_from_queue(
+  gsched* gs, gsched_fibers_node* fn
+  )
+{
+  node_queue_transfer_tail (&gs->sq[q_run], &gs->sq[q_queue], fn);
+  fn->fiber.state.time = gs->vars.now;
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_process_blocked_on_queue_scan (gsched* gs)
 {
-  for (gsched_fibers_node* next = bl_tailq_first (&gs->sq[q_queue]); next; ) {
-    gsched_fibers_node* fn = next; /*self removal from the run_q is allowed*/
-    next                   = bl_tailq_next (next, hook);
+  for (gsched_fibers_node* next = bl_tailq_first (&gs->qscan); next; ) {
+    gsched_fibers_node* fn = next; /*self removal from the scan list is allowed*/
+    next                   = bl_tailq_next (next, qhook);
 
     bool  ready = false;
     bl_uword mode  = (bl_uword) (fn->fiber.state.params.qread.match != nullptr) +
@@ -1110,8 +1679,160 @@ static inline void gsched_process_blocked_on_queue (gsched* gs)
       break;
     }
     if (ready) {
-      node_queue_transfer_tail (&gs->sq[q_run], &gs->sq[q_queue], fn);
-      fn->fiber.state.time = gs->vars.now;
+      bl_tailq_remove (&gs->qscan, fn, qhook);
+      gsched_fiber_wake_from_queue (gs, fn);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline bool gsched_fiber_qread_matches(
+  gsched_fiber_queue_read_data const* qr, bl_memr16 in
+  )
+{
+  bl_memr16 match = bl_memr16_rv ((void*) qr->match, qr->match_size);
+  if (!qr->mask) {
+    return ssc_api_pattern_match (in, match);
+  }
+  return ssc_api_pattern_match_mask(
+    in, match, bl_memr16_rv ((void*) qr->mask, qr->mask_size)
+    );
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_process_blocked_on_queue_index (gsched* gs)
+{
+  /*every message is only matched against the fibers waiting for its first
+    byte. Messages already reclaimed were out of every fiber queue.*/
+  bl_uword seq = gs->log.dispatched;
+  if (gs->log.head - seq > gs->log.head - gs->log.tail) {
+    seq = gs->log.tail;
+  }
+  for (; seq != gs->log.head; ++seq) {
+    bl_memr16 in = ssc_in_slot_payload (gsched_log_slot (gs, seq));
+    if (bl_memr16_size (in) == 0) {
+      continue;
+    }
+    gsched_fibers* bucket = &gs->qindex[*bl_memr16_beg_as (in, bl_u8)];
+    for (gsched_fibers_node* next = bl_tailq_first (bucket); next; ) {
+      gsched_fibers_node* fn = next;
+      next                   = bl_tailq_next (next, qhook);
+      if (gs->log.head - seq > fn->fiber.queue_size ||
+        !gsched_fiber_qread_matches (&fn->fiber.state.params.qread, in)
+        ) {
+        continue; /*overflowed or not matching*/
+      }
+      bl_tailq_remove (bucket, fn, qhook);
+      fn->fiber.cursor = seq;
+      gsched_fiber_wake_from_queue (gs, fn);
+    }
+  }
+  gs->log.dispatched = gs->log.head;
+}
+/*----------------------------------------------------------------------------*/
+static inline void gsched_process_blocked_on_queue (gsched* gs)
+{
+  gsched_process_blocked_on_queue_scan (gs);
+  gsched_process_blocked_on_queue_index (gs);
+}
+/*----------------------------------------------------------------------------*/
+/* STACKLESS FIBERS */
+/*----------------------------------------------------------------------------*/
+static bool gsched_stackless_try_peek (gsched_fibers_node* fn)
+{
+  /*drops the non matching messages, as the peek functions*/
+  ssc_fiber_callbacks const* cb = &fn->fiber.cfg.callbacks;
+  if (bl_memr16_is_null (cb->match)) {
+    return gsched_fiber_input_count (&fn->fiber) != 0;
+  }
+  if (bl_memr16_is_null (cb->mask)) {
+    return gsched_fiber_try_peek_input_head_match (fn, cb->match);
+  }
+  return gsched_fiber_try_peek_input_head_match_mask (fn, cb->match, cb->mask);
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_stackless_block_on_queue (gsched* gs, gsched_fibers_node* fn)
+{
+  gsched_fiber*                 f  = &fn->fiber;
+  ssc_fiber_callbacks const*    cb = &f->cfg.callbacks;
+  gsched_fiber_queue_read_data* qr = &f->state.params.qread;
+
+  f->state.id    = fstate_onqueue;
+  qr->match      = bl_memr16_beg_as (cb->match, bl_u8);
+  qr->match_size = bl_memr16_size (cb->match);
+  qr->mask       = bl_memr16_beg_as (cb->mask, bl_u8);
+  qr->mask_size  = bl_memr16_size (cb->mask);
+  if (cb->timeout_us != 0) {
+    fiber_node_program_timed(
+      gs, fn, f->state.time + bl_usec_to_timept32 (cb->timeout_us)
+      );
+  }
+  node_queue_transfer_tail (&gs->sq[q_queue], &gs->sq[q_run], fn);
+  gsched_qindex_insert (gs, fn);
+}
+/*----------------------------------------------------------------------------*/
+static bool gsched_stackless_after_callback(
+  gsched* gs, gsched_fibers_node* fn, bool keep_running
+  )
+{
+  /*returns if the fiber can keep running on this scheduler run*/
+  gsched_fiber* f = &fn->fiber;
+  if (!keep_running) {
+    fiber_node_finish (fn);
+    return false;
+  }
+  ++f->state.func_count;
+  bl_timeoft32 max_offset = bl_usec_to_timept32(
+    f->cfg.run_cfg.look_ahead_offset_us
+    );
+  if (bl_timept32_get_diff (f->state.time, gs->vars.now + max_offset) >= 0) {
+    /*as "fiber_node_yield_until_fiber_time"*/
+    f->delayed = true;
+    fiber_node_program_timed (gs, fn, f->state.time);
+    node_queue_transfer_tail (&gs->sq[q_blocked], &gs->sq[q_run], fn);
+    return false;
+  }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_stackless_run (gsched* gs, gsched_fibers_node* fn)
+{
+  /*the same steps than a regular fiber looping on a (timed) peek with match,
+    without the context switches*/
+  gsched_fiber* f     = &fn->fiber;
+  void*         simc  = gs->global->sim_context;
+  bl_uword      state = f->state.id;
+
+  f->state.id         = fstate_run;
+  f->state.func_count = 0;
+  if (state == fstate_onqueue) {
+    fiber_node_cancel_timed (gs, fn); /*woken up by the input*/
+  }
+  else if (state == fstate_timer_reschedule && !f->delayed) {
+    /*the messages received on the same run than the timeout weren't
+      filtered*/
+    if (!gsched_stackless_try_peek (fn) && f->cfg.callbacks.on_timeout) {
+      bool keep = f->cfg.callbacks.on_timeout (fn, f->cfg.context, simc);
+      if (!gsched_stackless_after_callback (gs, fn, keep)) {
+        return;
+      }
+    }
+  }
+  f->delayed = false;
+  while (true) {
+    if (!gsched_stackless_try_peek (fn)) {
+      gsched_stackless_block_on_queue (gs, fn);
+      return;
+    }
+    if (f->state.func_count > f->cfg.run_cfg.max_func_count) {
+      return; /*yield: stays on the run queue*/
+    }
+    bl_uword  cursor = f->cursor;
+    bl_memr16 in     = ssc_api_try_peek_input_head (fn);
+    bool keep = f->cfg.callbacks.on_input (fn, in, f->cfg.context, simc);
+    if (f->cursor == cursor) {
+      gsched_fiber_drop_input_head (f);
+    }
+    if (!gsched_stackless_after_callback (gs, fn, keep)) {
+      return;
     }
   }
 }
@@ -1120,15 +1841,16 @@ static void gsched_loop (gsched* gs,bl_taskq_id id, bool from_timed_event)
 {
   if (bl_tailq_empty (&gs->sq[q_run]) &&
       bl_tailq_empty (&gs->sq[q_blocked]) &&
-      bl_tailq_empty (&gs->sq[q_queue])
+      bl_tailq_empty (&gs->sq[q_queue]) &&
+      bl_tailq_empty (&gs->sq[q_output])
     ) {
     return;
   }
   bl_timept32 now;
   bl_uword  new_input_count = gsched_consume_inputs (gs, &now);
   bl_uword  expired_count   = 0;
-  if (new_input_count == 0 || from_timed_event) {
-    gs->vars.now = bl_timept32_get();
+  if (new_input_count == 0 || from_timed_event || gs->global->virtual_time) {
+    gs->vars.now = ssc_global_now (gs->global);
     if (from_timed_event) {
       gs->vars.has_prog = (id == gs->vars.prog_id) ? false : gs->vars.has_prog;
     }
@@ -1136,32 +1858,27 @@ static void gsched_loop (gsched* gs,bl_taskq_id id, bool from_timed_event)
   else {
     gs->vars.now = bl_timept32_max (gs->vars.now, now);
   }
+  ssc_twheel_node* expired;
   /*scan for scheduled deferred wake operations*/
-  while (true) {
-    gsched_timed_entry const* future =
-      gsched_timed_get_head_if_expired (&gs->future_wakes, true, gs->vars.now);
-    if (!future) {
-      break;
-    }
-    run_wake(
-      gs, future->value.wake.id, future->value.wake.count, gs->vars.now
-      );
-    gsched_timed_drop_head (&gs->future_wakes);
+  ssc_twheel_advance (&gs->future_wakes, gs->vars.now);
+  while ((expired = ssc_twheel_pop_expired (&gs->future_wakes))) {
+    gsched_wake_node* w = (gsched_wake_node*) expired;
+    run_wake (gs, w->wake.id, w->wake.count, gs->vars.now);
+    gsched_wake_node_free (gs, w);
     ++expired_count;
   }
   /*move expired tasks in the timed queue to the run queue*/
-  while (true) {
-    gsched_timed_entry const* timed =
-      gsched_timed_get_head_if_expired (&gs->timed, true, gs->vars.now);
-    if (!timed) {
-      break;
+  ssc_twheel_advance (&gs->timed, gs->vars.now);
+  while ((expired = ssc_twheel_pop_expired (&gs->timed))) {
+    gsched_fibers_node* fn = gsched_timeout_owner (expired);
+    bl_uword id            = q_blocked;
+    if (fn->fiber.state.id == fstate_onqueue) {
+      id = q_queue;
+      gsched_qindex_remove (gs, fn);
     }
-    bl_uword id = (timed->value.fn->fiber.state.id == fstate_onqueue) ?
-      q_queue : q_blocked;
-    timed->value.fn->fiber.state.id = fstate_timer_reschedule;
-    node_queue_transfer_tail (&gs->sq[q_run], &gs->sq[id], timed->value.fn);
-    timed->value.fn->fiber.state.time = gs->vars.now;
-    gsched_timed_drop_head (&gs->timed);
+    fn->fiber.state.id = fstate_timer_reschedule;
+    node_queue_transfer_tail (&gs->sq[q_run], &gs->sq[id], fn);
+    fn->fiber.state.time = gs->vars.now;
     ++expired_count;
   }
 
@@ -1171,13 +1888,50 @@ static void gsched_loop (gsched* gs,bl_taskq_id id, bool from_timed_event)
   if (new_input_count) {
     gsched_process_blocked_on_queue (gs);
   }
+  if (!bl_tailq_empty (&gs->sq[q_output]) &&
+    !ssc_out_q_lane_is_blocked (&gs->global->out_queue, gs->gid)
+    ) {
+    /*the reader made room on the output lane, they retry*/
+    gsched_fibers_node* n;
+    while ((n = bl_tailq_first (&gs->sq[q_output]))) {
+      node_queue_transfer_tail (&gs->sq[q_run], &gs->sq[q_output], n);
+    }
+  }
   /*process run queue*/
   for (gsched_fibers_node* next = bl_tailq_first (&gs->sq[q_run]); next; ) {
     gsched_fibers_node* n = next; /*self removal from the run_q is allowed*/
     next                  = bl_tailq_next (next, hook);
     bl_assert (bl_timept32_get_diff (gs->vars.now, n->fiber.state.time) >= 0);
-    n->fiber.state.time   = gs->vars.now;
-    coro_transfer (&gs->global->main_coro_ctx, &n->fiber.coro_ctx);
+    if (fiber_is_stackless (&n->fiber)) {
+      n->fiber.state.time = gs->vars.now;
+      gsched_stackless_run (gs, n);
+    }
+    else if (!fiber_has_shared_stack (n->fiber.cfg.run_cfg.run_flags) ||
+      gsched_shared_stack_acquire (gs, n)
+      ) {
+      n->fiber.state.time   = gs->vars.now;
+      ssc_ctx_transfer (&gs->exec->main_coro_ctx, &n->fiber.coro_ctx);
+      if (fiber_has_shared_stack (n->fiber.cfg.run_cfg.run_flags)) {
+        /*before another fiber takes the shared stack*/
+        fiber_measure_stack (&n->fiber);
+      }
+    }
+    else {
+      continue; /*OOM saving the previous stack: retried on the next run*/
+    }
+    if (n->fiber.state.id != fstate_finished) {
+      continue;
+    }
+    /*it won't run again, its stack can't be released from itself*/
+    fiber_measure_stack (&n->fiber);
+    if (n->fiber.spawned) {
+      fiber_run_teardown (&n->fiber, true);
+      bl_tailq_remove (&gs->finished, n, hook);
+      gsched_spawn_node_recycle (gs, n);
+      continue;
+    }
+    ssc_fiber_stack_release_pages (&n->fiber.stack);
+    gsched_shared_stack_release (gs, &n->fiber);
   }
   /*immediate request another run if there are still tasks in the run queue*/
   if (!bl_tailq_empty (&gs->sq[q_run])) {
@@ -1185,8 +1939,11 @@ static void gsched_loop (gsched* gs,bl_taskq_id id, bool from_timed_event)
   }
   /*signal input producers that this task group needs scheduling after putting
     new input on the queue -> group can't make forward progress*/
-  gs->vars.unhandled_bstream = ssc_in_q_try_consume (&gs->queue);
-  if (gs->vars.unhandled_bstream) {
+  gs->vars.unhandled = ssc_in_q_try_consume(
+    &gs->queue, gsched_log_spare_slot (gs)
+    );
+  if (gs->vars.unhandled) {
+    ssc_in_q_wake_writers (&gs->queue);
     goto reschedule; /*new data, group may make immediate forward progress*/
   }
   ssc_in_q_sig prev_sig;
@@ -1209,6 +1966,8 @@ reschedule:
   bl_assert_side_effect (gsched_program_schedule (gs).own == bl_ok);
 }
 /*----------------------------------------------------------------------------*/
+static void gsched_make_ready (gsched* gs);
+/*----------------------------------------------------------------------------*/
 static void gsched_loop_from_timed_event(
   bl_err error,bl_taskq_id id, void* context
   )
@@ -1216,7 +1975,15 @@ static void gsched_loop_from_timed_event(
   if (bl_unlikely (error.own)) {
     return;
   }
-  gsched_loop ((gsched*) context, id, true);
+  gsched* gs = (gsched*) context;
+  if (ssc_worker_is_stealing (gs->worker)) {
+    /*the group might be running on another worker, let it find out*/
+    bl_atomic_uword_store_rlx (&gs->timer_id, id);
+    bl_atomic_uword_store (&gs->timer_fired, 1, bl_mo_release);
+    gsched_make_ready (gs);
+    return;
+  }
+  gsched_loop (gs, id, true);
 }
 /*----------------------------------------------------------------------------*/
 static void gsched_loop_regular(
@@ -1229,14 +1996,97 @@ static void gsched_loop_regular(
   gsched_loop ((gsched*) context, id, false);
 }
 /*----------------------------------------------------------------------------*/
+static void gsched_loop_from_virtual_timer(
+  bl_err error,bl_taskq_id id, void* context
+  )
+{
+  if (bl_unlikely (error.own)) {
+    return;
+  }
+  /*on virtual time mode "now" is always refreshed from the virtual clock*/
+  gsched_loop ((gsched*) context, id, false);
+}
+/*----------------------------------------------------------------------------*/
 bl_err gsched_program_schedule_priv (gsched* gs,bl_taskq_task_func task)
 {
  bl_taskq_id id;
-  return bl_taskq_post(gs->global->tq, &id,bl_taskq_task_rv (task, gs));
+  bl_err err = bl_taskq_post(gs->worker->tq, &id,bl_taskq_task_rv (task, gs));
+  ssc_global_wake_runner (gs->global);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+static void gsched_make_ready (gsched* gs)
+{
+  bl_uword state = bl_atomic_uword_load_rlx (&gs->run_state);
+  while (true) {
+    bl_uword next;
+    switch (state) {
+    case rstate_idle:    next = rstate_queued; break;
+    case rstate_running: next = rstate_running_requeue; break;
+    default:             return; /*already ready*/
+    }
+    if (bl_atomic_uword_strong_cas(
+      &gs->run_state, &state, next, bl_mo_acq_rel, bl_mo_relaxed
+      )) {
+      break;
+    }
+  }
+  if (state == rstate_idle) {
+    bl_assert_side_effect (ssc_worker_push_ready (gs->worker, gs).own == bl_ok);
+  }
+  /*when running the running worker requeues it after finishing*/
 }
 /*----------------------------------------------------------------------------*/
 bl_err gsched_program_schedule (gsched* gs)
 {
+  if (ssc_worker_is_stealing (gs->worker)) {
+    gsched_make_ready (gs);
+    return bl_mkok();
+  }
   return gsched_program_schedule_priv (gs, gsched_loop_regular);
 }
 /*----------------------------------------------------------------------------*/
+bool gsched_get_deadline (gsched const* gs, bl_timept32* deadline)
+{
+  *deadline = gs->vars.prog_timept32;
+  return gs->vars.has_prog;
+}
+/*----------------------------------------------------------------------------*/
+bl_err gsched_fire_virtual_timer (gsched* gs)
+{
+  bl_assert (gs->global->virtual_time && gs->vars.has_prog);
+  gs->vars.has_prog = false;
+  return gsched_program_schedule_priv (gs, gsched_loop_from_virtual_timer);
+}
+/*----------------------------------------------------------------------------*/
+void gsched_set_worker (gsched* gs, ssc_worker* w)
+{
+  bl_assert (gs && w && !gs->vars.has_prog);
+  gs->worker = w;
+  gs->exec   = w;
+}
+/*----------------------------------------------------------------------------*/
+void gsched_run_ready (gsched* gs, ssc_worker* w)
+{
+  /*only one reference of a group can be on the ready queues, so this worker
+    is the only one running it. The acquire on the queue read makes the
+    previous run's memory visible.*/
+  bl_assert (bl_atomic_uword_load_rlx (&gs->run_state) == rstate_queued);
+  bl_atomic_uword_store (&gs->run_state, rstate_running, bl_mo_relaxed);
+  gs->exec = w;
+
+  bool fired = bl_atomic_uword_exchange (&gs->timer_fired, 0, bl_mo_acquire);
+  gsched_loop (gs, (bl_taskq_id) bl_atomic_uword_load_rlx (&gs->timer_id), fired);
+
+  bl_uword expected = rstate_running;
+  if (bl_atomic_uword_strong_cas(
+    &gs->run_state, &expected, rstate_idle, bl_mo_release, bl_mo_relaxed
+    )) {
+    return;
+  }
+  /*became ready while running, keep it on this worker for locality*/
+  bl_assert (expected == rstate_running_requeue);
+  bl_atomic_uword_store (&gs->run_state, rstate_queued, bl_mo_relaxed);
+  bl_assert_side_effect (ssc_worker_push_ready (w, gs).own == bl_ok);
+}
+/*----------------------------------------------------------------------------*/
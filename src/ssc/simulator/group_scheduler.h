@@ -1,14 +1,10 @@
 #ifndef __SSC_GSCHED_H__
 #define __SSC_GSCHED_H__
 
-#include <coro.h>
-
 #include <bl/base/platform.h>
 #include <bl/base/error.h>
 #include <bl/base/integer.h>
 #include <bl/base/bsd_queue.h>
-#include <bl/base/flat_deadlines.h>
-#include <bl/base/ringbuffer.h>
 
 #include <bl/task_queue/task_queue.h>
 
@@ -16,15 +12,20 @@
 #include <ssc/simulator/in_queue.h>
 #include <ssc/simulator/cfg.h>
 #include <ssc/simulator/global.h>
+#include <ssc/simulator/worker.h>
+#include <ssc/simulator/timing_wheel.h>
+#include <ssc/simulator/fiber_stack.h>
+#include <ssc/simulator/context_switch.h>
 
 /*----------------------------------------------------------------------------*/
 typedef struct gsched gsched;
 /*----------------------------------------------------------------------------*/
 typedef struct gsched_fiber_cfg {
-  ssc_fiber_func          fiber;
+  ssc_fiber_func          fiber; /*nullptr on stackless fibers*/
   ssc_fiber_teardown_func teardown;
   void*                   context;
   ssc_fiber_run_cfg       run_cfg;
+  ssc_fiber_callbacks     callbacks; /*stackless fibers only*/
 }
 gsched_fiber_cfg;
 /*----------------------------------------------------------------------------*/
@@ -39,12 +40,16 @@ typedef struct gsched_fiber_queue_read_data {
   bl_u8 const* mask;
   bl_u16       match_size;
   bl_u16       mask_size;
+  bool         indexed; /*on the first match byte index*/
 }
 gsched_fiber_queue_read_data;
 /*----------------------------------------------------------------------------*/
 typedef union gsched_fiber_state_params {
   gsched_fiber_wait_data       wait;
   gsched_fiber_queue_read_data qread;
+  /*waiting for room on the out queue. A copy: shared stack fibers can't
+    reference their stack while suspended*/
+  ssc_output_data              output;
 }
 gsched_fiber_state_params;
 /*----------------------------------------------------------------------------*/
@@ -52,22 +57,38 @@ typedef struct gsched_fiber_state {
   bl_timept32                 time;
   bl_uword                  func_count;
   gsched_fiber_state_params params;
+  ssc_twheel_node           timeout; /*handle on the group "timed" wheel*/
   bl_u8                     id;
 }
 gsched_fiber_state;
 /*----------------------------------------------------------------------------*/
+typedef struct gsched_fiber_stack_copy {
+  bl_u8*   sp; /*lowest live address on the shared stack when suspended*/
+  bl_u8*   mem; /*the live part of the stack while other fiber runs*/
+  bl_uword size;
+  bl_uword capacity;
+  bool     started; /*the context is created on the first run*/
+}
+gsched_fiber_stack_copy;
+/*----------------------------------------------------------------------------*/
 typedef struct gsched_fiber {
-  gsched*            parent;
-  coro_context       coro_ctx;
-  struct coro_stack  stack;
-  bl_ringb           queue;
-  gsched_fiber_cfg   cfg;
-  gsched_fiber_state state;
+  gsched*                 parent;
+  ssc_ctx                 coro_ctx;
+  ssc_fiber_stack         stack; /*unused on shared stack fibers*/
+  gsched_fiber_stack_copy copy; /*shared stack fibers only*/
+  bl_uword                stack_peak; /*latest measurement, when measuring*/
+  bl_uword                cursor; /*sequence of the next input log message*/
+  bl_uword                queue_size; /*max count of unread messages*/
+  bool                    delayed; /*stackless: blocked until its time*/
+  bool                    spawned; /*at runtime, the node is heap allocated*/
+  gsched_fiber_cfg        cfg;
+  gsched_fiber_state      state;
 }
 gsched_fiber;
 /*----------------------------------------------------------------------------*/
 typedef struct gsched_fibers_node {
   bl_tailq_entry (gsched_fibers_node) hook;
+  bl_tailq_entry (gsched_fibers_node) qhook; /*blocked on queue index/scan*/
   gsched_fiber                        fiber;
 }
 gsched_fibers_node;
@@ -80,35 +101,61 @@ typedef struct gsched_wake_data {
 }
 gsched_wake_data;
 /*----------------------------------------------------------------------------*/
-typedef union gsched_timed_value {
-  gsched_fibers_node* fn;
-  gsched_wake_data    wake;
+typedef struct gsched_wake_node {
+  ssc_twheel_node  node; /*has to be the first member*/
+  gsched_wake_data wake;
 }
-gsched_timed_value;
+gsched_wake_node;
 /*----------------------------------------------------------------------------*/
 typedef struct gsched_mainloop_vars {
   bl_timept32   now;
-  bl_u8*      unhandled_bstream;
+  bool        unhandled; /*a message on the log spare slot*/
   bool        has_prog;
   bl_taskq_id prog_id;
   bl_timept32   prog_timept32;
 }
 gsched_mainloop_vars;
 /*----------------------------------------------------------------------------*/
+typedef struct gsched_input_log {
+  bl_u8*   mem;    /*"ssc_in_slot" array*/
+  bl_uword stride; /*slot size*/
+  bl_uword mask;
+  bl_uword tail; /*sequence of the oldest non reclaimed message*/
+  bl_uword head; /*sequence of the next message to be inserted*/
+  bl_uword dispatched; /*messages before it were checked by the index*/
+}
+gsched_input_log;
+/*----------------------------------------------------------------------------*/
+enum { gsched_qindex_buckets = 256 };
+/*----------------------------------------------------------------------------*/
 typedef struct gsched {
   ssc_in_q              queue;
-  bl_flat_deadlines     timed; /*state timeouts*/
-  gsched_fibers         sq[3]; /*state queues*/
-  bl_flat_deadlines     future_wakes;
+  gsched_input_log      log; /*input shared by all the fibers on the group*/
+  ssc_twheel            timed; /*state timeouts*/
+  gsched_fibers         sq[4]; /*state queues*/
+  ssc_twheel            future_wakes; /*of "gsched_wake_node"*/
+  ssc_twheel_list       free_wakes; /*"gsched_wake_node" pool*/
   gsched_fibers         finished;
+  gsched_fibers         spawn_pool; /*finished spawned fibers, for reuse*/
+  /*fibers on "sq[q_queue]" waiting for a match whose first byte is fully
+    masked are on the bucket of that byte, the rest are on "qscan"*/
+  gsched_fibers         qindex[gsched_qindex_buckets];
+  gsched_fibers         qscan;
   ssc_fiber_cfgs const* fiber_cfgs;
   ssc_global*           global;
+  ssc_worker*           worker; /*the worker owning this group's timers*/
+  ssc_worker*           exec; /*the worker currently running this group*/
+  bl_atomic_uword       run_state; /*only used on stealing workers*/
+  bl_atomic_uword       timer_fired;
+  bl_atomic_uword       timer_id;
   ssc_group_id          gid;
   bl_timept32             look_ahead_offset;
   gsched_mainloop_vars  vars;
   bl_uword              active_fibers;
   bl_uword              produce_only_fibers;
   bl_u8*                mem_chunk;
+  ssc_fiber_stack       shared_stack; /*for "ssc_fiber_shared_stack" fibers*/
+  gsched_fiber*         stack_owner; /*fiber whose stack is on "shared_stack"*/
 }
 gsched;
 /*----------------------------------------------------------------------------*/
@@ -118,6 +165,7 @@ extern bl_err gsched_init(
   gsched*                    gs,
   ssc_group_id               id,
   ssc_global*                global,
+  ssc_worker*                worker,
   ssc_fiber_group_cfg const* fgroup_cfg,
   ssc_fiber_cfgs const*      fiber_cfgs,
   bl_alloc_tbl const*        alloc
@@ -131,10 +179,42 @@ extern void gsched_run_teardown (gsched* gs);
 /*----------------------------------------------------------------------------*/
 extern bl_err gsched_program_schedule (gsched* gs);
 /*----------------------------------------------------------------------------*/
+/* gsched_get_deadline: returns if the group has a timer programmed and its
+   time on "deadline". */
+/*----------------------------------------------------------------------------*/
+extern bool gsched_get_deadline (gsched const* gs, bl_timept32* deadline);
+/*----------------------------------------------------------------------------*/
+/* gsched_fire_virtual_timer: on virtual time mode the group timers aren't
+   posted to the task queue. The simulator calls this function after advancing
+   the virtual clock past the group deadline. */
+/*----------------------------------------------------------------------------*/
+extern bl_err gsched_fire_virtual_timer (gsched* gs);
+/*----------------------------------------------------------------------------*/
+/* gsched_set_worker: can only be called when the group isn't scheduled on any
+   worker (before "gsched_run_setup"). */
+/*----------------------------------------------------------------------------*/
+extern void gsched_set_worker (gsched* gs, ssc_worker* w);
+/*----------------------------------------------------------------------------*/
+/* gsched_run_ready: runs a group taken from a ready queue of a stealing worker.
+   "w" is the worker calling this function, it may be a different one than the
+   group's owner. */
+/*----------------------------------------------------------------------------*/
+extern void gsched_run_ready (gsched* gs, ssc_worker* w);
+/*----------------------------------------------------------------------------*/
+/* gsched_get_stack_usage: measures the fiber stacks and writes the usage of
+   the first "capacity" fibers to "u", the configured ones and then the spawned
+   ones. Returns the group fiber count. The group can't be running. */
+/*----------------------------------------------------------------------------*/
+extern bl_uword gsched_get_stack_usage(
+  gsched* gs, ssc_fiber_stack_usage* u, bl_uword capacity
+  );
+/*----------------------------------------------------------------------------*/
 extern bl_err gsched_fiber_cfg_validate_correct (ssc_fiber_cfg* cfg);
 /*----------------------------------------------------------------------------*/
 /* SIMULATION INTERFACE */
 /*----------------------------------------------------------------------------*/
+extern bl_err ssc_api_spawn_fiber (ssc_handle h, ssc_fiber_cfg const* cfg);
+/*----------------------------------------------------------------------------*/
 extern void ssc_api_yield (ssc_handle h);
 /*----------------------------------------------------------------------------*/
 extern void ssc_api_wake (ssc_handle h, bl_uword_d2 wait_id, bl_uword_d2 count);
@@ -175,6 +255,10 @@ extern void ssc_api_produce_dynamic_string(
   ssc_handle h, char const* str, bl_uword size_incl_trail_null
   );
 /*----------------------------------------------------------------------------*/
+extern void* ssc_api_output_reserve (ssc_handle h, bl_u16 size);
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_api_output_commit (ssc_handle h, bl_u16 size);
+/*----------------------------------------------------------------------------*/
 extern void ssc_api_delay (ssc_handle h, bl_timeoft32 us);
 /*----------------------------------------------------------------------------*/
 extern bl_timept32 ssc_api_get_timestamp (ssc_handle h);
@@ -183,6 +267,10 @@ extern bool ssc_api_pattern_match (bl_memr16 in, bl_memr16 match);
 /*----------------------------------------------------------------------------*/
 extern bool ssc_api_pattern_match_mask (bl_memr16 in, bl_memr16 match, bl_memr16 mask);
 /*----------------------------------------------------------------------------*/
+extern void ssc_api_set_callback_match(
+  ssc_handle h, bl_memr16 match, bl_memr16 mask, bl_timeoft32 us
+  );
+/*----------------------------------------------------------------------------*/
 extern ssc_fiber_run_cfg ssc_api_fiber_get_run_cfg (ssc_handle h);
 /*----------------------------------------------------------------------------*/
 extern bl_err ssc_api_fiber_set_run_cfg(
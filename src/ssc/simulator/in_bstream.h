@@ -5,30 +5,57 @@
 #include <bl/base/integer.h>
 #include <bl/base/time.h>
 #include <bl/base/allocator.h>
+#include <bl/base/atomic.h>
+
+#include <ssc/simulator/bstream_pool.h>
 
 /*----------------------------------------------------------------------------*/
 enum in_bstream_header_e {
   /*max align (from malloc)*/
+  in_bstream_next_bytes         = sizeof (bl_u8*),
+  /*pointer alignment*/
+  in_bstream_refs_bytes         = sizeof (bl_atomic_uword),
+  /*word alignment*/
   in_bstream_timept32_bytes       = sizeof (bl_timept32),
   /*at least bl_timept32 alignment (32 or 64)*/
   in_bstream_payload_size_bytes = sizeof (bl_u16),
-  /*at least bl_u16 alignment*/
-  in_bstream_refcount_bytes     = sizeof (bl_u8),
+  /*u16 alignment*/
+  in_bstream_pool_class_bytes   = sizeof (bl_u8),
+
+  in_bstream_next_offset = 0,
 
-  in_bstream_timept32_offset = 0,
+  in_bstream_refs_offset = in_bstream_next_offset + in_bstream_next_bytes,
+
+  in_bstream_timept32_offset = in_bstream_refs_offset + in_bstream_refs_bytes,
 
   in_bstream_payload_size_offset =
     in_bstream_timept32_offset + in_bstream_timept32_bytes,
 
-  in_bstream_refcount_offset =
+  in_bstream_pool_class_offset =
     in_bstream_payload_size_offset + in_bstream_payload_size_bytes,
 
+  /*rounded up to pointer alignment*/
   in_bstream_payload_offset =
-    in_bstream_refcount_offset + in_bstream_refcount_bytes,
+    (in_bstream_pool_class_offset + in_bstream_pool_class_bytes +
+      sizeof (bl_u8*) - 1) & ~(sizeof (bl_u8*) - 1),
 
   in_bstream_overhead = in_bstream_payload_offset,
 };
 /*----------------------------------------------------------------------------*/
+/* the messages written in batch are chained, so they take a single slot on
+   the input queue */
+static inline bl_u8** in_bstream_next (bl_u8* in_bstream)
+{
+  return (bl_u8**) (in_bstream + in_bstream_next_offset);
+}
+/*----------------------------------------------------------------------------*/
+/* 0 on messages owned by one group. Multicast messages are shared between
+   groups, the count of groups still holding it. */
+static inline bl_atomic_uword* in_bstream_refs (bl_u8* in_bstream)
+{
+  return (bl_atomic_uword*) (in_bstream + in_bstream_refs_offset);
+}
+/*----------------------------------------------------------------------------*/
 static inline bl_timept32* in_bstream_timept32 (bl_u8* in_bstream)
 {
   return (bl_timept32*) (in_bstream + in_bstream_timept32_offset);
@@ -39,9 +66,10 @@ static inline bl_u16* in_bstream_payload_size (bl_u8* in_bstream)
   return (bl_u16*) (in_bstream + in_bstream_payload_size_offset);
 }
 /*----------------------------------------------------------------------------*/
-static inline bl_u8* in_bstream_refcount (bl_u8* in_bstream)
+/* the "ssc_bstream_pool" size class it was allocated from */
+static inline bl_u8* in_bstream_pool_class (bl_u8* in_bstream)
 {
-  return (bl_u8*) (in_bstream + in_bstream_refcount_offset);
+  return in_bstream + in_bstream_pool_class_offset;
 }
 /*----------------------------------------------------------------------------*/
 static inline bl_uword in_bstream_total_size (bl_uword payload)
@@ -59,12 +87,25 @@ static inline bl_u8* in_bstream_from_payload (bl_u8* in_bstream_payload)
   return in_bstream_payload - in_bstream_payload_offset;
 }
 /*----------------------------------------------------------------------------*/
-static inline bl_u8* in_bstream_alloc (bl_uword size, bl_alloc_tbl const* alloc)
+/* in_bstream_pattern_set: marks a bytestream owned by the user. It is on the
+   timestamp field, which is only written when sending. */
+/*----------------------------------------------------------------------------*/
+static inline void in_bstream_pattern_set (bl_u8* in_bstream)
 {
-  bl_u8* ret;
-  ret = bl_alloc (alloc, in_bstream_total_size (size));
+  *in_bstream_timept32 (in_bstream) = 0xdeadbeef;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u8* in_bstream_alloc (bl_uword size, ssc_bstream_pool* pool)
+{
+  bl_u8  cls;
+  bl_u8* ret = ssc_bstream_pool_alloc(
+    pool, in_bstream_total_size (size), &cls
+    );
   if (ret) {
-    *in_bstream_timept32 (ret) = 0xdeadbeef;
+    *in_bstream_pool_class (ret) = cls;
+    *in_bstream_next (ret)       = nullptr;
+    in_bstream_pattern_set (ret);
+    bl_atomic_uword_store_rlx (in_bstream_refs (ret), 0);
   }
   return ret;
 }
@@ -75,10 +116,20 @@ static inline bool in_bstream_pattern_validate (bl_u8* in_bstream)
 }
 /*----------------------------------------------------------------------------*/
 static inline void in_bstream_dealloc(
-  bl_u8* in_bstream, bl_alloc_tbl const* alloc
+  bl_u8* in_bstream, ssc_bstream_pool* pool
   )
 {
-  bl_dealloc (alloc, in_bstream);
+  /*the reference count is set before a multicast message is visible to any
+    group, so non shared messages skip the atomic decrement*/
+  bl_atomic_uword* refs = in_bstream_refs (in_bstream);
+  if (bl_atomic_uword_load_rlx (refs) != 0 &&
+    bl_atomic_uword_fetch_sub (refs, 1, bl_mo_acq_rel) != 1
+    ) {
+    return;
+  }
+  ssc_bstream_pool_dealloc(
+    pool, in_bstream, *in_bstream_pool_class (in_bstream)
+    );
 }
 /*----------------------------------------------------------------------------*/
 
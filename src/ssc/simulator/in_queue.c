@@ -1,41 +1,105 @@
 
+#include <string.h>
+
 #include <bl/base/assert.h>
 #include <bl/base/alignment.h>
 #include <ssc/simulator/in_queue.h>
+#include <ssc/simulator/in_bstream.h>
 
+/*----------------------------------------------------------------------------*/
+/* stack storage for a slot of any size */
+typedef union ssc_in_q_slot_buffer {
+  ssc_in_slot slot;
+  bl_u8       mem[ssc_in_slot_max_inline + sizeof (ssc_in_slot) + 8];
+}
+ssc_in_q_slot_buffer;
 /*----------------------------------------------------------------------------*/
 bl_err ssc_in_q_init(
-  ssc_in_q* q, bl_uword queue_size, bl_alloc_tbl const* alloc
+  ssc_in_q*           q,
+  bl_uword            queue_size,
+  bl_uword            slot_size,
+  bl_alloc_tbl const* alloc
   )
 {
-  q->last_op = bl_mpmc_b_first_op;
-  bl_err err = bl_mpmc_bt_init(
-    &q->queue, alloc, queue_size, sizeof (bl_u8*), bl_alignof (bl_u8*)
+  bl_assert (slot_size >= sizeof (ssc_in_slot));
+  bl_assert (slot_size <= ssc_in_slot_size (ssc_in_slot_max_inline));
+  q->last_op   = bl_mpmc_b_first_op;
+  q->chain     = nullptr;
+  q->slot_size = slot_size;
+  bl_atomic_uword_store_rlx (&q->wwaiting, 0);
+  bl_err err = bl_tm_sem_init (&q->wsem);
+  if (err.own) {
+    return err;
+  }
+  err = bl_mpmc_bt_init(
+    &q->queue, alloc, queue_size, slot_size, bl_alignof (ssc_in_slot)
     );
-  if (!err.own) {
-    bl_assert_side_effect(
-      bl_mpmc_bt_producer_signal_try_set_tmatch(
-        &q->queue, &q->last_op, in_q_sig_idle
-        ).own == bl_ok);
+  if (err.own) {
+    bl_tm_sem_destroy (&q->wsem);
+    return err;
   }
+  bl_assert_side_effect(
+    bl_mpmc_bt_producer_signal_try_set_tmatch(
+      &q->queue, &q->last_op, in_q_sig_idle
+      ).own == bl_ok);
   return err;
 }
 /*----------------------------------------------------------------------------*/
-bl_err ssc_in_q_destroy (ssc_in_q* q, bl_alloc_tbl const* alloc)
+bl_err ssc_in_q_destroy(
+  ssc_in_q* q, ssc_bstream_pool* pool, bl_alloc_tbl const* alloc
+  )
 {
-  bl_u8* dat;
-  while ((dat = ssc_in_q_try_consume (q))) { /*deliberate assingment*/
-    bl_dealloc (alloc, dat);
+  ssc_in_q_slot_buffer buff;
+  while (ssc_in_q_try_consume (q, &buff.slot)) {
+    ssc_in_slot_release (&buff.slot, pool);
   }
   bl_mpmc_bt_destroy (&q->queue, alloc);
+  bl_tm_sem_destroy (&q->wsem);
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
-bl_u8* ssc_in_q_try_consume (ssc_in_q* q)
+bool ssc_in_q_try_consume (ssc_in_q* q, ssc_in_slot* s)
+{
+  if (q->chain) {
+    s->bstream = q->chain;
+  }
+  else if (
+    bl_mpmc_bt_consume_sc (&q->queue, &q->last_op, s).own != bl_ok
+    ) {
+    return false;
+  }
+  else if (!s->bstream) {
+    return true; /*inline*/
+  }
+  q->chain = *in_bstream_next (s->bstream);
+  s->time  = *in_bstream_timept32 (s->bstream);
+  s->size  = *in_bstream_payload_size (s->bstream);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_in_q_wake_writers (ssc_in_q* q)
 {
-  bl_u8* ret = nullptr;
-  bl_mpmc_bt_consume_sc (&q->queue, &q->last_op, &ret);
-  return ret;
+  /*pairs with the store on "ssc_in_q_writer_register": either the writer
+    sees the room when retrying or this sees the registration. A writer that
+    didn't need to wait leaves a stale count, which just causes a spurious
+    wake up later*/
+  if (bl_atomic_uword_load (&q->wwaiting, bl_mo_seq_cst) == 0) {
+    return;
+  }
+  bl_uword count = bl_atomic_uword_exchange (&q->wwaiting, 0, bl_mo_relaxed);
+  while (count--) {
+    bl_tm_sem_signal (&q->wsem);
+  }
+}
+/*----------------------------------------------------------------------------*/
+void ssc_in_q_writer_register (ssc_in_q* q)
+{
+  bl_atomic_uword_fetch_add (&q->wwaiting, 1, bl_mo_seq_cst);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_in_q_writer_wait (ssc_in_q* q, bl_u32 usec)
+{
+  (void) bl_tm_sem_wait (&q->wsem, usec);
 }
 /*---------------------------------------------------------------------------*/
 bl_err ssc_in_q_block (ssc_in_q* q)
@@ -59,11 +123,13 @@ bl_err ssc_in_q_try_switch_to_idle (ssc_in_q* q, ssc_in_q_sig* prev_sig)
   return err;
 }
 /*----------------------------------------------------------------------------*/
-bl_err ssc_in_q_produce (ssc_in_q* q, bl_u8* in_bstream, bool* idle)
+static bl_err ssc_in_q_produce_slot(
+  ssc_in_q* q, ssc_in_slot const* s, bool* idle
+  )
 {
   bl_mpmc_b_op op;
   bl_err err = bl_mpmc_bt_produce_sig_fallback(
-    &q->queue, &op, &in_bstream, true, in_q_ok, in_q_blocked, in_q_blocked
+    &q->queue, &op, s, true, in_q_ok, in_q_blocked, in_q_blocked
     );
   if (err.own == bl_ok) {
     *idle = (bl_mpmc_b_sig_decode (op) == in_q_sig_idle);
@@ -74,4 +140,28 @@ bl_err ssc_in_q_produce (ssc_in_q* q, bl_u8* in_bstream, bool* idle)
   return err;
 }
 /*----------------------------------------------------------------------------*/
-
+bl_err ssc_in_q_produce (ssc_in_q* q, bl_u8* in_bstream, bool* idle)
+{
+  /*the queue copies a whole slot, the unused inline payload is garbage*/
+  ssc_in_q_slot_buffer buff;
+  buff.slot.bstream = in_bstream;
+  return ssc_in_q_produce_slot (q, &buff.slot, idle);
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_in_q_produce_inline(
+  ssc_in_q*   q,
+  void const* payload,
+  bl_u16      size,
+  bl_timept32 time,
+  bool*       idle
+  )
+{
+  bl_assert (size <= ssc_in_slot_inline_capacity (q->slot_size));
+  ssc_in_q_slot_buffer buff;
+  buff.slot.bstream = nullptr;
+  buff.slot.time    = time;
+  buff.slot.size    = size;
+  memcpy (buff.slot.payload, payload, size);
+  return ssc_in_q_produce_slot (q, &buff.slot, idle);
+}
+/*----------------------------------------------------------------------------*/
@@ -4,8 +4,16 @@
 #include <bl/base/platform.h>
 #include <bl/base/integer.h>
 #include <bl/base/utility.h>
+#include <bl/base/alignment.h>
+#include <bl/base/time.h>
+#include <bl/base/memory_range.h>
+#include <bl/base/atomic.h>
+#include <bl/base/semaphore.h>
 #include <bl/nonblock/mpmc_bt.h>
 
+#include <ssc/simulator/bstream_pool.h>
+#include <ssc/simulator/in_bstream.h>
+
 /*---------------------------------------------------------------------------*/
 enum ssc_in_q_sig_e {
   in_q_ok       = 0,
@@ -14,19 +22,104 @@ enum ssc_in_q_sig_e {
 };
 typedef bl_uword ssc_in_q_sig;
 /*----------------------------------------------------------------------------*/
+/* A slot of the input queue (and of the group input log). Messages up to the
+   inline size of the simulator are copied into the slot itself, so they don't
+   need an allocation. Bigger messages are an "in_bstream" referenced from the
+   slot.
+
+   The slots are "ssc_in_slot_size" bytes long. The inline payload isn't
+   aligned. */
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_in_slot {
+  bl_u8*      bstream; /*nullptr when the payload is inline*/
+  bl_timept32 time;
+  bl_u16      size;
+  bl_u8       payload[]; /*inline payload*/
+}
+ssc_in_slot;
+/*----------------------------------------------------------------------------*/
+enum ssc_in_slot_e {
+  ssc_in_slot_max_inline = 240,
+};
+/*----------------------------------------------------------------------------*/
+/* ssc_in_slot_size: the slot size for an inline payload of at least
+   "inline_size" bytes. The padding is usable inline payload too. */
+/*----------------------------------------------------------------------------*/
+static inline bl_uword ssc_in_slot_size (bl_uword inline_size)
+{
+  bl_uword size = offsetof (ssc_in_slot, payload) + inline_size;
+  return bl_max(
+    bl_next_offset_aligned_to_type (size, bl_u8*), sizeof (ssc_in_slot)
+    );
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword ssc_in_slot_inline_capacity (bl_uword slot_size)
+{
+  return slot_size - offsetof (ssc_in_slot, payload);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_memr16 ssc_in_slot_payload (ssc_in_slot* s)
+{
+  return bl_memr16_rv(
+    s->bstream ? in_bstream_payload (s->bstream) : s->payload, s->size
+    );
+}
+/*----------------------------------------------------------------------------*/
+static inline void ssc_in_slot_release (ssc_in_slot* s, ssc_bstream_pool* pool)
+{
+  if (s->bstream) {
+    in_bstream_dealloc (s->bstream, pool);
+    s->bstream = nullptr;
+  }
+}
+/*----------------------------------------------------------------------------*/
+/* The group input queue. Writers that find it full can sleep on "wsem" until
+   the group consumes ("ssc_write_timed"). They register on "wwaiting" before
+   retrying, the consumer only signals when it sees registered writers, so
+   consuming doesn't pay a syscall when nobody is waiting. */
+/*----------------------------------------------------------------------------*/
 typedef struct ssc_in_q {
-  bl_mpmc_bt   queue;
-  bl_mpmc_b_op last_op;
+  bl_mpmc_bt      queue;
+  bl_mpmc_b_op    last_op;
+  bl_u8*          chain; /*rest of the last consumed batch*/
+  bl_uword        slot_size;
+  bl_tm_sem       wsem;
+  bl_atomic_uword wwaiting; /*writers waiting for room*/
 }
 ssc_in_q;
 /*----------------------------------------------------------------------------*/
 extern bl_err ssc_in_q_init(
-  ssc_in_q* q, bl_uword queue_size, bl_alloc_tbl const* alloc
+  ssc_in_q*           q,
+  bl_uword            queue_size,
+  bl_uword            slot_size,
+  bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_in_q_destroy: the pending messages are returned to "pool" */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_in_q_destroy(
+  ssc_in_q* q, ssc_bstream_pool* pool, bl_alloc_tbl const* alloc
   );
 /*----------------------------------------------------------------------------*/
-extern bl_err ssc_in_q_destroy (ssc_in_q* q, bl_alloc_tbl const* alloc);
+/* ssc_in_q_try_consume: gets the messages one by one, batches included.
+   "s" has to be "slot_size" bytes. The referenced messages get their time and
+   size copied to the slot. */
+/*----------------------------------------------------------------------------*/
+extern bool ssc_in_q_try_consume (ssc_in_q* q, ssc_in_slot* s);
+/*----------------------------------------------------------------------------*/
+/* ssc_in_q_wake_writers: to be called by the consumer after consuming */
+/*----------------------------------------------------------------------------*/
+extern void ssc_in_q_wake_writers (ssc_in_q* q);
 /*----------------------------------------------------------------------------*/
-extern bl_u8* ssc_in_q_try_consume (ssc_in_q* q);
+/* ssc_in_q_writer_register: to be called by a writer that found the queue
+   full before retrying. Thread-safe. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_in_q_writer_register (ssc_in_q* q);
+/*----------------------------------------------------------------------------*/
+/* ssc_in_q_writer_wait: sleeps until the consumer consumes after the
+   registration or "usec" pass. It can wake up spuriously. Thread-safe. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_in_q_writer_wait (ssc_in_q* q, bl_u32 usec);
 /*---------------------------------------------------------------------------*/
 extern bl_err ssc_in_q_block (ssc_in_q* q);
 /*----------------------------------------------------------------------------*/
@@ -34,10 +127,24 @@ extern bl_err ssc_in_q_try_switch_to_idle(
   ssc_in_q* q, ssc_in_q_sig* prev_sig
   );
 /*----------------------------------------------------------------------------*/
+/* ssc_in_q_produce: "in_bstream" can be a chain of messages (see
+   "in_bstream_next"), produced with a single queue operation. */
+/*----------------------------------------------------------------------------*/
 extern bl_err ssc_in_q_produce(
   ssc_in_q* q, bl_u8* in_bstream, bool* idle_signal
   );
 /*----------------------------------------------------------------------------*/
+/* ssc_in_q_produce_inline: copies "payload" into the queue slot. "size" has
+   to fit on the slot. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_in_q_produce_inline(
+  ssc_in_q*    q,
+  void const*  payload,
+  bl_u16       size,
+  bl_timept32  time,
+  bool*        idle_signal
+  );
+/*----------------------------------------------------------------------------*/
 
 #endif /* __SSC_IN_QUEUE_H__ */
 
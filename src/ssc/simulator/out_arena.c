@@ -0,0 +1,123 @@
+#include <bl/base/assert.h>
+#include <bl/base/integer_math.h>
+
+#include <ssc/simulator/out_arena.h>
+
+/*----------------------------------------------------------------------------*/
+enum out_arena_e {
+  out_arena_hdr_size = sizeof (bl_atomic_uword),
+  out_arena_freed    = 1, /*block sizes are multiples of the header size*/
+};
+/*----------------------------------------------------------------------------*/
+static inline bl_uword out_arena_block_size (bl_uword payload)
+{
+  bl_uword mask = out_arena_hdr_size - 1;
+  return out_arena_hdr_size + ((payload + mask) & ~mask);
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_atomic_uword* out_arena_hdr (ssc_out_arena* a, bl_uword pos)
+{
+  return (bl_atomic_uword*) (a->mem + (pos & (a->size - 1)));
+}
+/*----------------------------------------------------------------------------*/
+static void out_arena_reclaim (ssc_out_arena* a)
+{
+  while (a->tail != a->head) {
+    bl_uword v = bl_atomic_uword_load(
+      out_arena_hdr (a, a->tail), bl_mo_acquire
+      );
+    if (!(v & out_arena_freed)) {
+      break;
+    }
+    a->tail += v & ~((bl_uword) out_arena_freed);
+  }
+}
+/*----------------------------------------------------------------------------*/
+void ssc_out_arena_init (ssc_out_arena* a, bl_uword size)
+{
+  bl_assert (a);
+  a->mem      = nullptr;
+  a->size     = size ? bl_round_next_pow2_u (size) : 0;
+  a->head     = 0;
+  a->tail     = 0;
+  a->reserved = 0;
+  a->owner    = nullptr;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_out_arena_destroy (ssc_out_arena* a, bl_alloc_tbl const* alloc)
+{
+  bl_assert (a && alloc);
+  if (a->mem) {
+    out_arena_reclaim (a);
+    bl_assert (a->tail == a->head);
+    bl_dealloc (alloc, a->mem);
+    a->mem = nullptr;
+  }
+}
+/*----------------------------------------------------------------------------*/
+bl_u8* ssc_out_arena_reserve(
+  ssc_out_arena*      a,
+  bl_uword            size,
+  void const*         owner,
+  bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (a && owner && alloc);
+  a->reserved    = 0;
+  a->owner       = nullptr;
+  bl_uword bytes = out_arena_block_size (size);
+  if (bytes > a->size) {
+    return nullptr;
+  }
+  if (!a->mem) {
+    a->mem = (bl_u8*) bl_alloc (alloc, a->size);
+    if (!a->mem) {
+      return nullptr;
+    }
+  }
+  out_arena_reclaim (a);
+  /*a block doesn't wrap around, the space up to the end is skipped*/
+  bl_uword to_end = a->size - (a->head & (a->size - 1));
+  bl_uword skip   = (bytes > to_end) ? to_end : 0;
+  if (a->size - (a->head - a->tail) < skip + bytes) {
+    return nullptr;
+  }
+  if (skip) {
+    bl_atomic_uword_store_rlx(
+      out_arena_hdr (a, a->head), skip | out_arena_freed
+      );
+    a->head += skip;
+  }
+  a->reserved = bytes;
+  a->owner    = owner;
+  return ((bl_u8*) out_arena_hdr (a, a->head)) + out_arena_hdr_size;
+}
+/*----------------------------------------------------------------------------*/
+bl_u8* ssc_out_arena_commit(
+  ssc_out_arena* a, bl_uword size, void const* owner
+  )
+{
+  bl_assert (a && owner);
+  bl_uword bytes = out_arena_block_size (size);
+  if (!a->reserved || a->owner != owner || bytes > a->reserved) {
+    return nullptr;
+  }
+  /*published to the releasing thread through the output queue*/
+  bl_atomic_uword* hdr = out_arena_hdr (a, a->head);
+  bl_atomic_uword_store_rlx (hdr, bytes);
+  a->head    += bytes;
+  a->reserved = 0;
+  a->owner    = nullptr;
+  return ((bl_u8*) hdr) + out_arena_hdr_size;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_out_arena_release (void const* mem)
+{
+  bl_assert (mem);
+  bl_atomic_uword* hdr =
+    (bl_atomic_uword*) (((bl_u8*) mem) - out_arena_hdr_size);
+  bl_uword v = bl_atomic_uword_load_rlx (hdr);
+  bl_assert (!(v & out_arena_freed));
+  bl_atomic_uword_store (hdr, v | out_arena_freed, bl_mo_release);
+}
+/*----------------------------------------------------------------------------*/
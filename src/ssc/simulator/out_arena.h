@@ -0,0 +1,68 @@
+#ifndef __SSC_OUT_ARENA_H__
+#define __SSC_OUT_ARENA_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+#include <bl/base/allocator.h>
+#include <bl/base/atomic.h>
+
+/*----------------------------------------------------------------------------*/
+/* A ring of output memory owned by a fiber group, for "ssc_output_reserve"
+   and "ssc_output_commit". Only the thread running the group reserves and
+   commits. The arena is shared by all the fibers of the group, so each
+   reservation records the fiber that did it.
+
+   Each block is preceded by a header word with its size in bytes and a
+   "freed" bit. The memory of the read outputs is released from any thread by
+   setting that bit, which is just a store. The group thread reclaims all the
+   consecutive freed blocks at the tail on its next reservation, so memory is
+   given back in bulk and in order: a block that isn't released yet keeps the
+   ones after it from being reused.
+
+   The memory is allocated on the first reservation, so groups that don't use
+   it don't pay for it. */
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_out_arena {
+  bl_u8*      mem;
+  bl_uword    size;     /*power of two, 0 disables the arena*/
+  bl_uword    head;     /*free running offset of the next block*/
+  bl_uword    tail;     /*free running offset of the oldest unreclaimed block*/
+  bl_uword    reserved; /*block bytes of the pending reservation, 0 if none*/
+  void const* owner;    /*reserver of the pending reservation*/
+}
+ssc_out_arena;
+/*----------------------------------------------------------------------------*/
+extern void ssc_out_arena_init (ssc_out_arena* a, bl_uword size);
+/*----------------------------------------------------------------------------*/
+/* ssc_out_arena_destroy: all the committed blocks have to be released */
+/*----------------------------------------------------------------------------*/
+extern void ssc_out_arena_destroy(
+  ssc_out_arena* a, bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_out_arena_reserve: returns "size" writable bytes or null if there is no
+   room. A pending reservation that wasn't committed is discarded, even if it
+   was done by another "owner". */
+/*----------------------------------------------------------------------------*/
+extern bl_u8* ssc_out_arena_reserve(
+  ssc_out_arena*      a,
+  bl_uword            size,
+  void const*         owner,
+  bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_out_arena_commit: keeps the first "size" bytes of the pending
+   reservation. Returns the same pointer that "ssc_out_arena_reserve" did, or
+   null if there is no pending reservation from "owner". */
+/*----------------------------------------------------------------------------*/
+extern bl_u8* ssc_out_arena_commit(
+  ssc_out_arena* a, bl_uword size, void const* owner
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_out_arena_release: "mem" is a pointer returned by "ssc_out_arena_commit".
+   Thread-safe. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_out_arena_release (void const* mem);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_OUT_ARENA_H__ */
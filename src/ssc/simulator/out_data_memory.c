@@ -2,6 +2,7 @@
 #include <bl/base/utility.h>
 
 #include <ssc/simulator/out_data_memory.h>
+#include <ssc/simulator/out_arena.h>
 /*----------------------------------------------------------------------------*/
 void ssc_out_memory_dealloc(
   ssc_sim_dealloc_signature f,
@@ -10,7 +11,10 @@ void ssc_out_memory_dealloc(
   )
 {
   bl_assert (f && d);
-  if (ssc_output_is_dynamic (d)) {
+  if (d->type & ssc_type_is_arena_mask) {
+    ssc_out_arena_release (bl_memr16_beg (d->data));
+  }
+  else if (ssc_output_is_dynamic (d)) {
     bl_assert (!ssc_output_is_error (d));
     f(
       bl_memr16_beg (d->data),
@@ -21,3 +25,23 @@ void ssc_out_memory_dealloc(
   }
 }
 /*----------------------------------------------------------------------------*/
+void ssc_out_memory_dealloc_batch(
+  ssc_sim_dealloc_batch_func f,
+  void*                      global_sim_context,
+  ssc_output_data const*     d,
+  bl_uword                   count
+  )
+{
+  bl_assert (f && (d || !count));
+  bool dynamic = false;
+  for (bl_uword i = 0; i < count; ++i) {
+    if (d[i].type & ssc_type_is_arena_mask) {
+      ssc_out_arena_release (bl_memr16_beg (d[i].data));
+    }
+    dynamic |= ssc_output_is_dynamic (&d[i]);
+  }
+  if (dynamic) {
+    f (d, count, global_sim_context);
+  }
+}
+/*----------------------------------------------------------------------------*/
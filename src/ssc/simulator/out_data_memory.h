@@ -10,6 +10,16 @@ extern void ssc_out_memory_dealloc(
   ssc_output_data const*    d
   );
 /*----------------------------------------------------------------------------*/
+/* ssc_out_memory_dealloc_batch: releases the arena entries here and passes
+   the array to "f" if it contains dynamic entries */
+/*----------------------------------------------------------------------------*/
+extern void ssc_out_memory_dealloc_batch(
+  ssc_sim_dealloc_batch_func f,
+  void*                      global_sim_context,
+  ssc_output_data const*     d,
+  bl_uword                   count
+  );
+/*----------------------------------------------------------------------------*/
 
 #endif /* __SSC_OUT_DATA_MEMORY_H__ */
 
@@ -7,49 +7,177 @@
 #include <bl/base/integer_manipulation.h>
 #include <bl/base/integer_math.h>
 #include <bl/base/deadline.h>
-#include <bl/nonblock/backoff.h>
 
 #include <ssc/simulator/out_queue.h>
 #include <ssc/simulator/out_data_memory.h>
 #include <ssc/simulator/global.h>
 
 /*----------------------------------------------------------------------------*/
-typedef struct out_q_sorted_entry {
-  bl_timept32        time;
-  out_q_sorted_value value;
+typedef struct out_q_entry {
+  ssc_output_data d;
+  bl_uword        seq;
 }
-out_q_sorted_entry;
+out_q_entry;
 /*----------------------------------------------------------------------------*/
-static inline bl_word out_q_sorted_value_cmp (void const* a, void const* b)
+static inline bool out_q_entry_less (out_q_entry const* a, out_q_entry const* b)
 {
-  out_q_sorted_entry const* ae = (out_q_sorted_entry const*) a;
-  out_q_sorted_entry const* be = (out_q_sorted_entry const*) b;
-  return memcmp (&ae->value, &be->value, sizeof ae->value);
+  bl_timept32diff diff = bl_timept32_get_diff (a->d.time, b->d.time);
+  return diff < 0 || (diff == 0 && (bl_word) (a->seq - b->seq) < 0);
 }
 /*----------------------------------------------------------------------------*/
-bl_define_flat_deadlines_funcs(
-  out_q_sorted, out_q_sorted_entry, out_q_sorted_value_cmp
-  )
+static void out_q_heap_push (ssc_out_q* q, ssc_output_data const* d)
+{
+  bl_assert (q->heap_size < q->heap_capacity);
+  out_q_entry e;
+  e.d   = *d;
+  e.seq = q->seq++;
+  bl_uword i = q->heap_size++;
+  while (i > 0) {
+    bl_uword parent = (i - 1) / 2;
+    if (!out_q_entry_less (&e, &q->heap[parent])) {
+      break;
+    }
+    q->heap[i] = q->heap[parent];
+    i          = parent;
+  }
+  q->heap[i] = e;
+}
 /*----------------------------------------------------------------------------*/
-bl_err ssc_out_q_init (ssc_out_q* q, bl_uword size, ssc_global const* global)
+static void out_q_heap_pop (ssc_out_q* q)
 {
-  bl_assert (q && global);
-  size       = bl_round_next_pow2_u (size);
-  bl_err err = bl_mpmc_bt_init(
-    &q->queue,
-    global->alloc,
-    size,
-    sizeof (ssc_output_data),
-    bl_alignof (ssc_output_data)
-    );
-  if (err.own) { return err; }
-  err = out_q_sorted_init(
-    &q->tsorted, bl_timept32_get(), size * 4, global->alloc
+  bl_assert (q->heap_size > 0);
+  out_q_entry e = q->heap[--q->heap_size];
+  bl_uword    i = 0;
+  while (true) {
+    bl_uword child = (i * 2) + 1;
+    if (child >= q->heap_size) {
+      break;
+    }
+    if (child + 1 < q->heap_size &&
+      out_q_entry_less (&q->heap[child + 1], &q->heap[child])
+      ) {
+      ++child;
+    }
+    if (!out_q_entry_less (&q->heap[child], &e)) {
+      break;
+    }
+    q->heap[i] = q->heap[child];
+    i          = child;
+  }
+  q->heap[i] = e;
+}
+/*----------------------------------------------------------------------------*/
+static inline void out_q_lane_unblock (ssc_out_q* q, bl_uword lane)
+{
+  /*pairs with the store on "ssc_out_q_produce_or_block": either the producer
+    sees the room when retrying or this sees the flag*/
+  if (q->lane_blocked &&
+    bl_atomic_uword_load (&q->lane_blocked[lane], bl_mo_seq_cst) &&
+    bl_atomic_uword_exchange (&q->lane_blocked[lane], 0, bl_mo_relaxed)
+    ) {
+    q->lane_room (q->lane_room_context, (ssc_group_id) lane);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_err out_q_lane_consume (ssc_out_q* q, ssc_output_data* d)
+{
+  /*round-robin, so a busy group doesn't starve the others*/
+  for (bl_uword i = 0; i < q->lane_count; ++i) {
+    bl_uword     lane = q->lane_next;
+    bl_mpmc_b_op op;
+    q->lane_next = (lane + 1 < q->lane_count) ? lane + 1 : 0;
+    if (!bl_mpmc_bt_consume_sc (&q->lanes[lane], &op, d).own) {
+      out_q_lane_unblock (q, lane);
+      return bl_mkok();
+    }
+  }
+  return bl_mkerr (bl_empty);
+}
+/*----------------------------------------------------------------------------*/
+static void out_q_lanes_destroy (ssc_out_q* q, bl_uword count)
+{
+  for (bl_uword i = 0; i < count; ++i) {
+    bl_mpmc_bt_destroy (&q->lanes[i], q->global->alloc);
+  }
+  bl_dealloc (q->global->alloc, q->lanes);
+  q->lanes = nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static void out_q_arenas_destroy (ssc_out_q* q)
+{
+  for (bl_uword i = 0; i < q->lane_count; ++i) {
+    ssc_out_arena_destroy (&q->arenas[i], q->global->alloc);
+  }
+  bl_dealloc (q->global->alloc, q->arenas);
+  q->arenas = nullptr;
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_out_q_init(
+  ssc_out_q*        q,
+  bl_uword          lane_size,
+  bl_uword          lane_count,
+  bl_uword          arena_size,
+  ssc_global const* global
+  )
+{
+  bl_assert (q && global && lane_count);
+  memset (q, 0, sizeof *q);
+  q->global     = global;
+  lane_size     = bl_round_next_pow2_u (lane_size);
+  q->lanes      = (bl_mpmc_bt*) bl_alloc(
+    global->alloc, lane_count * sizeof *q->lanes
     );
+  if (!q->lanes) {
+    return bl_mkerr (bl_alloc);
+  }
+  bl_err err = bl_tm_sem_init (&q->sem);
   if (err.own) {
-    bl_mpmc_bt_destroy (&q->queue, global->alloc);
+    bl_dealloc (global->alloc, q->lanes);
+    q->lanes = nullptr;
+    return err;
+  }
+  bl_uword i;
+  for (i = 0; i < lane_count; ++i) {
+    err = bl_mpmc_bt_init(
+      &q->lanes[i],
+      global->alloc,
+      lane_size,
+      sizeof (ssc_output_data),
+      bl_alignof (ssc_output_data)
+      );
+    if (err.own) {
+      goto destroy_lanes;
+    }
+  }
+  q->lane_count    = lane_count;
+  /*as many entries as all the lanes together, so the merge room per group
+    doesn't shrink as the group count grows*/
+  q->heap_capacity = lane_size * lane_count;
+  q->heap = (out_q_entry*) bl_alloc(
+    global->alloc, q->heap_capacity * sizeof *q->heap
+    );
+  if (!q->heap) {
+    err = bl_mkerr (bl_alloc);
+    goto destroy_lanes;
   }
-  q->global = global;
+  q->arenas = (ssc_out_arena*) bl_alloc(
+    global->alloc, lane_count * sizeof *q->arenas
+    );
+  if (!q->arenas) {
+    err = bl_mkerr (bl_alloc);
+    goto destroy_heap;
+  }
+  for (i = 0; i < lane_count; ++i) {
+    ssc_out_arena_init (&q->arenas[i], arena_size);
+  }
+  return err;
+
+destroy_heap:
+  bl_dealloc (global->alloc, q->heap);
+  q->heap = nullptr;
+destroy_lanes:
+  out_q_lanes_destroy (q, i);
+  bl_tm_sem_destroy (&q->sem);
   return err;
 }
 /*----------------------------------------------------------------------------*/
@@ -57,83 +185,164 @@ void ssc_out_q_destroy (ssc_out_q* q)
 {
   bl_assert (q);
   ssc_output_data dat;
-  bl_uword        v;
-
-  while (ssc_out_q_consume (q, &v, &dat, 1, 0).own == bl_ok) {
+  if (q->lane_blocked) {
+    /*no producer is waiting anymore*/
+    bl_dealloc (q->global->alloc, q->lane_blocked);
+    q->lane_blocked = nullptr;
+  }
+  /*including the non expired ones*/
+  while (out_q_lane_consume (q, &dat).own == bl_ok) {
     ssc_out_memory_dealloc(
       q->global->sim_dealloc, q->global->sim_context, &dat
       );
   }
-  bl_mpmc_bt_destroy (&q->queue, q->global->alloc);
-  out_q_sorted_destroy (&q->tsorted, q->global->alloc);
+  for (bl_uword i = 0; i < q->heap_size; ++i) {
+    ssc_out_memory_dealloc(
+      q->global->sim_dealloc, q->global->sim_context, &q->heap[i].d
+      );
+  }
+  /*after the drain, the arena outputs are released*/
+  out_q_arenas_destroy (q);
+  out_q_lanes_destroy (q, q->lane_count);
+  bl_dealloc (q->global->alloc, q->heap);
+  q->heap      = nullptr;
+  q->heap_size = 0;
+  bl_tm_sem_destroy (&q->sem);
 }
 /*----------------------------------------------------------------------------*/
 bl_err ssc_out_q_produce (ssc_out_q* q, ssc_output_data* d)
 {
-  bl_assert (q && d);
+  bl_assert (q && d && d->gid < q->lane_count);
   bl_mpmc_b_op op;
-  return bl_mpmc_bt_produce_sp (&q->queue, &op, d);
+  bl_err err = bl_mpmc_bt_produce_sp (&q->lanes[d->gid], &op, d);
+  if (!err.own) {
+    ssc_out_q_wake_reader (q);
+  }
+  return err;
 }
 /*----------------------------------------------------------------------------*/
-static inline void copy_to_output_data(
-  ssc_output_data* d, out_q_sorted_entry const* e
+bl_err ssc_out_q_set_backpressure(
+  ssc_out_q* q, ssc_out_q_lane_room_func lane_room, void* context
   )
 {
-  d->data = e->value.data;
-  d->gid  = e->value.gid;
-  d->type = e->value.type;
-  d->time = e->time;
+  bl_assert (q && lane_room && !q->lane_blocked);
+  q->lane_blocked = (bl_atomic_uword*) bl_alloc(
+    q->global->alloc, q->lane_count * sizeof *q->lane_blocked
+    );
+  if (!q->lane_blocked) {
+    return bl_mkerr (bl_alloc);
+  }
+  for (bl_uword i = 0; i < q->lane_count; ++i) {
+    bl_atomic_uword_store_rlx (&q->lane_blocked[i], 0);
+  }
+  q->lane_room         = lane_room;
+  q->lane_room_context = context;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_out_q_produce_or_block (ssc_out_q* q, ssc_output_data* d)
+{
+  bl_assert (q && d && q->lane_blocked);
+  /*left raised on success: a spurious "lane_room" call is harmless, but
+    lowering it could lose the call of another waiting producer of the lane*/
+  bl_atomic_uword_store (&q->lane_blocked[d->gid], 1, bl_mo_seq_cst);
+  return ssc_out_q_produce (q, d);
 }
 /*----------------------------------------------------------------------------*/
-static inline void  copy_to_sorted_data(
-  out_q_sorted_entry* e, ssc_output_data const* d
-  )
+void ssc_out_q_wake_reader (ssc_out_q* q)
 {
-   e->value.data = d->data;
-   e->value.gid  = d->gid;
-   e->value.type = d->type;
-   e->time       = d->time;
+  /*pairs with the store on "out_q_wait": either the reader sees the new
+    entry when rechecking or this sees the flag*/
+  if (bl_atomic_uword_load (&q->reader_waiting, bl_mo_seq_cst) &&
+    bl_atomic_uword_exchange (&q->reader_waiting, 0, bl_mo_relaxed)
+    ) {
+    bl_tm_sem_signal (&q->sem);
+    if (ssc_pollfd_enabled (&q->global->read_poll)) {
+      ssc_pollfd_signal (&q->global->read_poll);
+    }
+  }
 }
 /*----------------------------------------------------------------------------*/
 static bl_uword
   ssc_out_q_try_read (ssc_out_q* q, ssc_output_data* d, bl_uword count)
 {
-  bl_timept32 now         = bl_timept32_get();
-  bl_uword  copied      = 0;
-  bl_uword  last_copied = 0;
-  out_q_sorted_entry const* outdata;
+  /*on virtual time mode the output is released following the virtual clock*/
+  bl_timept32 now         = ssc_global_now (q->global);
+  bl_uword    copied      = 0;
+  bl_uword    last_copied = 0;
 
 try_again:
-  while (copied < count) {
-    outdata = out_q_sorted_get_head_if_expired (&q->tsorted, true, now);
-    if (!outdata) {
-      break;
-    }
-    copy_to_output_data (d + copied, outdata);
-    out_q_sorted_drop_head (&q->tsorted);
+  while (copied < count && q->heap_size > 0 &&
+    bl_timept32_get_diff (q->heap[0].d.time, now) <= 0
+    ) {
+    d[copied] = q->heap[0].d;
+    out_q_heap_pop (q);
     ++copied;
   }
   if ((copied - last_copied) == 0) {
     return copied;
   }
   last_copied = copied;
-  now         = bl_timept32_get(); /*trying to save syscalls ot the bl_timept32*/
+  now         = ssc_global_now (q->global); /*trying to save syscalls ot the bl_timept32*/
   goto try_again; /* "while (1)" with no indentation */
 }
 /*----------------------------------------------------------------------------*/
 static bool ssc_out_q_transfer (ssc_out_q* q)
 {
-  bl_err err = bl_mkok();
-  while (!err.own && out_q_sorted_can_insert (&q->tsorted)) {
-    bl_mpmc_b_op       op;
-    ssc_output_data d;
-    out_q_sorted_entry e;
-    err = bl_mpmc_bt_consume_sc (&q->queue, &op, &d);
-    if (err.own) { break; }
-    copy_to_sorted_data (&e, &d);
-    out_q_sorted_insert (&q->tsorted, &e);
+  ssc_output_data d;
+  while (q->heap_size < q->heap_capacity &&
+    out_q_lane_consume (q, &d).own == bl_ok
+    ) {
+    out_q_heap_push (q, &d);
+  }
+  return q->heap_size < q->heap_capacity;
+}
+/*----------------------------------------------------------------------------*/
+static void out_q_wait (ssc_out_q* q, bl_timept32 deadline)
+{
+  bl_timept32diff sleep = bl_timept32_get_diff (deadline, bl_timept32_get());
+  if (q->heap_size > 0) {
+    /*the head is released at its timestamp. On virtual time the clock
+      advance wakes the reader*/
+    bl_timept32diff head = bl_timept32_get_diff(
+      q->heap[0].d.time, ssc_global_now (q->global)
+      );
+    sleep = (head < sleep) ? head : sleep;
+  }
+  if (sleep <= 0) {
+    return;
+  }
+  bl_atomic_uword_store (&q->reader_waiting, 1, bl_mo_seq_cst);
+  bl_uword heap_size = q->heap_size;
+  (void) ssc_out_q_transfer (q);
+  if (q->heap_size == heap_size) {
+    /*a stale signal from a previous wait just causes a spurious wake up*/
+    (void) bl_tm_sem_wait(
+      &q->sem, bl_timept32_to_usec ((bl_timept32) sleep) + 1
+      );
+  }
+  bl_atomic_uword_store (&q->reader_waiting, 0, bl_mo_relaxed);
+}
+/*----------------------------------------------------------------------------*/
+static void out_q_poll_rearm (ssc_out_q* q)
+{
+  ssc_pollfd const* p = &q->global->read_poll;
+  ssc_pollfd_clear (p);
+  bl_atomic_uword_store (&q->reader_waiting, 1, bl_mo_seq_cst);
+  (void) ssc_out_q_transfer (q);
+  if (q->heap_size == 0) {
+    return;
+  }
+  bl_timept32diff head = bl_timept32_get_diff(
+    q->heap[0].d.time, ssc_global_now (q->global)
+    );
+  if (head <= 0) {
+    ssc_pollfd_signal (p);
+  }
+  else if (!q->global->virtual_time) {
+    /*on virtual time the clock advance wakes the reader*/
+    ssc_pollfd_set_timer (p, bl_timept32_to_usec ((bl_timept32) head) + 1);
   }
-  return out_q_sorted_can_insert (&q->tsorted);
 }
 /*----------------------------------------------------------------------------*/
 bl_err ssc_out_q_consume(
@@ -148,38 +357,33 @@ bl_err ssc_out_q_consume(
   bl_assert (timeout_us >= 0);
   bl_assert (d_capacity > 0);
 
-  bl_timept32           bl_deadline;
-  bl_nonblock_backoff nb;
-  bool             tsorted_not_full;
+  bl_timept32 bl_deadline;
+  bool        heap_not_full;
 
   bl_timept32_deadline_init_usec (&bl_deadline, (bl_u32) timeout_us);
-  bl_nonblock_backoff_init_default (&nb, timeout_us / 4);
 
 try_again:
-  tsorted_not_full = ssc_out_q_transfer (q);
-  *d_consumed      = ssc_out_q_try_read (q, d, d_capacity);
+  heap_not_full = ssc_out_q_transfer (q);
+  *d_consumed   = ssc_out_q_try_read (q, d, d_capacity);
 
-  switch ((bl_u_bitv (*d_consumed == 0, 1) | bl_u_bitv (tsorted_not_full, 0))) {
+  switch ((bl_u_bitv (*d_consumed == 0, 1) | bl_u_bitv (heap_not_full, 0))) {
   case 0:
-    ssc_out_q_transfer (q); /*making room on the SPSC queue now if necessary*/
+    ssc_out_q_transfer (q); /*making room on the lanes now if necessary*/
     return bl_mkok();
   case 1:
     return bl_mkok(); /*fast-path*/
-  case 2:{ /*edge case*/
-    bl_mpmc_b_op       op;
-    ssc_output_data    d;
-    out_q_sorted_entry e;
-    bl_err err = bl_mpmc_bt_consume_sc (&q->queue, &op, &d);
-    if (!err.own) {
-      out_q_sorted_entry const* drop = out_q_sorted_get_head (&q->tsorted);
-      bl_assert (drop);
-      copy_to_output_data (&d, drop);
+  case 2:{ /*edge case: full of non expired entries*/
+    ssc_output_data next;
+    if (q->lane_blocked) {
+      break; /*backpressure: the producers wait until the head expires*/
+    }
+    if (!out_q_lane_consume (q, &next).own) {
+      ssc_output_data drop = q->heap[0].d;
+      out_q_heap_pop (q);
       ssc_out_memory_dealloc(
-        q->global->sim_dealloc, q->global->sim_context, &d
+        q->global->sim_dealloc, q->global->sim_context, &drop
         );
-      out_q_sorted_drop_head (&q->tsorted);
-      copy_to_sorted_data (&e, &d);
-      out_q_sorted_insert (&q->tsorted, &e);
+      out_q_heap_push (q, &next);
       goto try_again;
     }
     break;
@@ -189,9 +393,12 @@ try_again:
   d_capacity = 1; /*lowest latency to return something to the caller*/
 
   if (bl_timept32_deadline_expired (bl_deadline)) {
-     return bl_mkerr (bl_timeout);
+    if (ssc_pollfd_enabled (&q->global->read_poll)) {
+      out_q_poll_rearm (q);
+    }
+    return bl_mkerr (bl_timeout);
   }
-  bl_nonblock_backoff_run (&nb);
+  out_q_wait (q, bl_deadline);
   goto try_again; /* "while (1)" with no indentation */
 }
 /*----------------------------------------------------------------------------*/
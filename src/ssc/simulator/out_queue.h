@@ -4,37 +4,115 @@
 #include <bl/base/platform.h>
 #include <bl/base/integer.h>
 #include <bl/base/time.h>
-#include <bl/base/flat_deadlines.h>
+#include <bl/base/atomic.h>
+#include <bl/base/semaphore.h>
 
 #include <bl/nonblock/mpmc_bt.h>
 
 #include <ssc/types.h>
 #include <ssc/simulator/simulation.h>
+#include <ssc/simulator/out_arena.h>
 
 struct ssc_global;
+struct out_q_entry;
 /*----------------------------------------------------------------------------*/
-typedef struct out_q_sorted_value {
-  bl_memr16    data;
-  ssc_group_id gid;
-  ssc_out_type type;
-}
-out_q_sorted_value;
+typedef void (*ssc_out_q_lane_room_func) (void* context, ssc_group_id gid);
+/*----------------------------------------------------------------------------*/
+/* The output queue. Each fiber group has its own lane, a queue that only the
+   thread running the group produces to and only the "ssc_read" caller
+   consumes from, so the groups running on different threads don't contend.
+
+   The reader merges the lanes by timestamp through a min-heap. The entries
+   of a lane are mostly in time order, but not always: a fiber can run ahead
+   of time ("ssc_delay") and produce future timestamps before other fibers of
+   the same group produce the current one. The entries are released when
+   their timestamp expires.
+
+   Each group has its own output memory arena too, see "out_arena.h".
+
+   A reader without entries to release sleeps on a semaphore until the
+   timestamp of the heap head, the timeout or a new entry. It raises
+   "reader_waiting" before rechecking the lanes, the producers only signal
+   when they see it raised, so producing doesn't pay a syscall when nobody
+   is waiting.
+
+   On backpressure mode ("ssc_cfg.out_backpressure") no entry is dropped:
+   the heap doesn't make room by dropping its head and a producer that finds
+   its lane full raises the "lane_blocked" flag of the lane and waits. The
+   reader calls "lane_room" for a lane with the flag raised after taking an
+   entry from it. */
 /*----------------------------------------------------------------------------*/
 typedef struct ssc_out_q {
-  bl_mpmc_bt               queue;
-  bl_flat_deadlines        tsorted;
+  bl_mpmc_bt*              lanes; /*indexed by group id*/
+  ssc_out_arena*           arenas; /*indexed by group id*/
+  bl_uword                 lane_count;
+  bl_uword                 lane_next; /*round-robin start on transfers*/
+  struct out_q_entry*      heap;
+  bl_uword                 heap_size;
+  bl_uword                 heap_capacity;
+  bl_uword                 seq; /*ties between entries with the same time*/
+  bl_tm_sem                sem;
+  bl_atomic_uword          reader_waiting;
+  bl_atomic_uword*         lane_blocked; /*backpressure mode only*/
+  ssc_out_q_lane_room_func lane_room;
+  void*                    lane_room_context;
   struct ssc_global const* global;
 }
 ssc_out_q;
 /*----------------------------------------------------------------------------*/
 extern bl_err ssc_out_q_init(
-  ssc_out_q* q, bl_uword size, struct ssc_global const* global
+  ssc_out_q*               q,
+  bl_uword                 lane_size,
+  bl_uword                 lane_count,
+  bl_uword                 arena_size,
+  struct ssc_global const* global
   );
 /*----------------------------------------------------------------------------*/
 extern void ssc_out_q_destroy (ssc_out_q* q);
 /*----------------------------------------------------------------------------*/
+/* ssc_out_q_set_backpressure: enables backpressure mode. "lane_room" is
+   called from the "ssc_read" caller thread. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_out_q_set_backpressure(
+  ssc_out_q* q, ssc_out_q_lane_room_func lane_room, void* context
+  );
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_out_q_has_backpressure (ssc_out_q const* q)
+{
+  return q->lane_blocked != nullptr;
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_out_q_produce: goes to the lane of "d->gid". Only to be called from the
+   thread running that group. */
+/*----------------------------------------------------------------------------*/
 extern bl_err ssc_out_q_produce (ssc_out_q* q, ssc_output_data* d);
 /*----------------------------------------------------------------------------*/
+/* ssc_out_q_produce_or_block: backpressure mode only, to be called after
+   "ssc_out_q_produce" fails with "bl_would_overflow". Raises the flag of the
+   lane and retries. When the retry fails too the producer has to wait for the
+   "lane_room" call of its group before trying again. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_out_q_produce_or_block (ssc_out_q* q, ssc_output_data* d);
+/*----------------------------------------------------------------------------*/
+/* ssc_out_q_lane_is_blocked: a "lane_room" call for "gid" is pending */
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_out_q_lane_is_blocked (ssc_out_q* q, ssc_group_id gid)
+{
+  return bl_atomic_uword_load_rlx (&q->lane_blocked[gid]) != 0;
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_out_q_wake_reader: wakes up a sleeping reader, e.g. when the virtual
+   clock advances. Thread-safe. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_out_q_wake_reader (ssc_out_q* q);
+/*----------------------------------------------------------------------------*/
+/* ssc_out_q_arena: only to be used from the thread running the group "gid" */
+/*----------------------------------------------------------------------------*/
+static inline ssc_out_arena* ssc_out_q_arena (ssc_out_q* q, ssc_group_id gid)
+{
+  return &q->arenas[gid];
+}
+/*----------------------------------------------------------------------------*/
 extern bl_err ssc_out_q_consume(
   ssc_out_q*       q,
   bl_uword*        d_consumed,
@@ -0,0 +1,181 @@
+#include <string.h>
+
+#include <bl/base/atomic.h>
+
+#include <ssc/simulator/pattern_match.h>
+
+#ifdef SSC_PMATCH_X86
+  #include <immintrin.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* PORTABLE */
+/*----------------------------------------------------------------------------*/
+static bool pmatch_eq_portable (
+  bl_u8 const* in, bl_u8 const* match, bl_uword size
+  )
+{
+  return memcmp (in, match, size) == 0;
+}
+/*----------------------------------------------------------------------------*/
+static bool pmatch_masked_eq_portable(
+  bl_u8 const* in, bl_u8 const* match, bl_u8 const* mask, bl_uword size
+  )
+{
+  /*a plain loop, the compiler vectorizes it better than manual word packing.
+    Early exit, as mismatches are normally on the first bytes (addresses)*/
+  for (bl_uword i = 0; i < size; ++i) {
+    if ((in[i] & mask[i]) != match[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+ssc_pmatch_impl const ssc_pmatch_portable = {
+  pmatch_eq_portable, pmatch_masked_eq_portable, "portable"
+};
+/*----------------------------------------------------------------------------*/
+#ifdef SSC_PMATCH_X86
+/*----------------------------------------------------------------------------*/
+/* SSE2 */
+/*----------------------------------------------------------------------------*/
+__attribute__ ((target ("sse2")))
+static bool pmatch_eq_sse2 (bl_u8 const* in, bl_u8 const* match, bl_uword size)
+{
+  bl_uword i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i a = _mm_loadu_si128 ((__m128i const*) (in + i));
+    __m128i b = _mm_loadu_si128 ((__m128i const*) (match + i));
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) != 0xffff) {
+      return false;
+    }
+  }
+  return pmatch_eq_portable (in + i, match + i, size - i);
+}
+/*----------------------------------------------------------------------------*/
+__attribute__ ((target ("sse2")))
+static bool pmatch_masked_eq_sse2(
+  bl_u8 const* in, bl_u8 const* match, bl_u8 const* mask, bl_uword size
+  )
+{
+  bl_uword i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i a = _mm_loadu_si128 ((__m128i const*) (in + i));
+    __m128i m = _mm_loadu_si128 ((__m128i const*) (mask + i));
+    __m128i b = _mm_loadu_si128 ((__m128i const*) (match + i));
+    a         = _mm_and_si128 (a, m);
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b)) != 0xffff) {
+      return false;
+    }
+  }
+  return pmatch_masked_eq_portable (in + i, match + i, mask + i, size - i);
+}
+/*----------------------------------------------------------------------------*/
+ssc_pmatch_impl const ssc_pmatch_sse2 = {
+  pmatch_eq_sse2, pmatch_masked_eq_sse2, "sse2"
+};
+/*----------------------------------------------------------------------------*/
+/* AVX2 */
+/*----------------------------------------------------------------------------*/
+__attribute__ ((target ("avx2")))
+static bool pmatch_eq_avx2 (bl_u8 const* in, bl_u8 const* match, bl_uword size)
+{
+  bl_uword i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i a = _mm256_loadu_si256 ((__m256i const*) (in + i));
+    __m256i b = _mm256_loadu_si256 ((__m256i const*) (match + i));
+    if ((bl_u32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (a, b)) != 0xffffffff) {
+      return false;
+    }
+  }
+  return pmatch_eq_sse2 (in + i, match + i, size - i);
+}
+/*----------------------------------------------------------------------------*/
+__attribute__ ((target ("avx2")))
+static bool pmatch_masked_eq_avx2(
+  bl_u8 const* in, bl_u8 const* match, bl_u8 const* mask, bl_uword size
+  )
+{
+  bl_uword i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i a = _mm256_loadu_si256 ((__m256i const*) (in + i));
+    __m256i m = _mm256_loadu_si256 ((__m256i const*) (mask + i));
+    __m256i b = _mm256_loadu_si256 ((__m256i const*) (match + i));
+    a         = _mm256_and_si256 (a, m);
+    if ((bl_u32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (a, b)) != 0xffffffff) {
+      return false;
+    }
+  }
+  return pmatch_masked_eq_sse2 (in + i, match + i, mask + i, size - i);
+}
+/*----------------------------------------------------------------------------*/
+ssc_pmatch_impl const ssc_pmatch_avx2 = {
+  pmatch_eq_avx2, pmatch_masked_eq_avx2, "avx2"
+};
+/*----------------------------------------------------------------------------*/
+#endif /* SSC_PMATCH_X86 */
+/*----------------------------------------------------------------------------*/
+/* DISPATCH */
+/*----------------------------------------------------------------------------*/
+ssc_pmatch_impl ssc_pmatch = {
+  pmatch_eq_portable, pmatch_masked_eq_portable, "portable"
+};
+/*----------------------------------------------------------------------------*/
+enum pmatch_init_states {
+  pmatch_init_pending,
+  pmatch_init_running,
+  pmatch_init_done,
+};
+static bl_atomic_uword pmatch_init_state;
+/*----------------------------------------------------------------------------*/
+bool ssc_pmatch_is_supported (ssc_pmatch_impl const* impl)
+{
+#ifdef SSC_PMATCH_X86
+  __builtin_cpu_init();
+  if (impl == &ssc_pmatch_avx2) {
+    return __builtin_cpu_supports ("avx2");
+  }
+  if (impl == &ssc_pmatch_sse2) {
+    return __builtin_cpu_supports ("sse2");
+  }
+#endif
+  return impl == &ssc_pmatch_portable;
+}
+/*----------------------------------------------------------------------------*/
+static ssc_pmatch_impl const* pmatch_select (void)
+{
+#ifdef SSC_PMATCH_X86
+  if (ssc_pmatch_is_supported (&ssc_pmatch_avx2)) {
+    return &ssc_pmatch_avx2;
+  }
+  if (ssc_pmatch_is_supported (&ssc_pmatch_sse2)) {
+    return &ssc_pmatch_sse2;
+  }
+#endif
+  return &ssc_pmatch_portable;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pmatch_init (void)
+{
+  /*written once: the workers of an already running simulator read it while
+    another one is being created*/
+  bl_uword expected = pmatch_init_pending;
+  if (bl_atomic_uword_strong_cas(
+    &pmatch_init_state,
+    &expected,
+    pmatch_init_running,
+    bl_mo_acquire,
+    bl_mo_acquire
+    )) {
+    ssc_pmatch = *pmatch_select();
+    bl_atomic_uword_store (&pmatch_init_state, pmatch_init_done, bl_mo_release);
+    return;
+  }
+  while (bl_atomic_uword_load (&pmatch_init_state, bl_mo_acquire) !=
+    pmatch_init_done
+    ) {
+    continue;
+  }
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,66 @@
+#ifndef __SSC_PATTERN_MATCH_H__
+#define __SSC_PATTERN_MATCH_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+
+/*----------------------------------------------------------------------------*/
+/* Byte comparison kernels for the input pattern matching. The fastest
+   implementation available on the running CPU is selected by
+   "ssc_pmatch_init". */
+/*----------------------------------------------------------------------------*/
+#if (defined (__x86_64__) || defined (__i386__)) && defined (__GNUC__)
+  #define SSC_PMATCH_X86 1
+#endif
+/*----------------------------------------------------------------------------*/
+/* eq: true if "size" bytes of "in" and "match" are equal */
+typedef bool (*ssc_pmatch_eq_func)(
+  bl_u8 const* in, bl_u8 const* match, bl_uword size
+  );
+/* masked_eq: true if "(in[i] & mask[i]) == match[i]" for "size" bytes */
+typedef bool (*ssc_pmatch_masked_eq_func)(
+  bl_u8 const* in, bl_u8 const* match, bl_u8 const* mask, bl_uword size
+  );
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_pmatch_impl {
+  ssc_pmatch_eq_func        eq;
+  ssc_pmatch_masked_eq_func masked_eq;
+  char const*               name;
+}
+ssc_pmatch_impl;
+/*----------------------------------------------------------------------------*/
+extern ssc_pmatch_impl const ssc_pmatch_portable;
+#ifdef SSC_PMATCH_X86
+extern ssc_pmatch_impl const ssc_pmatch_sse2;
+extern ssc_pmatch_impl const ssc_pmatch_avx2;
+#endif
+/*----------------------------------------------------------------------------*/
+/* the selected implementation, don't use before calling "ssc_pmatch_init" */
+extern ssc_pmatch_impl ssc_pmatch;
+/*----------------------------------------------------------------------------*/
+/* ssc_pmatch_init: selects the implementation using CPU feature detection.
+   Only the first call writes "ssc_pmatch", concurrent callers return after
+   it is done. To be called before starting any thread using the kernels. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pmatch_init (void);
+/*----------------------------------------------------------------------------*/
+/* ssc_pmatch_is_supported: true if "impl" can run on this CPU */
+/*----------------------------------------------------------------------------*/
+extern bool ssc_pmatch_is_supported (ssc_pmatch_impl const* impl);
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_pmatch_eq(
+  bl_u8 const* in, bl_u8 const* match, bl_uword size
+  )
+{
+  return ssc_pmatch.eq (in, match, size);
+}
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_pmatch_masked_eq(
+  bl_u8 const* in, bl_u8 const* match, bl_u8 const* mask, bl_uword size
+  )
+{
+  return ssc_pmatch.masked_eq (in, match, mask, size);
+}
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_PATTERN_MATCH_H__ */
@@ -0,0 +1,111 @@
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/pollfd.h>
+
+#ifdef SSC_POLLFD
+  #include <string.h>
+  #include <unistd.h>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/timerfd.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_reset (ssc_pollfd* p)
+{
+  bl_assert (p);
+  p->fd    = -1;
+  p->event = -1;
+  p->timer = -1;
+}
+/*----------------------------------------------------------------------------*/
+#ifdef SSC_POLLFD
+/*----------------------------------------------------------------------------*/
+static bool pollfd_add (int epfd, int fd)
+{
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof ev);
+  ev.events  = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl (epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_pollfd_init (ssc_pollfd* p)
+{
+  bl_assert (p);
+  p->fd    = epoll_create1 (EPOLL_CLOEXEC);
+  p->event = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  p->timer = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (p->fd < 0 || p->event < 0 || p->timer < 0 ||
+    !pollfd_add (p->fd, p->event) ||
+    !pollfd_add (p->fd, p->timer)
+    ) {
+    ssc_pollfd_destroy (p);
+    return bl_mkerr (bl_error);
+  }
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_destroy (ssc_pollfd* p)
+{
+  bl_assert (p);
+  int* fds[] = { &p->fd, &p->event, &p->timer };
+  for (bl_uword i = 0; i < bl_arr_elems (fds); ++i) {
+    if (*fds[i] >= 0) {
+      close (*fds[i]);
+    }
+  }
+  ssc_pollfd_reset (p);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_signal (ssc_pollfd const* p)
+{
+  bl_assert (ssc_pollfd_enabled (p));
+  bl_u64  v = 1;
+  /*it can only fail with the counter saturated, so it is readable anyways*/
+  ssize_t r = write (p->event, &v, sizeof v);
+  (void) r;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_clear (ssc_pollfd const* p)
+{
+  bl_assert (ssc_pollfd_enabled (p));
+  bl_u64  v;
+  ssize_t r = read (p->event, &v, sizeof v); /*resets the counter*/
+  (void) r;
+  /*rearming resets the expiration count*/
+  struct itimerspec t;
+  memset (&t, 0, sizeof t);
+  (void) timerfd_settime (p->timer, 0, &t, nullptr);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_set_timer (ssc_pollfd const* p, bl_u32 usec)
+{
+  bl_assert (ssc_pollfd_enabled (p));
+  struct itimerspec t;
+  memset (&t, 0, sizeof t);
+  /*a zero "it_value" disarms the timer*/
+  usec               = usec ? usec : 1;
+  t.it_value.tv_sec  = usec / 1000000;
+  t.it_value.tv_nsec = (usec % 1000000) * 1000;
+  (void) timerfd_settime (p->timer, 0, &t, nullptr);
+}
+/*----------------------------------------------------------------------------*/
+#else /* SSC_POLLFD */
+/*----------------------------------------------------------------------------*/
+bl_err ssc_pollfd_init (ssc_pollfd* p)
+{
+  ssc_pollfd_reset (p);
+  return bl_mkerr (bl_invalid);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_destroy (ssc_pollfd* p) {}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_signal (ssc_pollfd const* p) {}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_clear (ssc_pollfd const* p) {}
+/*----------------------------------------------------------------------------*/
+void ssc_pollfd_set_timer (ssc_pollfd const* p, bl_u32 usec) {}
+/*----------------------------------------------------------------------------*/
+#endif /* SSC_POLLFD */
@@ -0,0 +1,59 @@
+#ifndef __SSC_POLLFD_H__
+#define __SSC_POLLFD_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+#include <bl/base/error.h>
+
+/*----------------------------------------------------------------------------*/
+/* A file descriptor that an external event loop can poll for readability,
+   for "ssc_get_pollfds". It is an epoll instance grouping an eventfd, that
+   any thread can signal, and a timerfd, for deadlines.
+
+   It is level-triggered: it stays readable until "ssc_pollfd_clear". The
+   owner clears it when it runs out of work and then rechecks, so a signal
+   racing with the clear isn't lost. Only available on Linux, "fd" is -1 when
+   disabled. */
+/*----------------------------------------------------------------------------*/
+#if defined (__linux__)
+  #define SSC_POLLFD 1
+#endif
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_pollfd {
+  int fd; /*epoll*/
+  int event;
+  int timer;
+}
+ssc_pollfd;
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_reset: leaves it disabled, to be called before "init" */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pollfd_reset (ssc_pollfd* p);
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_init: returns "bl_invalid" on unsupported platforms */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_pollfd_init (ssc_pollfd* p);
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_destroy: no-op when disabled */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pollfd_destroy (ssc_pollfd* p);
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_pollfd_enabled (ssc_pollfd const* p)
+{
+  return p->fd >= 0;
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_signal: makes it readable. Thread-safe. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pollfd_signal (ssc_pollfd const* p);
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_clear: makes it non readable and stops the timer */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pollfd_clear (ssc_pollfd const* p);
+/*----------------------------------------------------------------------------*/
+/* ssc_pollfd_set_timer: makes it readable after "usec" microseconds */
+/*----------------------------------------------------------------------------*/
+extern void ssc_pollfd_set_timer (ssc_pollfd const* p, bl_u32 usec);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_POLLFD_H__ */
@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <string.h>
+
 #include <coro.h>
 
 #include <bl/base/default_allocator.h>
@@ -5,6 +8,7 @@
 #include <bl/base/atomic.h>
 #include <bl/base/integer.h>
 #include <bl/base/time.h>
+#include <bl/base/deadline.h>
 #include <bl/base/dynarray.h>
 
 #include <bl/task_queue/task_queue.h>
@@ -18,6 +22,8 @@
 #include <ssc/simulator/in_bstream.h>
 #include <ssc/simulator/out_data_memory.h>
 #include <ssc/simulator/group_scheduler.h>
+#include <ssc/simulator/worker.h>
+#include <ssc/simulator/pattern_match.h>
 
 /*----------------------------------------------------------------------------*/
 bl_define_dynarray_types (gscheds, gsched)
@@ -39,8 +45,19 @@ struct ssc {
   ssc_simulation_var (lib);
   gscheds             groups;
   gsched_cfgs         fg_cfgs;
+  ssc_worker          main_worker; /*single threaded mode worker*/
+  ssc_worker*         workers; /*multithreaded mode workers*/
+  bl_uword            worker_count;
   bl_err              err;
   bl_atomic_uword     state;
+  char*               stack_profile; /*path, owned*/
+  bl_uword            stack_profile_margin;
+};
+/*----------------------------------------------------------------------------*/
+enum {
+  /*floor for the profiled stack sizes, to leave room for libcoro's entry
+    frame and signal handlers*/
+  ssc_stack_profile_min_size = 16 * 1024,
 };
 /*----------------------------------------------------------------------------*/
 bl_err ssc_api_add_fiber (ssc_handle h, ssc_fiber_cfg const* cfg)
@@ -88,11 +105,20 @@ bl_err ssc_api_add_fiber (ssc_handle h, ssc_fiber_cfg const* cfg)
   return sim->err;
 }
 /*----------------------------------------------------------------------------*/
+bl_err ssc_api_set_dealloc_batch (ssc_handle h, ssc_sim_dealloc_batch_func f)
+{
+  ssc* sim                      = (ssc*) h;
+  sim->global.sim_dealloc_batch = f;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 static void ssc_run_manual_link_to_simulator (ssc* d)
 {
 #ifdef SSC_SHAREDLIB
   ssc_simulator_ftable t;
   t.add_fiber                        = ssc_api_add_fiber;
+  t.set_dealloc_batch                = ssc_api_set_dealloc_batch;
+  t.spawn_fiber                      = ssc_api_spawn_fiber;
   t.yield                            = ssc_api_yield;
   t.wake                             = ssc_api_wake;
   t.wait                             = ssc_api_wait;
@@ -107,9 +133,12 @@ static void ssc_run_manual_link_to_simulator (ssc* d)
   t.produce_error                    = ssc_api_produce_error;
   t.produce_static_string            = ssc_api_produce_static_string;
   t.produce_dynamic_string           = ssc_api_produce_dynamic_string;
+  t.output_reserve                   = ssc_api_output_reserve;
+  t.output_commit                    = ssc_api_output_commit;
   t.peek_input_head_match_mask       = ssc_api_peek_input_head_match_mask;
   t.timed_peek_input_head_match_mask =
     ssc_api_timed_peek_input_head_match_mask;
+  t.set_callback_match               = ssc_api_set_callback_match;
   t.fiber_get_run_cfg                = ssc_api_fiber_get_run_cfg;
   t.fiber_set_run_cfg                = ssc_api_fiber_set_run_cfg;
   d->lib.manual_link (&t);
@@ -117,29 +146,143 @@ static void ssc_run_manual_link_to_simulator (ssc* d)
 }
 /*----------------------------------------------------------------------------*/
 static void ssc_estimate_taskq_size(
-  ssc* sim, bl_uword* regular, bl_uword* delayed
+  ssc*      sim,
+  bl_uword  worker,
+  bl_uword  worker_count,
+  bl_uword* regular,
+  bl_uword* delayed
   )
 {
-  bl_uword fiber_count   = 0;
-  ssc_fiber_cfgs *g = gsched_cfgs_beg (&sim->fg_cfgs);
-  while (g < gsched_cfgs_end (&sim->fg_cfgs)) {
-    fiber_count += ssc_fiber_cfgs_size (g);
-    ++g;
+  /*groups are assigned to workers in a round-robin fashion*/
+  bl_uword fiber_count = 0;
+  for (bl_uword i = worker; i < gsched_cfgs_size (&sim->fg_cfgs);
+    i += worker_count
+    ) {
+    fiber_count += ssc_fiber_cfgs_size (gsched_cfgs_at (&sim->fg_cfgs, i));
   }
-  *regular = fiber_count * 4;
-  *delayed = fiber_count;
+  fiber_count = bl_max (fiber_count, 1);
+  *regular    = fiber_count * 4;
+  *delayed    = fiber_count;
 }
 /*----------------------------------------------------------------------------*/
-static void ssc_destroy_fiber_groups (ssc* sim)
+/* STACK PROFILE */
+/*----------------------------------------------------------------------------*/
+/* The profile is a text file with a "group fiber peak_bytes" line per fiber.
+   The fibers are identified by position, so a profile is only meaningful for
+   the simulation (and fiber configuration) that generated it. */
+/*----------------------------------------------------------------------------*/
+static void ssc_stack_profile_apply (ssc* sim)
 {
-  gsched *g = gscheds_beg (&sim->groups);
-  while (g < gscheds_end (&sim->groups)) {
-    gsched_destroy (g, &sim->alloc);
-    ++g;
+  FILE* f = fopen (sim->stack_profile, "r");
+  if (!f) {
+    return; /*first run*/
+  }
+  unsigned long group, fiber, peak;
+  int scanned;
+  while ((scanned = fscanf (f, "%lu %lu %lu", &group, &fiber, &peak)) == 3) {
+    if (group >= gsched_cfgs_size (&sim->fg_cfgs)) {
+      continue;
+    }
+    ssc_fiber_cfgs* gcfg = gsched_cfgs_at (&sim->fg_cfgs, group);
+    if (fiber >= ssc_fiber_cfgs_size (gcfg) || peak == 0) {
+      continue;
+    }
+    bl_uword size = peak + ((peak * sim->stack_profile_margin) / 100);
+    ssc_fiber_cfgs_at (gcfg, fiber)->min_stack_size =
+      bl_max (size, (bl_uword) ssc_stack_profile_min_size);
+  }
+  log_warning_if(
+    scanned != EOF, "malformed stack profile: %s\n", sim->stack_profile
+    );
+  fclose (f);
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_stack_profile_save(
+  ssc* sim, ssc_fiber_stack_usage const* u, bl_uword count
+  )
+{
+  FILE* f = fopen (sim->stack_profile, "w");
+  if (!f) {
+    log_error ("unable to write stack profile: %s\n", sim->stack_profile);
+    return;
+  }
+  for (bl_uword i = 0; i < count; ++i) {
+    fprintf(
+      f,
+      "%lu %lu %lu\n",
+      (unsigned long) u[i].group,
+      (unsigned long) u[i].fiber,
+      (unsigned long) u[i].peak
+      );
+  }
+  fclose (f);
+}
+/*----------------------------------------------------------------------------*/
+/* allocates "*u" and writes the usage of every fiber on it. "*u" is to be
+   deallocated by the caller */
+static bl_err ssc_stack_usage_get_all(
+  ssc* sim, ssc_fiber_stack_usage** u, bl_uword* count
+  )
+{
+  bl_err err = ssc_get_stack_usage (sim, nullptr, 0, count);
+  if (err.own) {
+    return err;
+  }
+  *u = (ssc_fiber_stack_usage*) bl_alloc(
+    &sim->alloc, bl_max (*count, 1) * sizeof **u
+    );
+  if (!*u) {
+    return bl_mkerr (bl_alloc);
+  }
+  err = ssc_get_stack_usage (sim, *u, *count, count);
+  if (err.own) {
+    bl_dealloc (&sim->alloc, *u);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_stack_profile_write (ssc* sim)
+{
+  ssc_fiber_stack_usage* u;
+  bl_uword count;
+  bl_err err = ssc_stack_usage_get_all (sim, &u, &count);
+  if (err.own) {
+    log_error ("unable to measure the stack usage for the stack profile\n");
+    return;
+  }
+  ssc_stack_profile_save (sim, u, count);
+  bl_dealloc (&sim->alloc, u);
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_destroy_workers (ssc* sim)
+{
+  if (!sim->workers) {
+    return;
+  }
+  for (bl_uword i = 0; i < sim->worker_count; ++i) {
+    ssc_worker_stop (&sim->workers[i]);
+  }
+  for (bl_uword i = 0; i < sim->worker_count; ++i) {
+    ssc_worker_destroy (&sim->workers[i], &sim->alloc);
+  }
+  bl_dealloc (&sim->alloc, sim->workers);
+  sim->workers      = nullptr;
+  sim->worker_count = 0;
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_destroy_fiber_groups_n (ssc* sim, bl_uword initialized)
+{
+  for (bl_uword i = 0; i < initialized; ++i) {
+    gsched_destroy (gscheds_at (&sim->groups, i), &sim->alloc);
   }
   gscheds_destroy (&sim->groups, &sim->alloc);
 }
 /*----------------------------------------------------------------------------*/
+static void ssc_destroy_fiber_groups (ssc* sim)
+{
+  ssc_destroy_fiber_groups_n (sim, gscheds_size (&sim->groups));
+}
+/*----------------------------------------------------------------------------*/
 static void ssc_destroy_fiber_group_cfgs (ssc* sim)
 {
   ssc_fiber_cfgs *g = gsched_cfgs_beg (&sim->fg_cfgs);
@@ -150,15 +293,43 @@ static void ssc_destroy_fiber_group_cfgs (ssc* sim)
   gsched_cfgs_destroy (&sim->fg_cfgs, &sim->alloc);
 }
 /*----------------------------------------------------------------------------*/
+static void ssc_out_lane_room (void* context, ssc_group_id gid)
+{
+  /*the group moves its fibers waiting for output room to the run queue*/
+  ssc* sim = (ssc*) context;
+  gsched_program_schedule (gscheds_at (&sim->groups, gid));
+}
+/*----------------------------------------------------------------------------*/
 SSC_SIM_EXPORT bl_err ssc_create(
   ssc**     instance_out,
   char const* simlib_path,
   void*       simlib_passed_data
   )
 {
-  if (!instance_out) {
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  return ssc_create_with_cfg(
+    instance_out, simlib_path, simlib_passed_data, &cfg
+    );
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_create_with_cfg(
+  ssc**          instance_out,
+  char const*    simlib_path,
+  void*          simlib_passed_data,
+  ssc_cfg const* cfg
+  )
+{
+  if (!instance_out || !cfg ||
+    (cfg->time_mode != ssc_time_realtime && cfg->time_mode != ssc_time_virtual)
+    || cfg->inline_input_size > ssc_in_slot_max_inline
+    /*a fiber waiting for room has no deadline to advance the virtual clock
+      to, and the reader can't make room until the clock advances*/
+    || (cfg->out_backpressure && cfg->time_mode == ssc_time_virtual)
+    ) {
     return bl_mkerr (bl_invalid);
   }
+  ssc_pmatch_init(); /*input pattern matching CPU dispatch*/
   /*allocation*/
   bl_alloc_tbl def_alloc = bl_get_default_alloc();
   ssc* sim          = (ssc*) bl_alloc (&def_alloc, sizeof *sim);
@@ -169,13 +340,49 @@ SSC_SIM_EXPORT bl_err ssc_create(
   memset (sim, 0, sizeof *sim);
   sim->alloc        = def_alloc;
   sim->global.alloc = &sim->alloc;
+  ssc_pollfd_reset (&sim->global.run_poll);
+  ssc_pollfd_reset (&sim->global.read_poll);
+  ssc_bstream_pool_init (&sim->global.bstream_pool, &sim->alloc);
+  sim->global.in_slot_size = ssc_in_slot_size (cfg->inline_input_size);
+  /*the slot padding is usable when enabled, but 0 means no inline messages*/
+  sim->global.in_inline_max = cfg->inline_input_size ?
+    ssc_in_slot_inline_capacity (sim->global.in_slot_size) : 0;
+  sim->global.virtual_time = cfg->time_mode == ssc_time_virtual;
+  /*the virtual clock starts at the current time, so the timestamps look the
+    same on both modes*/
+  bl_atomic_uword_store_rlx (&sim->global.vnow, bl_timept32_get());
   bl_atomic_uword_store_rlx (&sim->state, ssc_on_setup);
+  sim->global.measure_stacks = cfg->measure_stacks || cfg->stack_profile;
+  sim->stack_profile_margin  = cfg->stack_profile_margin;
+  if (cfg->stack_profile) {
+    bl_uword len       = strlen (cfg->stack_profile) + 1;
+    sim->stack_profile = (char*) bl_alloc (&sim->alloc, len);
+    if (!sim->stack_profile) {
+      bl_dealloc (&sim->alloc, sim);
+      return bl_mkerr (bl_alloc);
+    }
+    memcpy (sim->stack_profile, cfg->stack_profile, len);
+  }
+  bl_err err = bl_mkok();
+  if (cfg->pollable_fds) {
+    err = ssc_pollfd_init (&sim->global.run_poll);
+    if (!err.own) {
+      err = ssc_pollfd_init (&sim->global.read_poll);
+    }
+    if (err.own) {
+      log_error ("error creating the pollable fds:%u\n", err);
+      goto mem_dealloc;
+    }
+    /*readable until the first calls find nothing to do*/
+    ssc_pollfd_signal (&sim->global.run_poll);
+    ssc_pollfd_signal (&sim->global.read_poll);
+  }
 
   gscheds_init (&sim->groups, 0, &sim->alloc); /*no allocation*/
   gsched_cfgs_init (&sim->fg_cfgs, 0, &sim->alloc); /*no allocation*/
 
   /*libload*/
-  bl_err err = ssc_simulation_load (&sim->lib, simlib_path);
+  err = ssc_simulation_load (&sim->lib, simlib_path);
   if (err.own) {
     /*error already logged*/
     goto mem_dealloc;
@@ -185,18 +392,6 @@ SSC_SIM_EXPORT bl_err ssc_create(
   sim->global.sim_before_fiber_context_switch =
     ssc_simulation_before_fiber_context_switch_func (&sim->lib);
 #endif
-  /*init out queue*/
-  ssc_cfg global_cfg;
-  ssc_cfg_init (&global_cfg); /*exposing cfg is TBD TODO*/
-  err = ssc_out_q_init(
-    &sim->global.out_queue,
-    global_cfg.min_out_queue_size,
-    &sim->global
-    );
-  if (err.own) {
-    log_error ("error initializing out queue:%u\n", err);
-    goto libunload;
-  }
   /*retrieve cfg from simulation (the simulation will call
     "ssc_api_setup_global" and "ssc_api_add_fiber") */
   ssc_run_manual_link_to_simulator (sim);
@@ -219,31 +414,66 @@ SSC_SIM_EXPORT bl_err ssc_create(
     goto simulator_teardown;
   }
 
+  if (sim->stack_profile) {
+    ssc_stack_profile_apply (sim);
+  }
+  /*init out queue: a lane per group*/
+  err = ssc_out_q_init(
+    &sim->global.out_queue,
+    cfg->min_out_queue_size,
+    group_count,
+    cfg->out_arena_size,
+    &sim->global
+    );
+  if (err.own) {
+    log_error ("error initializing out queue:%u\n", err);
+    goto simulator_teardown;
+  }
+  if (cfg->out_backpressure) {
+    err = ssc_out_q_set_backpressure(
+      &sim->global.out_queue, ssc_out_lane_room, sim
+      );
+    if (err.own) {
+      log_error ("error initializing out queue:%u\n", err);
+      goto destroy_out_queue;
+    }
+  }
   /*init task queue*/
   bl_uword regular, delayed;
-  ssc_estimate_taskq_size (sim, &regular, &delayed);
-  err =bl_taskq_init (&sim->global.tq, &sim->alloc, regular, delayed);
+  ssc_estimate_taskq_size (sim, 0, 1, &regular, &delayed);
+  err = ssc_worker_init (&sim->main_worker, 0, regular, delayed, &sim->alloc);
   if (err.own) {
     log_error ("error creating task queue:%u\n", err);
-    goto simulator_teardown;
+    goto destroy_out_queue;
   }
 
   /*init fiber groups*/
   ssc_fiber_group_cfg group_cfg;
   ssc_fiber_group_cfg_init (&group_cfg); /*exposing cfg is TBD TODO*/
-  for (bl_uword i = 0; i < group_count; ++i) {
-    err = gscheds_grow (&sim->groups, 1, &sim->alloc);
-    if (err.own) {
-      log_error ("error allocating fiber group:%u\n", err);
-      goto destroy_taskq;
-    }
-    gsched* g               = gscheds_last (&sim->groups);
-    ssc_fiber_cfgs* gf_cfgs = gsched_cfgs_at (&sim->fg_cfgs, i);
+  /*allocated at once: the groups contain self-referencing list heads, so
+    they can't be moved after initialization*/
+  err = gscheds_grow (&sim->groups, group_count, &sim->alloc);
+  if (err.own) {
+    log_error ("error allocating fiber groups:%u\n", err);
+    goto destroy_taskq;
+  }
+  bl_uword initialized;
+  for (initialized = 0; initialized < group_count; ++initialized) {
+    gsched* g               = gscheds_at (&sim->groups, initialized);
+    ssc_fiber_cfgs* gf_cfgs = gsched_cfgs_at (&sim->fg_cfgs, initialized);
     err = gsched_init(
-      g, i, &sim->global, &group_cfg, gf_cfgs, &sim->alloc
+      g,
+      initialized,
+      &sim->global,
+      &sim->main_worker,
+      &group_cfg,
+      gf_cfgs,
+      &sim->alloc
       );
     if (err.own) {
-      log_error ("error intializing fiber group %u: %u\n", i, err);
+      log_error(
+        "error intializing fiber group %u: %u\n", initialized, err
+        );
       goto destroy_fiber_groups;
     }
   }
@@ -253,20 +483,25 @@ SSC_SIM_EXPORT bl_err ssc_create(
   return bl_mkok();
 
 destroy_fiber_groups:
-  ssc_destroy_fiber_groups (sim);
+  ssc_destroy_fiber_groups_n (sim, initialized);
 destroy_taskq:
- bl_taskq_destroy (sim->global.tq, &sim->alloc);
+  ssc_worker_destroy (&sim->main_worker, &sim->alloc);
+destroy_out_queue:
+  ssc_out_q_destroy (&sim->global.out_queue);
 simulator_teardown:
   ssc_simulation_on_teardown (&sim->lib, sim->global.sim_context);
 destroy_cfgs:
   ssc_destroy_fiber_group_cfgs (sim);
-/*destroy_out_queue:*/
-  ssc_out_q_destroy (&sim->global.out_queue);
-libunload:
+/*libunload:*/
   ssc_simulation_unload (&sim->lib);
   gsched_cfgs_destroy (&sim->fg_cfgs, &sim->alloc);
   gscheds_destroy (&sim->groups, &sim->alloc);
 mem_dealloc:
+  ssc_pollfd_destroy (&sim->global.run_poll);
+  ssc_pollfd_destroy (&sim->global.read_poll);
+  if (sim->stack_profile) {
+    bl_dealloc (&sim->alloc, sim->stack_profile);
+  }
   bl_dealloc (&sim->alloc, sim);
   return err;
 }
@@ -283,13 +518,23 @@ SSC_SIM_EXPORT bl_err ssc_destroy (ssc* sim)
   if (state != ssc_stopped) {
     return bl_mkerr (bl_preconditions);
   }
+  if (sim->stack_profile) {
+    ssc_stack_profile_write (sim);
+  }
   ssc_destroy_fiber_groups (sim);
- bl_taskq_destroy (sim->global.tq, &sim->alloc);
+  ssc_destroy_workers (sim);
+  ssc_worker_destroy (&sim->main_worker, &sim->alloc);
+  ssc_bstream_pool_destroy (&sim->global.bstream_pool);
   ssc_out_q_destroy (&sim->global.out_queue);
+  ssc_pollfd_destroy (&sim->global.run_poll);
+  ssc_pollfd_destroy (&sim->global.read_poll);
   ssc_destroy_fiber_group_cfgs (sim);
   ssc_simulation_unload (&sim->lib);
   gsched_cfgs_destroy (&sim->fg_cfgs, &sim->alloc);
   gscheds_destroy (&sim->groups, &sim->alloc);
+  if (sim->stack_profile) {
+    bl_dealloc (&sim->alloc, sim->stack_profile);
+  }
   bl_dealloc (&sim->alloc, sim);
   return bl_mkok();
 }
@@ -328,6 +573,10 @@ SSC_SIM_EXPORT bl_err ssc_run_teardown (ssc* sim)
   if (bl_atomic_uword_load_rlx (&sim->state) != ssc_running) {
     return bl_mkerr (bl_preconditions);
   }
+  /*the groups can't be running while being teared down*/
+  for (bl_uword i = 0; i < sim->worker_count; ++i) {
+    ssc_worker_stop (&sim->workers[i]);
+  }
   gsched *g = gscheds_beg (&sim->groups);
   while (g < gscheds_end (&sim->groups)) {
     gsched_run_teardown (g);
@@ -343,59 +592,496 @@ SSC_SIM_EXPORT void ssc_block (ssc* sim)
   gsched *g = gscheds_beg (&sim->groups);
   while (g < gscheds_end (&sim->groups)) {
     ssc_in_q_block (&g->queue);
+    ssc_in_q_wake_writers (&g->queue); /*they see "bl_locked" now*/
     ++g;
   }
- bl_taskq_block (sim->global.tq);
+  for (bl_uword i = 0; i < sim->worker_count; ++i) {
+    bl_taskq_block (sim->workers[i].tq);
+  }
+  bl_taskq_block (sim->main_worker.tq);
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_run_threads (ssc* sim, bl_uword thread_count)
+{
+  if (thread_count == 0 || sim->global.virtual_time) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (bl_atomic_uword_load (&sim->state, bl_mo_acquire) != ssc_initialized) {
+    return bl_mkerr (bl_preconditions);
+  }
+  bl_uword group_count = gscheds_size (&sim->groups);
+  thread_count         = bl_min (thread_count, group_count);
+  sim->workers         = (ssc_worker*) bl_alloc(
+    &sim->alloc, thread_count * sizeof *sim->workers
+    );
+  if (!sim->workers) {
+    return bl_mkerr (bl_alloc);
+  }
+  bl_err err = bl_mkok();
+  for (bl_uword i = 0; i < thread_count; ++i) {
+    bl_uword regular, delayed;
+    ssc_estimate_taskq_size (sim, i, thread_count, &regular, &delayed);
+    err = ssc_worker_init(
+      &sim->workers[i], i, regular, delayed, &sim->alloc
+      );
+    if (err.own) {
+      log_error ("error creating worker %u: %u\n", i, err);
+      goto destroy_workers;
+    }
+    ++sim->worker_count;
+    err = ssc_worker_enable_stealing(
+      &sim->workers[i], sim->workers, thread_count, group_count, &sim->alloc
+      );
+    if (err.own) {
+      log_error ("error creating worker %u ready queue: %u\n", i, err);
+      goto destroy_workers;
+    }
+  }
+  /*each group has a home worker that owns its timers and receives it when
+    it becomes ready, idle workers steal from the rest*/
+  for (bl_uword i = 0; i < group_count; ++i) {
+    gsched_set_worker(
+      gscheds_at (&sim->groups, i), &sim->workers[i % thread_count]
+      );
+  }
+  err = ssc_run_setup (sim);
+  if (err.own) {
+    goto reassign_groups;
+  }
+  /*the setup tasks are already posted, they will run as soon as each
+    thread starts*/
+  for (bl_uword i = 0; i < thread_count; ++i) {
+    err = ssc_worker_start (&sim->workers[i]);
+    if (err.own) {
+      /*already set up, "ssc_run_teardown" takes care of stopping the threads
+        that were started*/
+      return err;
+    }
+  }
+  return err;
+
+reassign_groups:
+  for (bl_uword i = 0; i < group_count; ++i) {
+    gsched_set_worker (gscheds_at (&sim->groups, i), &sim->main_worker);
+  }
+destroy_workers:
+  ssc_destroy_workers (sim);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_get_worker_stats(
+  ssc* sim, bl_uword worker, ssc_worker_stats* stats
+  )
+{
+  if (!stats || worker >= sim->worker_count) {
+    return bl_mkerr (bl_invalid);
+  }
+  ssc_worker_get_stats (&sim->workers[worker], stats);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_get_bstream_pool_stats(
+  ssc* sim, ssc_bstream_pool_stats* stats
+  )
+{
+  if (!stats) {
+    return bl_mkerr (bl_invalid);
+  }
+  ssc_bstream_pool_get_stats (&sim->global.bstream_pool, stats);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_get_pollfds (ssc* sim, int* run_fd, int* read_fd)
+{
+  if (!sim || !run_fd || !read_fd ||
+    !ssc_pollfd_enabled (&sim->global.run_poll)
+    ) {
+    return bl_mkerr (bl_invalid);
+  }
+  *run_fd  = sim->global.run_poll.fd;
+  *read_fd = sim->global.read_poll.fd;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_get_stack_usage(
+  ssc*                   sim,
+  ssc_fiber_stack_usage* usage,
+  bl_uword               capacity,
+  bl_uword*              count
+  )
+{
+  if (!sim || !count || (!usage && capacity)) {
+    return bl_mkerr (bl_invalid);
+  }
+  bl_uword state = bl_atomic_uword_load (&sim->state, bl_mo_acquire);
+  if (!sim->global.measure_stacks ||
+    (sim->worker_count && state == ssc_running)
+    ) {
+    return bl_mkerr (bl_preconditions);
+  }
+  bl_uword total = 0;
+  for (bl_uword i = 0; i < gscheds_size (&sim->groups); ++i) {
+    bl_uword avail = capacity > total ? capacity - total : 0;
+    total += gsched_get_stack_usage(
+      gscheds_at (&sim->groups, i), avail ? usage + total : nullptr, avail
+      );
+  }
+  *count = total;
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_get_stack_usage_stats(
+  ssc* sim, ssc_stack_usage_stats* stats
+  )
+{
+  if (!sim || !stats) {
+    return bl_mkerr (bl_invalid);
+  }
+  ssc_fiber_stack_usage* u;
+  bl_uword count;
+  bl_err err = ssc_stack_usage_get_all (sim, &u, &count);
+  if (err.own) {
+    return err;
+  }
+  memset (stats, 0, sizeof *stats);
+  stats->fibers = count;
+  for (bl_uword i = 0; i < count; ++i) {
+    stats->size      += u[i].size;
+    stats->peak      += u[i].peak;
+    stats->max_peak   = bl_max (stats->max_peak, u[i].peak);
+    stats->overflows += (bl_uword) (u[i].size != 0 && u[i].peak >= u[i].size);
+  }
+  bl_dealloc (&sim->alloc, u);
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
+/* advances the virtual clock to the nearest group deadline and fires the
+   timers of the groups whose deadline is reached. Returns false if no group
+   has a deadline. */
+/*----------------------------------------------------------------------------*/
+static bool ssc_advance_virtual_time (ssc* sim)
+{
+  bl_timept32 next = 0;
+  bl_timept32 t;
+  bool        found = false;
+  gsched*     g;
+
+  for (g = gscheds_beg (&sim->groups); g < gscheds_end (&sim->groups); ++g) {
+    if (gsched_get_deadline (g, &t)) {
+      next  = (!found || bl_timept32_get_diff (t, next) < 0) ? t : next;
+      found = true;
+    }
+  }
+  if (!found) {
+    return false;
+  }
+  bl_timept32 now = ssc_global_now (&sim->global);
+  if (bl_timept32_get_diff (next, now) > 0) {
+    /*only this thread writes the clock*/
+    bl_atomic_uword_store_rlx (&sim->global.vnow, next);
+    now = next;
+    /*delayed output may be released now*/
+    ssc_out_q_wake_reader (&sim->global.out_queue);
+  }
+  for (g = gscheds_beg (&sim->groups); g < gscheds_end (&sim->groups); ++g) {
+    if (gsched_get_deadline (g, &t) && bl_timept32_get_diff (t, now) <= 0) {
+      bl_assert_side_effect (gsched_fire_virtual_timer (g).own == bl_ok);
+    }
+  }
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bl_err ssc_run_some_virtual (ssc* sim, bl_u32 usec_timeout, bool block)
+{
+  bl_err err = bl_taskq_try_run_one (sim->main_worker.tq);
+  if (err.own != bl_nothing_to_do) {
+    return err;
+  }
+  if (ssc_advance_virtual_time (sim)) {
+    return bl_taskq_try_run_one (sim->main_worker.tq);
+  }
+  /*no deadlines, only new input can make progress*/
+  return block ? bl_taskq_run_one (sim->main_worker.tq, usec_timeout) : err;
 }
 /*----------------------------------------------------------------------------*/
 SSC_SIM_EXPORT bl_err ssc_run_some (ssc* sim, bl_u32 usec_timeout)
 {
   bl_assert (bl_atomic_uword_load_rlx (&sim->state) == ssc_running);
-  return bl_taskq_run_one (sim->global.tq, usec_timeout);
+  bl_assert (sim->worker_count == 0 && "running on worker threads");
+  if (sim->global.virtual_time) {
+    return ssc_run_some_virtual (sim, usec_timeout, true);
+  }
+  return bl_taskq_run_one (sim->main_worker.tq, usec_timeout);
+}
+/*----------------------------------------------------------------------------*/
+/* clears "run_poll" when running out of work and programs its timer to the
+   nearest group deadline */
+/*----------------------------------------------------------------------------*/
+static bl_err ssc_run_poll_rearm (ssc* sim)
+{
+  ssc_pollfd_clear (&sim->global.run_poll);
+  /*rechecking after raising the flag, see "ssc_global_wake_runner"*/
+  bl_atomic_uword_store (&sim->global.run_waiting, 1, bl_mo_seq_cst);
+  bl_err err = bl_taskq_try_run_one (sim->main_worker.tq);
+  if (err.own != bl_nothing_to_do || sim->global.virtual_time) {
+    /*on virtual time there are no deadlines when there is nothing to do*/
+    return err;
+  }
+  bl_timept32 next = 0;
+  bl_timept32 t;
+  bool        found = false;
+  gsched*     g;
+
+  for (g = gscheds_beg (&sim->groups); g < gscheds_end (&sim->groups); ++g) {
+    if (gsched_get_deadline (g, &t)) {
+      next  = (!found || bl_timept32_get_diff (t, next) < 0) ? t : next;
+      found = true;
+    }
+  }
+  if (found) {
+    bl_timept32diff diff = bl_timept32_get_diff (next, bl_timept32_get());
+    ssc_pollfd_set_timer(
+      &sim->global.run_poll,
+      diff > 0 ? bl_timept32_to_usec ((bl_timept32) diff) + 1 : 0
+      );
+  }
+  return err;
 }
 /*----------------------------------------------------------------------------*/
 SSC_SIM_EXPORT bl_err ssc_try_run_some (ssc* sim)
 {
   bl_assert (bl_atomic_uword_load_rlx (&sim->state) == ssc_running);
-  return bl_taskq_try_run_one (sim->global.tq);
+  bl_assert (sim->worker_count == 0 && "running on worker threads");
+  bl_err err = sim->global.virtual_time
+    ? ssc_run_some_virtual (sim, 0, false)
+    : bl_taskq_try_run_one (sim->main_worker.tq);
+  if (err.own == bl_nothing_to_do &&
+    ssc_pollfd_enabled (&sim->global.run_poll)
+    ) {
+    err = ssc_run_poll_rearm (sim);
+  }
+  return err;
 }
 /*----------------------------------------------------------------------------*/
 SSC_SIM_EXPORT bl_u8* ssc_alloc_write_bytestream (ssc* sim, bl_uword capacity)
 {
-  bl_u8* bstream = in_bstream_alloc (capacity, &sim->alloc);
+  bl_u8* bstream = in_bstream_alloc (capacity, &sim->global.bstream_pool);
   return bstream ? in_bstream_payload (bstream) : nullptr;
 }
 /*----------------------------------------------------------------------------*/
-SSC_SIM_EXPORT bl_err ssc_write(
+static bl_err ssc_write_produce(
+  ssc* sim, gsched* g, bl_u8* in_bstream, bl_u16 size
+  )
+{
+  *in_bstream_timept32 (in_bstream)     = ssc_global_now (&sim->global);
+  *in_bstream_payload_size (in_bstream) = size;
+
+  bool idle_signal;
+  bl_err err = ssc_in_q_produce (&g->queue, in_bstream, &idle_signal);
+  if (err.own) {
+    /*still owned by the caller, it may be sent again*/
+    in_bstream_pattern_set (in_bstream);
+    return err;
+  }
+  if (idle_signal) {
+    /*no error when failing to schedule, as it isn't possible to roll back the
+      insertion*/
+    gsched_program_schedule (g);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_try_write(
   ssc* sim, ssc_group_id q, bl_u8* bytestream, bl_u16 size
   )
 {
-  bl_err err     = bl_mkok();
   bl_u8* in_bstream = in_bstream_from_payload (bytestream);
   bl_assert (in_bstream_pattern_validate (in_bstream)); /*big bug on the user side*/
 
+  if (q >= gscheds_size (&sim->groups)) {
+    return bl_mkerr (bl_invalid);
+  }
+  return ssc_write_produce(
+    sim, gscheds_at (&sim->groups, q), in_bstream, size
+    );
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_write(
+  ssc* sim, ssc_group_id q, bl_u8* bytestream, bl_u16 size
+  )
+{
+  bl_err err = ssc_try_write (sim, q, bytestream, size);
+  if (err.own) {
+    /*the frame is deallocated in all error cases to prevent leaks*/
+    in_bstream_dealloc(
+      in_bstream_from_payload (bytestream), &sim->global.bstream_pool
+      );
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_write_timed(
+  ssc* sim, ssc_group_id q, bl_u8* bytestream, bl_u16 size, bl_u32 timeout_us
+  )
+{
+  bl_u8* in_bstream = in_bstream_from_payload (bytestream);
+  bl_assert (in_bstream_pattern_validate (in_bstream));
+
+  bl_err err;
   if (q >= gscheds_size (&sim->groups)) {
     err = bl_mkerr (bl_invalid);
     goto dealloc;
   }
-  *in_bstream_timept32 (in_bstream)       = bl_timept32_get();
-  *in_bstream_payload_size (in_bstream) = size;
-
+  gsched* g = gscheds_at (&sim->groups, q);
+  bl_timept32 deadline;
+  bl_timept32_deadline_init_usec (&deadline, timeout_us);
+  err = ssc_write_produce (sim, g, in_bstream, size);
+  while (err.own == bl_would_overflow) {
+    bl_timept32diff left = bl_timept32_get_diff (deadline, bl_timept32_get());
+    if (left <= 0) {
+      err = bl_mkerr (bl_timeout);
+      break;
+    }
+    ssc_in_q_writer_register (&g->queue);
+    err = ssc_write_produce (sim, g, in_bstream, size);
+    if (err.own == bl_would_overflow) {
+      ssc_in_q_writer_wait(
+        &g->queue, bl_timept32_to_usec ((bl_timept32) left) + 1
+        );
+      err = ssc_write_produce (sim, g, in_bstream, size);
+    }
+  }
+  if (!err.own) {
+    return err;
+  }
+dealloc:
+  in_bstream_dealloc (in_bstream, &sim->global.bstream_pool);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_write_inline(
+  ssc* sim, ssc_group_id q, void const* data, bl_u16 size
+  )
+{
+  bl_assert (data || size == 0);
+  if (q >= gscheds_size (&sim->groups)) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (size > sim->global.in_inline_max) {
+    bl_u8* bytestream = ssc_alloc_write_bytestream (sim, size);
+    if (!bytestream) {
+      return bl_mkerr (bl_alloc);
+    }
+    memcpy (bytestream, data, size);
+    return ssc_write (sim, q, bytestream, size);
+  }
+  gsched* g = gscheds_at (&sim->groups, q);
+  bool idle_signal;
+  bl_err err = ssc_in_q_produce_inline(
+    &g->queue, data, size, ssc_global_now (&sim->global), &idle_signal
+    );
+  if (!err.own && idle_signal) {
+    gsched_program_schedule (g);
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_write_batch(
+  ssc*          sim,
+  ssc_group_id  q,
+  bl_u8* const* bytestreams,
+  bl_u16 const* sizes,
+  bl_uword      count
+  )
+{
+  bl_assert (bytestreams && sizes);
+  bl_err err = bl_mkok();
+  if (count == 0) {
+    return err;
+  }
+  if (q >= gscheds_size (&sim->groups)) {
+    err = bl_mkerr (bl_invalid);
+    goto dealloc;
+  }
+  /*chained on a single queue slot, see "in_bstream_next"*/
+  bl_timept32 now   = ssc_global_now (&sim->global);
+  bl_u8*      chain = nullptr;
+  for (bl_uword i = count; i-- > 0; ) {
+    bl_u8* in_bstream = in_bstream_from_payload (bytestreams[i]);
+    bl_assert (in_bstream_pattern_validate (in_bstream));
+    *in_bstream_next (in_bstream)         = chain;
+    *in_bstream_timept32 (in_bstream)     = now;
+    *in_bstream_payload_size (in_bstream) = sizes[i];
+    chain = in_bstream;
+  }
   gsched* g = gscheds_at (&sim->groups, q);
   bool idle_signal;
-  err = ssc_in_q_produce (&g->queue, in_bstream, &idle_signal);
+  err = ssc_in_q_produce (&g->queue, chain, &idle_signal);
   if (err.own) {
     goto dealloc;
   }
   if (idle_signal) {
-    /*no error when failing to schedule, as it isn't possible to roll back the
-      insertion*/
     gsched_program_schedule (g);
   }
   return err;
 dealloc:
-  /*the frame is deallocated in all error cases to prevent leaks*/
-  in_bstream_dealloc (in_bstream, &sim->alloc);
+  for (bl_uword i = 0; i < count; ++i) {
+    in_bstream_dealloc(
+      in_bstream_from_payload (bytestreams[i]), &sim->global.bstream_pool
+      );
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_write_multicast(
+  ssc*                sim,
+  ssc_group_id const* gids,
+  bl_uword            gid_count,
+  bl_u8*              bytestream,
+  bl_u16              size,
+  bl_uword*           sent
+  )
+{
+  bl_assert (gids || gid_count == 0);
+  bl_u8* in_bstream = in_bstream_from_payload (bytestream);
+  bl_assert (in_bstream_pattern_validate (in_bstream));
+  bl_err   err       = bl_mkok();
+  bl_uword delivered = 0;
+  if (gid_count == 0) {
+    goto dealloc;
+  }
+  for (bl_uword i = 0; i < gid_count; ++i) {
+    if (gids[i] >= gscheds_size (&sim->groups)) {
+      err = bl_mkerr (bl_invalid);
+      goto dealloc;
+    }
+  }
+  *in_bstream_timept32 (in_bstream)     = ssc_global_now (&sim->global);
+  *in_bstream_payload_size (in_bstream) = size;
+  /*a reference per group, set before any group can see it. The references
+    of the groups that didn't receive it are dropped here*/
+  bl_atomic_uword_store_rlx (in_bstream_refs (in_bstream), gid_count);
+  for (; delivered < gid_count; ++delivered) {
+    gsched* g = gscheds_at (&sim->groups, gids[delivered]);
+    bool idle_signal;
+    err = ssc_in_q_produce (&g->queue, in_bstream, &idle_signal);
+    if (err.own) {
+      break;
+    }
+    if (idle_signal) {
+      gsched_program_schedule (g);
+    }
+  }
+  for (bl_uword i = delivered; i < gid_count; ++i) {
+    in_bstream_dealloc (in_bstream, &sim->global.bstream_pool);
+  }
+  goto done;
+dealloc:
+  in_bstream_dealloc (in_bstream, &sim->global.bstream_pool);
+done:
+  if (sent) {
+    *sent = delivered;
+  }
   return err;
 }
 /*----------------------------------------------------------------------------*/
@@ -422,4 +1108,25 @@ SSC_SIM_EXPORT bl_err ssc_dealloc_read_data(
   return bl_mkok();
 }
 /*----------------------------------------------------------------------------*/
+SSC_SIM_EXPORT bl_err ssc_dealloc_read_data_batch(
+  ssc* sim, ssc_output_data* read_data, bl_uword count
+  )
+{
+  if (!sim || (!read_data && count)) {
+    return bl_mkerr (bl_invalid);
+  }
+  if (!sim->global.sim_dealloc_batch) {
+    for (bl_uword i = 0; i < count; ++i) {
+      ssc_out_memory_dealloc(
+        sim->global.sim_dealloc, sim->global.sim_context, &read_data[i]
+        );
+    }
+    return bl_mkok();
+  }
+  ssc_out_memory_dealloc_batch(
+    sim->global.sim_dealloc_batch, sim->global.sim_context, read_data, count
+    );
+  return bl_mkok();
+}
+/*----------------------------------------------------------------------------*/
 
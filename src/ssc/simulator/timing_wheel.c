@@ -0,0 +1,264 @@
+#include <bl/base/assert.h>
+#include <bl/base/utility.h>
+
+#include <ssc/simulator/timing_wheel.h>
+
+/*----------------------------------------------------------------------------*/
+/* The slot selection and expiration bitmasks follow the "timeout.c" scheme of
+   William Ahern's hierarchical timing wheel. */
+/*----------------------------------------------------------------------------*/
+enum {
+  twheel_slot_mask = ssc_twheel_slots - 1,
+};
+/*----------------------------------------------------------------------------*/
+static inline bl_uword twheel_ctz (bl_u64 v)
+{
+  bl_assert (v != 0);
+#if defined (__GNUC__)
+  return (bl_uword) __builtin_ctzll (v);
+#else
+  bl_uword r = 0;
+  while ((v & 1) == 0) {
+    v >>= 1;
+    ++r;
+  }
+  return r;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword twheel_fls (bl_u64 v)
+{
+  /*1-based index of the highest bit set, 0 for 0*/
+#if defined (__GNUC__)
+  return v ? 64 - (bl_uword) __builtin_clzll (v) : 0;
+#else
+  bl_uword r = 0;
+  while (v) {
+    v >>= 1;
+    ++r;
+  }
+  return r;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u64 twheel_rotl (bl_u64 v, bl_uword n)
+{
+  n &= 63;
+  return n ? (v << n) | (v >> (64 - n)) : v;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_u64 twheel_rotr (bl_u64 v, bl_uword n)
+{
+  n &= 63;
+  return n ? (v >> n) | (v << (64 - n)) : v;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_uword twheel_level_shift (bl_uword level)
+{
+  return level * ssc_twheel_slot_bits;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_twheel_init (ssc_twheel* tw, bl_timept32 now)
+{
+  bl_assert (tw);
+  for (bl_uword l = 0; l < ssc_twheel_levels; ++l) {
+    for (bl_uword s = 0; s < ssc_twheel_slots; ++s) {
+      bl_tailq_init (&tw->slots[l][s]);
+    }
+    tw->pending[l] = 0;
+  }
+  bl_tailq_init (&tw->expired);
+  tw->now        = 0;
+  tw->now32      = now;
+  tw->next       = ~((bl_u64) 0);
+  tw->next_valid = true;
+}
+/*----------------------------------------------------------------------------*/
+static void twheel_schedule (ssc_twheel* tw, ssc_twheel_node* n)
+{
+  if (n->expires <= tw->now) {
+    n->list = &tw->expired;
+    bl_tailq_insert_tail (n->list, n, hook);
+    return;
+  }
+  bl_u64   rem   = n->expires - tw->now;
+  bl_uword level = (twheel_fls (rem) - 1) / ssc_twheel_slot_bits;
+  bl_assert (level < ssc_twheel_levels);
+  /*on the upper levels the slot where the current time is was already
+    processed, so the deadlines are placed one slot earlier*/
+  bl_uword slot = (bl_uword)
+    ((n->expires >> twheel_level_shift (level)) - (level != 0))
+    & twheel_slot_mask;
+  n->list = &tw->slots[level][slot];
+  bl_tailq_insert_tail (n->list, n, hook);
+  tw->pending[level] |= ((bl_u64) 1) << slot;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_twheel_insert (ssc_twheel* tw, ssc_twheel_node* n, bl_timept32 deadline)
+{
+  bl_assert (tw && n && !ssc_twheel_node_is_armed (n));
+  bl_timeoft32 diff = bl_timept32_get_diff (deadline, tw->now32);
+  n->time    = deadline;
+  n->expires = diff > 0 ? tw->now + (bl_u64) diff : tw->now;
+  twheel_schedule (tw, n);
+  if (tw->next_valid) {
+    tw->next = bl_min (tw->next, n->expires);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void twheel_unlink (ssc_twheel* tw, ssc_twheel_node* n)
+{
+  ssc_twheel_list* list = n->list;
+  bl_tailq_remove (list, n, hook);
+  n->list = nullptr;
+  /*other nodes may have the same deadline, but it isn't worth checking*/
+  tw->next_valid &= n->expires != tw->next;
+  if (list == &tw->expired || !bl_tailq_empty (list)) {
+    return;
+  }
+  bl_uword idx = (bl_uword) (list - &tw->slots[0][0]);
+  tw->pending[idx / ssc_twheel_slots] &=
+    ~(((bl_u64) 1) << (idx & twheel_slot_mask));
+}
+/*----------------------------------------------------------------------------*/
+void ssc_twheel_cancel (ssc_twheel* tw, ssc_twheel_node* n)
+{
+  bl_assert (tw && n);
+  if (ssc_twheel_node_is_armed (n)) {
+    twheel_unlink (tw, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+void ssc_twheel_advance (ssc_twheel* tw, bl_timept32 now)
+{
+  bl_assert (tw);
+  bl_timeoft32 diff = bl_timept32_get_diff (now, tw->now32);
+  if (diff <= 0) {
+    return;
+  }
+  bl_u64          curr    = tw->now + (bl_u64) diff;
+  bl_u64          elapsed = (bl_u64) diff;
+  ssc_twheel_list todo;
+  bl_tailq_init (&todo);
+
+  for (bl_uword l = 0; l < ssc_twheel_levels; ++l) {
+    bl_uword shift = twheel_level_shift (l);
+    bl_u64   expiring;
+    if ((elapsed >> shift) > twheel_slot_mask) {
+      expiring = ~((bl_u64) 0); /*a full turn of this level*/
+    }
+    else {
+      /*the slots between the previous and the current time, both included*/
+      bl_uword lelapsed = (bl_uword) ((elapsed >> shift) & twheel_slot_mask);
+      bl_uword oslot    = (bl_uword) ((tw->now >> shift) & twheel_slot_mask);
+      bl_uword nslot    = (bl_uword) ((curr >> shift) & twheel_slot_mask);
+      bl_u64   fill     = (((bl_u64) 1) << lelapsed) - 1;
+      expiring  = twheel_rotl (fill, oslot);
+      expiring |= twheel_rotr (twheel_rotl (fill, nslot), lelapsed);
+      expiring |= ((bl_u64) 1) << nslot;
+    }
+    while (expiring & tw->pending[l]) {
+      bl_uword         slot = twheel_ctz (expiring & tw->pending[l]);
+      ssc_twheel_list* list = &tw->slots[l][slot];
+      ssc_twheel_node* n;
+      while ((n = bl_tailq_first (list))) {
+        bl_tailq_remove (list, n, hook);
+        bl_tailq_insert_tail (&todo, n, hook);
+      }
+      tw->pending[l] &= ~(((bl_u64) 1) << slot);
+    }
+    if (!(expiring & 1)) {
+      break; /*this level didn't wrap, so the upper ones didn't move*/
+    }
+    /*the next level ticks at least once*/
+    elapsed = bl_max (elapsed, ((bl_u64) ssc_twheel_slots) << shift);
+  }
+  tw->now         = curr;
+  tw->now32       = now;
+  tw->next_valid &= tw->next > curr;
+  /*the expired nodes go to the expired list, the rest to a lower level*/
+  ssc_twheel_node* n;
+  while ((n = bl_tailq_first (&todo))) {
+    bl_tailq_remove (&todo, n, hook);
+    twheel_schedule (tw, n);
+  }
+}
+/*----------------------------------------------------------------------------*/
+ssc_twheel_node* ssc_twheel_pop_expired (ssc_twheel* tw)
+{
+  bl_assert (tw);
+  ssc_twheel_node* n = bl_tailq_first (&tw->expired);
+  if (n) {
+    twheel_unlink (tw, n);
+  }
+  return n;
+}
+/*----------------------------------------------------------------------------*/
+ssc_twheel_node* ssc_twheel_pop_any (ssc_twheel* tw)
+{
+  bl_assert (tw);
+  ssc_twheel_node* n = ssc_twheel_pop_expired (tw);
+  if (n) {
+    return n;
+  }
+  for (bl_uword l = 0; l < ssc_twheel_levels; ++l) {
+    if (tw->pending[l]) {
+      n = bl_tailq_first (&tw->slots[l][twheel_ctz (tw->pending[l])]);
+      twheel_unlink (tw, n);
+      return n;
+    }
+  }
+  return nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static bl_u64 twheel_find_next (ssc_twheel* tw)
+{
+  /*on each level the nodes are placed on consecutive slots starting at the
+    current one, so the earliest node of a level is on its first occupied
+    slot after the current one*/
+  bl_u64 min     = ~((bl_u64) 0);
+  bl_u64 relmask = 0;
+  for (bl_uword l = 0; l < ssc_twheel_levels; ++l) {
+    bl_uword shift = twheel_level_shift (l);
+    if (tw->pending[l]) {
+      bl_uword curr = (bl_uword) ((tw->now >> shift) & twheel_slot_mask);
+      bl_uword offs = twheel_ctz (twheel_rotr (tw->pending[l], curr));
+      /*the slot start is a lower bound: skip the scan if it can't win. The
+        upper levels are one slot further, see "twheel_schedule"*/
+      bl_u64 bound = (((bl_u64) (offs + (l != 0))) << shift) -
+        (relmask & tw->now);
+      if (tw->now + bound < min) {
+        ssc_twheel_list* list =
+          &tw->slots[l][(curr + offs) & twheel_slot_mask];
+        ssc_twheel_node* n;
+        bl_tailq_foreach (n, list, hook) {
+          min = bl_min (min, n->expires);
+          if (l == 0) {
+            break; /*the first level slots have a single deadline*/
+          }
+        }
+      }
+    }
+    relmask = (relmask << ssc_twheel_slot_bits) | twheel_slot_mask;
+  }
+  return min;
+}
+/*----------------------------------------------------------------------------*/
+bool ssc_twheel_next_deadline (ssc_twheel* tw, bl_timept32* deadline)
+{
+  bl_assert (tw && deadline);
+  if (!bl_tailq_empty (&tw->expired)) {
+    *deadline = tw->now32;
+    return true;
+  }
+  if (!tw->next_valid) {
+    tw->next       = twheel_find_next (tw);
+    tw->next_valid = true;
+  }
+  if (tw->next == ~((bl_u64) 0)) {
+    return false;
+  }
+  *deadline = tw->now32 + (bl_timept32) (tw->next - tw->now);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,101 @@
+#ifndef __SSC_TIMING_WHEEL_H__
+#define __SSC_TIMING_WHEEL_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/integer.h>
+#include <bl/base/time.h>
+#include <bl/base/bsd_queue.h>
+
+/*----------------------------------------------------------------------------*/
+/* A hierarchical timing wheel of intrusive nodes: O(1) insertion and O(1)
+   cancellation through the node, no capacity limit and no allocations.
+
+   Every level has 64 slots, each level slot spans the whole previous level.
+   The deadlines are kept as 64-bit monotonic values internally, so the
+   "bl_timept32" wraparound is handled as long as every deadline is less than
+   half the "bl_timept32" range away from the wheel time (as required by
+   "bl_timept32_get_diff" anyways).
+
+   Expired nodes are returned unordered. */
+/*----------------------------------------------------------------------------*/
+enum ssc_twheel_constants {
+  ssc_twheel_slot_bits = 6,
+  ssc_twheel_slots     = 1 << ssc_twheel_slot_bits,
+  /*enough to cover 32 bits*/
+  ssc_twheel_levels    = (32 + ssc_twheel_slot_bits - 1) / ssc_twheel_slot_bits,
+};
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_twheel_node ssc_twheel_node;
+/*----------------------------------------------------------------------------*/
+typedef bl_tailq_head (ssc_twheel_list, ssc_twheel_node) ssc_twheel_list;
+/*----------------------------------------------------------------------------*/
+struct ssc_twheel_node {
+  bl_tailq_entry (ssc_twheel_node) hook;
+  ssc_twheel_list*                 list; /*nullptr when not armed*/
+  bl_u64                           expires;
+  bl_timept32                      time;
+};
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_twheel {
+  ssc_twheel_list slots[ssc_twheel_levels][ssc_twheel_slots];
+  ssc_twheel_list expired;
+  bl_u64          pending[ssc_twheel_levels]; /*slot occupancy bitmaps*/
+  bl_u64          now;
+  bl_u64          next; /*cached earliest deadline, if "next_valid"*/
+  bl_timept32     now32;
+  bool            next_valid;
+}
+ssc_twheel;
+/*----------------------------------------------------------------------------*/
+extern void ssc_twheel_init (ssc_twheel* tw, bl_timept32 now);
+/*----------------------------------------------------------------------------*/
+static inline void ssc_twheel_node_init (ssc_twheel_node* n)
+{
+  n->list = nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_twheel_node_is_armed (ssc_twheel_node const* n)
+{
+  return n->list != nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static inline bl_timept32 ssc_twheel_node_time (ssc_twheel_node const* n)
+{
+  return n->time;
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_insert: arms a non armed node. Deadlines not after the wheel time
+   go straight to the expired list. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_twheel_insert(
+  ssc_twheel* tw, ssc_twheel_node* n, bl_timept32 deadline
+  );
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_cancel: disarms a node. Calling it on a non armed node is OK. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_twheel_cancel (ssc_twheel* tw, ssc_twheel_node* n);
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_advance: advances the wheel time and moves the nodes expiring
+   until "now" (included) to the expired list. Time going backwards is
+   ignored. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_twheel_advance (ssc_twheel* tw, bl_timept32 now);
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_pop_expired: returns and disarms an expired node or nullptr. */
+/*----------------------------------------------------------------------------*/
+extern ssc_twheel_node* ssc_twheel_pop_expired (ssc_twheel* tw);
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_pop_any: returns and disarms any armed node or nullptr. To empty
+   the wheel before destroying the nodes. */
+/*----------------------------------------------------------------------------*/
+extern ssc_twheel_node* ssc_twheel_pop_any (ssc_twheel* tw);
+/*----------------------------------------------------------------------------*/
+/* ssc_twheel_next_deadline: returns false if no node is armed. Otherwise it
+   sets "deadline" to the earliest deadline. The value is cached, it is only
+   recomputed after the node with the earliest deadline is removed, and then
+   just the first occupied slot of each level is scanned. */
+/*----------------------------------------------------------------------------*/
+extern bool ssc_twheel_next_deadline (ssc_twheel* tw, bl_timept32* deadline);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_TIMING_WHEEL_H__ */
@@ -0,0 +1,210 @@
+#include <string.h>
+
+#include <bl/base/assert.h>
+#include <bl/base/alignment.h>
+#include <bl/base/integer_math.h>
+
+#include <ssc/log.h>
+#include <ssc/simulator/worker.h>
+#include <ssc/simulator/group_scheduler.h>
+
+/*----------------------------------------------------------------------------*/
+enum {
+  /*the stop flag is polled at least with this period, "ssc_worker_stop" posts
+    a task to wake the worker up, so this is just a safety net for the case
+    where the task queue is blocked*/
+  worker_idle_timeout_us = 10000,
+  /*when stealing an idle worker can miss a steal opportunity if nobody wakes
+    it up, so it polls its siblings with this period*/
+  worker_steal_timeout_us = 500,
+  /*max task queue tasks (timers) run between ready group runs*/
+  worker_max_tasks_per_pass = 8,
+};
+/*----------------------------------------------------------------------------*/
+bl_err ssc_worker_init(
+  ssc_worker*         w,
+  bl_uword            id,
+  bl_uword            regular_tasks,
+  bl_uword            delayed_tasks,
+  bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (w && alloc);
+  memset (w, 0, sizeof *w);
+  w->id = id;
+  bl_atomic_uword_store_rlx (&w->stop, 0);
+  return bl_taskq_init (&w->tq, alloc, regular_tasks, delayed_tasks);
+}
+/*----------------------------------------------------------------------------*/
+void ssc_worker_destroy (ssc_worker* w, bl_alloc_tbl const* alloc)
+{
+  bl_assert (w && !w->has_thread);
+  if (w->pool) {
+    bl_mpmc_bt_destroy (&w->ready, alloc);
+    w->pool = nullptr;
+  }
+  if (w->tq) {
+    bl_taskq_destroy (w->tq, alloc);
+    w->tq = nullptr;
+  }
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_worker_enable_stealing(
+  ssc_worker*         w,
+  ssc_worker*         pool,
+  bl_uword            pool_size,
+  bl_uword            queue_size,
+  bl_alloc_tbl const* alloc
+  )
+{
+  bl_assert (w && pool && pool_size && w->id < pool_size && !w->pool);
+  bl_err err = bl_mpmc_bt_init(
+    &w->ready,
+    alloc,
+    bl_round_next_pow2_u (bl_max (queue_size, 2)),
+    sizeof (struct gsched*),
+    bl_alignof (struct gsched*)
+    );
+  if (err.own) {
+    return err;
+  }
+  w->pool      = pool;
+  w->pool_size = pool_size;
+  bl_atomic_uword_store_rlx (&w->sleeping, 0);
+  bl_atomic_uword_store_rlx (&w->counters.runs, 0);
+  bl_atomic_uword_store_rlx (&w->counters.steals, 0);
+  bl_atomic_uword_store_rlx (&w->counters.idle, 0);
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_worker_wakeup_task (bl_err error, bl_taskq_id id, void* context)
+{
+  (void) error;
+  (void) id;
+  (void) context;
+}
+/*----------------------------------------------------------------------------*/
+static inline void ssc_worker_wakeup (ssc_worker* w)
+{
+  bl_taskq_id id;
+  /*failing to post is OK, sleeps are bounded by "worker_steal_timeout_us"*/
+  (void) bl_taskq_post(
+    w->tq, &id, bl_taskq_task_rv (ssc_worker_wakeup_task, w)
+    );
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_worker_push_ready (ssc_worker* w, struct gsched* gs)
+{
+  bl_assert (ssc_worker_is_stealing (w));
+  bl_mpmc_b_op op;
+  bl_err err = bl_mpmc_bt_produce (&w->ready, &op, &gs);
+  if (bl_unlikely (err.own)) {
+    /*the queues are sized to contain every group*/
+    bl_assert (false && "ready queue overflow");
+    return err;
+  }
+  /*"sleeping" is set before the sleeping worker rechecks the queues, so with
+    sequential consistency either the worker sees this group or this thread
+    sees the worker sleeping. If the owner is busy a sleeping sibling is woken
+    to steal it.*/
+  for (bl_uword i = 0; i < w->pool_size; ++i) {
+    ssc_worker* v = &w->pool[(w->id + i) % w->pool_size];
+    if (bl_atomic_uword_load (&v->sleeping, bl_mo_seq_cst)) {
+      ssc_worker_wakeup (v);
+      break;
+    }
+  }
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+static struct gsched* ssc_worker_try_get_ready (ssc_worker* w)
+{
+  struct gsched* gs;
+  bl_mpmc_b_op   op;
+  if (bl_mpmc_bt_consume (&w->ready, &op, &gs).own == bl_ok) {
+    return gs;
+  }
+  for (bl_uword i = 1; i < w->pool_size; ++i) {
+    ssc_worker* victim = &w->pool[(w->id + i) % w->pool_size];
+    if (bl_mpmc_bt_consume (&victim->ready, &op, &gs).own == bl_ok) {
+      bl_atomic_uword_fetch_add_rlx (&w->counters.steals, 1);
+      return gs;
+    }
+  }
+  return nullptr;
+}
+/*----------------------------------------------------------------------------*/
+static void ssc_worker_stealing_loop (ssc_worker* w)
+{
+  while (!bl_atomic_uword_load (&w->stop, bl_mo_acquire)) {
+    /*the task queue only contains timers and wakeups*/
+    for (bl_uword i = 0; i < worker_max_tasks_per_pass; ++i) {
+      if (bl_taskq_try_run_one (w->tq).own != bl_ok) {
+        break;
+      }
+    }
+    struct gsched* gs = ssc_worker_try_get_ready (w);
+    if (!gs) {
+      bl_atomic_uword_store (&w->sleeping, 1, bl_mo_seq_cst);
+      gs = ssc_worker_try_get_ready (w);
+      if (!gs) {
+        bl_atomic_uword_fetch_add_rlx (&w->counters.idle, 1);
+        (void) bl_taskq_run_one (w->tq, worker_steal_timeout_us);
+      }
+      bl_atomic_uword_store (&w->sleeping, 0, bl_mo_relaxed);
+      if (!gs) {
+        continue;
+      }
+    }
+    bl_atomic_uword_fetch_add_rlx (&w->counters.runs, 1);
+    gsched_run_ready (gs, w);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static int ssc_worker_thread (void* context)
+{
+  ssc_worker* w = (ssc_worker*) context;
+  if (ssc_worker_is_stealing (w)) {
+    ssc_worker_stealing_loop (w);
+    return 0;
+  }
+  while (!bl_atomic_uword_load (&w->stop, bl_mo_acquire)) {
+    (void) bl_taskq_run_one (w->tq, worker_idle_timeout_us);
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+bl_err ssc_worker_start (ssc_worker* w)
+{
+  bl_assert (w && w->tq && !w->has_thread);
+  bl_atomic_uword_store_rlx (&w->stop, 0);
+  bl_err err = bl_thread_init (&w->thread, ssc_worker_thread, w);
+  if (err.own) {
+    log_error ("unable to start worker thread %u: %u\n", w->id, err);
+    return err;
+  }
+  w->has_thread = true;
+  return err;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_worker_stop (ssc_worker* w)
+{
+  bl_assert (w);
+  if (!w->has_thread) {
+    return;
+  }
+  bl_atomic_uword_store (&w->stop, 1, bl_mo_release);
+  /*failing to post (e.g. blocked queue) is OK, the thread polls the flag*/
+  ssc_worker_wakeup (w);
+  bl_thread_join (&w->thread);
+  w->has_thread = false;
+}
+/*----------------------------------------------------------------------------*/
+void ssc_worker_get_stats (ssc_worker* w, ssc_worker_stats* s)
+{
+  bl_assert (w && s);
+  s->runs   = bl_atomic_uword_load_rlx (&w->counters.runs);
+  s->steals = bl_atomic_uword_load_rlx (&w->counters.steals);
+  s->idle   = bl_atomic_uword_load_rlx (&w->counters.idle);
+}
+/*----------------------------------------------------------------------------*/
@@ -0,0 +1,93 @@
+#ifndef __SSC_WORKER_H__
+#define __SSC_WORKER_H__
+
+#include <bl/base/platform.h>
+#include <bl/base/error.h>
+#include <bl/base/integer.h>
+#include <bl/base/atomic.h>
+#include <bl/base/allocator.h>
+#include <bl/base/thread.h>
+#include <bl/nonblock/mpmc_bt.h>
+#include <bl/task_queue/task_queue.h>
+
+#include <ssc/types.h>
+#include <ssc/simulator/context_switch.h>
+
+/*----------------------------------------------------------------------------*/
+/* A worker is an execution context for fiber groups: the task queue that
+   drives them and the main coroutine context that the fibers switch back to.
+
+   In single threaded mode there is just one worker that is run from the
+   "ssc_run_some" caller. In multithreaded mode each worker owns a thread.
+
+   In multithreaded mode the groups are not run from the task queue. Each
+   worker has a queue of ready (runnable) groups and idle workers steal ready
+   groups from their siblings. The task queue is then only used for the group
+   timers and for waking up a sleeping worker. */
+/*----------------------------------------------------------------------------*/
+struct gsched;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_worker_counters {
+  bl_atomic_uword runs;
+  bl_atomic_uword steals;
+  bl_atomic_uword idle;
+}
+ssc_worker_counters;
+/*----------------------------------------------------------------------------*/
+typedef struct ssc_worker {
+  ssc_ctx             main_coro_ctx;
+  bl_taskq*           tq;
+  bl_mpmc_bt          ready; /*of "struct gsched*"*/
+  struct ssc_worker*  pool; /*all the workers, including this one*/
+  bl_uword            pool_size;
+  ssc_worker_counters counters;
+  bl_atomic_uword     sleeping;
+  bl_thread           thread;
+  bl_atomic_uword     stop;
+  bl_uword            id;
+  bool                has_thread;
+}
+ssc_worker;
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_worker_init(
+  ssc_worker*         w,
+  bl_uword            id,
+  bl_uword            regular_tasks,
+  bl_uword            delayed_tasks,
+  bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+extern void ssc_worker_destroy (ssc_worker* w, bl_alloc_tbl const* alloc);
+/*----------------------------------------------------------------------------*/
+/* ssc_worker_enable_stealing: makes the worker run ready groups from its own
+   ready queue and from the ones of the rest of workers in "pool".
+   "queue_size" has to be big enough to contain every group, as a group can be
+   only on one ready queue at a time the total group count is enough. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_worker_enable_stealing(
+  ssc_worker*         w,
+  ssc_worker*         pool,
+  bl_uword            pool_size,
+  bl_uword            queue_size,
+  bl_alloc_tbl const* alloc
+  );
+/*----------------------------------------------------------------------------*/
+static inline bool ssc_worker_is_stealing (ssc_worker const* w)
+{
+  return w->pool != nullptr;
+}
+/*----------------------------------------------------------------------------*/
+/* ssc_worker_push_ready: thread safe. */
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_worker_push_ready (ssc_worker* w, struct gsched* gs);
+/*----------------------------------------------------------------------------*/
+extern void ssc_worker_get_stats (ssc_worker* w, ssc_worker_stats* s);
+/*----------------------------------------------------------------------------*/
+extern bl_err ssc_worker_start (ssc_worker* w);
+/*----------------------------------------------------------------------------*/
+/* ssc_worker_stop: signals the worker thread to stop and joins it. */
+/*----------------------------------------------------------------------------*/
+extern void ssc_worker_stop (ssc_worker* w);
+/*----------------------------------------------------------------------------*/
+
+#endif /* __SSC_WORKER_H__ */
@@ -1,4 +1,7 @@
 #include <string.h>
+#ifdef __linux__
+  #include <poll.h>
+#endif
 
 #include <bl/base/utility.h>
 #include <bl/base/time.h>
@@ -28,7 +31,10 @@ typedef struct basic_tests_ctx {
   bl_uword         fteardown_count;
   bl_uword         teardown_count;
   sim_dealloc_data dealloc;
+  bl_uword         dealloc_batch_calls;
   bl_timeoft32       bl_timept32_diff;
+  bl_uword         arena_commits;
+  bl_uword         arena_discarded;
 }
 basic_tests_ctx;
 /*---------------------------------------------------------------------------*/
@@ -38,6 +44,28 @@ static const bl_u8    fiber_match           = 0xdd;
 static const bl_u8    fiber_resp            = 0xee;
 static const bl_uword queue_timeout_us      = 1000;
 static const bl_uword queue_timeout_long_us = 150000;
+/*small queues, so the group input log wraps around many times*/
+enum {
+  input_log_queue_size = 8, input_log_messages = 200, input_log_chunk = 4
+};
+/*each fiber answers with the address of the input value on its own table*/
+static bl_u8 input_log_echo[2][input_log_messages];
+/*more consumers than what an 8-bit reference count can represent*/
+enum { broadcast_fibers = 300 };
+/*a reservation that would be very expensive if committed upfront*/
+enum { lazy_stack_fibers = 64, lazy_stack_size = 16 * 1024 * 1024 };
+enum { shared_stack_fibers = 300 };
+enum { stackless_fibers = 300 };
+enum { spawn_messages = 4 };
+enum { multicast_groups = 3 };
+enum { merge_ahead_us = 3000 };
+/*more small bytestreams than what their pool class keeps*/
+enum { pool_burst = 8192 };
+/*the reservations are twice the committed size, the messages wrap around*/
+enum { arena_size = 256, arena_msg_size = 40, arena_messages = 8 };
+/*many times the capacity of the output queue*/
+enum { backpressure_queue_size = 4, backpressure_messages = 64 };
+static bl_u8 backpressure_payload[backpressure_messages];
 /*---------------------------------------------------------------------------*/
 static basic_tests_ctx g_ctx;
 static sim_env         g_env;
@@ -83,6 +111,172 @@ static void fiber_to_test_the_queue(
   }
 }
 /*---------------------------------------------------------------------------*/
+static void fiber_to_test_shared_stack(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  /*the pattern is on the fiber stack: the scheduler has to match it while
+    other fibers are using the shared stack*/
+  bl_u8     pattern = fiber_match;
+  bl_memr16 match   = bl_memr16_rv ((void*) &pattern, 1);
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    assert_true (*bl_memr16_beg_as (in, bl_u8) == fiber_match);
+    ssc_drop_input_head (h);
+    ssc_produce_dynamic_output (h, bl_memr16_rv ((void*) &fiber_resp, 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static bool stackless_on_input(
+  ssc_handle h, bl_memr16 in, void* fiber_context, void* sim_context
+  )
+{
+  assert_true (sim_context == (void*) &g_env);
+  assert_true (fiber_context == (void*) &g_ctx);
+  assert_true (bl_memr16_size (in) == 1);
+  assert_true (*bl_memr16_beg_as (in, bl_u8) == fiber_match);
+  ssc_produce_dynamic_output (h, bl_memr16_rv ((void*) &fiber_resp, 1));
+  return true; /*the head is dropped by the scheduler*/
+}
+/*---------------------------------------------------------------------------*/
+static bool stackless_on_timeout(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  assert_true (sim_context == (void*) &g_env);
+  assert_true (fiber_context == (void*) &g_ctx);
+  ssc_produce_dynamic_output (h, bl_memr16_rv ((void*) &fiber_resp, 1));
+  return false; /*finished*/
+}
+/*---------------------------------------------------------------------------*/
+static void spawned_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  assert_true (sim_context == (void*) &g_env);
+  assert_true (fiber_context == (void*) &g_ctx);
+  ssc_produce_dynamic_output (h, bl_memr16_rv ((void*) &fiber_resp, 1));
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_spawn(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  /*a fiber per request*/
+  bl_memr16 match = bl_memr16_rv ((void*) &fiber_match, 1);
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    ssc_fiber_cfg cfg = ssc_fiber_cfg_rv(
+      0, spawned_fiber, test_fiber_setup, test_fiber_teardown, &g_ctx
+      );
+    cfg.min_stack_size = 16 * 1024;
+    /*a bigger queue than what the group input log was sized for*/
+    bl_uword queue_size = cfg.min_queue_size;
+    cfg.min_queue_size  = queue_size * 16;
+    bl_err err = ssc_spawn_fiber (h, &cfg);
+    assert_true (err.own == bl_invalid);
+    cfg.min_queue_size = queue_size;
+    err = ssc_spawn_fiber (h, &cfg);
+    assert_true (!err.own);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_merge(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  /*group 0 runs ahead of time, its output has to be read after group 1's*/
+  if (fiber_context) {
+    ssc_delay (h, merge_ahead_us);
+  }
+  ssc_produce_static_output (h, bl_memr16_rv ((void*) &fiber_resp, 1));
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_arena(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  bl_memr16 match = bl_memr16_rv ((void*) &fiber_match, 1);
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    bl_u8* out = (bl_u8*) ssc_output_reserve (h, arena_msg_size * 2);
+    assert_non_null (out);
+    memset (out, fiber_resp, arena_msg_size);
+    bl_err err = ssc_output_commit (h, arena_msg_size);
+    assert_true (!err.own);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_arena_owner(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  /*the other fiber of the group reserves while this one is suspended*/
+  basic_tests_ctx* c = (basic_tests_ctx*) fiber_context;
+  bl_u8* out = (bl_u8*) ssc_output_reserve (h, arena_msg_size);
+  assert_non_null (out);
+  memset (out, fiber_resp, arena_msg_size);
+  ssc_yield (h);
+  bl_err err = ssc_output_commit (h, arena_msg_size);
+  if (err.own) {
+    assert_true (err.own == bl_invalid);
+    ++c->arena_discarded;
+    return;
+  }
+  ++c->arena_commits;
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_backpressure(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  bl_memr16 match = bl_memr16_rv ((void*) &fiber_match, 1);
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    for (bl_uword i = 0; i < backpressure_messages; ++i) {
+      ssc_produce_static_output(
+        h, bl_memr16_rv ((void*) &backpressure_payload[i], 1)
+        );
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_backpressure_shared(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  bl_memr16 match = bl_memr16_rv ((void*) &fiber_match, 1);
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    for (bl_uword i = 0; i < backpressure_messages; ++i) {
+      ssc_produce_dynamic_output(
+        h, bl_memr16_rv ((void*) &backpressure_payload[i], 1)
+        );
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void fiber_to_test_input_log(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  bl_u8 const* echo = (bl_u8 const*) fiber_context;
+  while (1) {
+    bl_memr16 in = ssc_peek_input_head (h);
+    assert_true (!bl_memr16_is_null (in));
+    bl_u8 v = *bl_memr16_beg_as (in, bl_u8);
+    ssc_drop_input_head (h);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &echo[v], 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void fiber_to_test_queue_timeout(
   ssc_handle h, void* fiber_context, void* sim_context
   )
@@ -176,11 +370,23 @@ static void sim_dealloc_test(
   ctx->dealloc.size = size;
   ctx->dealloc.id   = id;
 }
+/*----------------------------------------------------------------------------*/
+static void sim_dealloc_batch_test(
+  ssc_output_data const* d, bl_uword count, void* sim_context
+  )
+{
+  assert_true (sim_context == (void*) &g_env);
+  basic_tests_ctx* ctx = (basic_tests_ctx*) ((sim_env*) (sim_context))->ctx;
+  ++ctx->dealloc_batch_calls;
+  for (bl_uword i = 0; i < count; ++i) {
+    assert_true (ssc_output_is_dynamic (&d[i]));
+  }
+}
 /*---------------------------------------------------------------------------*/
 /*Tests*/
 /*---------------------------------------------------------------------------*/
-static void generic_test_setup(
-  void **state, ssc_fiber_cfg* fibers, bl_uword fibers_count
+static void generic_test_setup_cfg(
+  void **state, ssc_fiber_cfg* fibers, bl_uword fibers_count, ssc_cfg* cfg
   )
 {
   memset (&g_ctx, 0, sizeof g_ctx);
@@ -192,11 +398,20 @@ static void generic_test_setup(
   g_env.dealloc   = sim_dealloc_test;
   g_env.teardown  = sim_on_teardown_test;
 
-  bl_err err = ssc_create (&g_ctx.sim, "", &g_env);
+  bl_err err = ssc_create_with_cfg (&g_ctx.sim, "", &g_env, cfg);
   assert_true (!err.own);
   *state = (void*) &g_ctx;
 }
 /*---------------------------------------------------------------------------*/
+static void generic_test_setup(
+  void **state, ssc_fiber_cfg* fibers, bl_uword fibers_count
+  )
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  generic_test_setup_cfg (state, fibers, fibers_count, &cfg);
+}
+/*---------------------------------------------------------------------------*/
 /* Basic test */
 /*---------------------------------------------------------------------------*/
 static int queue_test_setup (void **state)
@@ -209,6 +424,46 @@ static int queue_test_setup (void **state)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+static int inline_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.inline_input_size = 32;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int dealloc_batch_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  g_env.dealloc_batch = sim_dealloc_batch_test;
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  g_env.dealloc_batch = nullptr; /*already registered*/
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+#ifdef __linux__
+static int pollfds_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.pollable_fds = true;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+#endif
+/*---------------------------------------------------------------------------*/
 static int queue_timeout_test_setup (void **state)
 {
   ssc_fiber_cfg fibers[1];
@@ -247,6 +502,219 @@ static int delay_test_setup (void **state)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+static int broadcast_test_setup (void **state)
+{
+  static ssc_fiber_cfg fibers[broadcast_fibers];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+      );
+    fibers[i].min_stack_size = 16 * 1024;
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int lazy_stack_test_setup (void **state)
+{
+  static ssc_fiber_cfg fibers[lazy_stack_fibers];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+      );
+    fibers[i].min_stack_size    = lazy_stack_size;
+    fibers[i].run_cfg.run_flags =
+      fiber_set_lazy_stack (fibers[i].run_cfg.run_flags);
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int shared_stack_test_setup (void **state)
+{
+  static ssc_fiber_cfg fibers[shared_stack_fibers];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0,
+      fiber_to_test_shared_stack,
+      test_fiber_setup,
+      test_fiber_teardown,
+      &g_ctx
+      );
+    fibers[i].run_cfg.run_flags =
+      fiber_set_shared_stack (fibers[i].run_cfg.run_flags);
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int stackless_test_setup (void **state)
+{
+  /*mixed with regular fibers on the same group*/
+  static ssc_fiber_cfg fibers[stackless_fibers];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    if (i & 1) {
+      fibers[i] = ssc_fiber_cfg_rv(
+        0,
+        fiber_to_test_the_queue,
+        test_fiber_setup,
+        test_fiber_teardown,
+        &g_ctx
+        );
+      fibers[i].min_stack_size = 16 * 1024;
+      continue;
+    }
+    fibers[i] = ssc_fiber_cfg_callbacks_rv(
+      0,
+      stackless_on_input,
+      nullptr,
+      test_fiber_setup,
+      test_fiber_teardown,
+      &g_ctx
+      );
+    fibers[i].callbacks.match = bl_memr16_rv ((void*) &fiber_match, 1);
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int stackless_timeout_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_callbacks_rv(
+    0,
+    stackless_on_input,
+    stackless_on_timeout,
+    test_fiber_setup,
+    test_fiber_teardown,
+    &g_ctx
+    );
+  fibers[0].callbacks.match      = bl_memr16_rv ((void*) &fiber_match, 1);
+  fibers[0].callbacks.timeout_us = queue_timeout_us;
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int spawn_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_spawn, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int merge_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[2];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      (ssc_group_id) i,
+      fiber_to_test_merge,
+      nullptr,
+      nullptr,
+      (i == 0) ? (void*) &g_ctx : nullptr
+      );
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int arena_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_arena, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.out_arena_size = arena_size;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int arena_owner_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[2];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0, fiber_to_test_arena_owner, test_fiber_setup, test_fiber_teardown,
+      &g_ctx
+      );
+  }
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.out_arena_size = arena_size;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int backpressure_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_backpressure, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.min_out_queue_size = backpressure_queue_size;
+  cfg.out_backpressure   = true;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int backpressure_shared_stack_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[2];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0,
+      fiber_to_test_backpressure_shared,
+      test_fiber_setup,
+      test_fiber_teardown,
+      &g_ctx
+      );
+    fibers[i].run_cfg.run_flags =
+      fiber_set_shared_stack (fibers[i].run_cfg.run_flags);
+  }
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.min_out_queue_size = backpressure_queue_size;
+  cfg.out_backpressure   = true;
+  generic_test_setup_cfg (state, fibers, bl_arr_elems (fibers), &cfg);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int multicast_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[multicast_groups];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      (ssc_group_id) i,
+      fiber_to_test_the_queue,
+      test_fiber_setup,
+      test_fiber_teardown,
+      &g_ctx
+      );
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int input_log_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[bl_arr_elems (input_log_echo)];
+  for (bl_uword i = 0; i < bl_arr_elems (fibers); ++i) {
+    fibers[i] = ssc_fiber_cfg_rv(
+      0, fiber_to_test_input_log, nullptr, nullptr, input_log_echo[i]
+      );
+    fibers[i].min_queue_size = input_log_queue_size;
+  }
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 static int test_teardown (void **state)
 {
   basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
@@ -352,48 +820,730 @@ static void queue_match_test (void **state)
   assert_true (ctx->teardown_count == 1);
 }
 /*---------------------------------------------------------------------------*/
-static void answer_after_blocking_timeout_test (void **state)
+static void write_batch_test (void **state)
 {
   basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
   bl_err err = ssc_run_setup (ctx->sim);
   assert_true (!err.own);
-  assert_true (ctx->fsetup_count == 1);
 
-  bl_uword count;
-  ssc_output_data read;
-  err = ssc_run_some (ctx->sim, queue_timeout_us * 20);
+  /*two matching messages with a non matching one in between*/
+  bl_u8* send[3];
+  bl_u16 sizes[bl_arr_elems (send)];
+  for (bl_uword i = 0; i < bl_arr_elems (send); ++i) {
+    send[i] = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send[i]);
+    *send[i] = (i == 1) ? fiber_match - 1 : fiber_match;
+    sizes[i] = 1;
+  }
+  err = ssc_write_batch (ctx->sim, 0, send, sizes, bl_arr_elems (send));
   assert_true (!err.own);
-  err = ssc_read (ctx->sim, &count, &read, 1, 0);
-  assert_true (err.own == bl_timeout);
 
-  err = ssc_run_some (ctx->sim, queue_timeout_us * 20);
-  assert_true (!err.own);
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == 2);
 
-  /*checking that the fiber did actually time out and went out of scope*/
-  err = ssc_read (ctx->sim, &count, &read, 1, queue_timeout_us * 20);
-  assert_true (!err.own);
-  assert_true (read.type == ssc_type_dynamic_bytes);
-  assert_true (read.gid == 0);
-  bl_memr16 rd = ssc_output_read_as_bytes (&read);
-  assert_true (!bl_memr16_is_null (rd));
-  assert_true (bl_memr16_size (rd) == 1);
-  assert_true (*bl_memr16_beg_as (rd, bl_u8) == fiber_resp);
+  /*an invalid group frees the bytestreams and fails*/
+  send[0] = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send[0]);
+  err = ssc_write_batch (ctx->sim, 1, send, sizes, 1);
+  assert_true (err.own == bl_invalid);
 
   err = ssc_run_teardown (ctx->sim);
   assert_true (!err.own);
-  assert_true (ctx->teardown_count == 1);
 }
 /*---------------------------------------------------------------------------*/
-static void timeout_correctly_cancelled_test (void **state)
+static void output_merge_test (void **state)
 {
   basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
   bl_err err = ssc_run_setup (ctx->sim);
   assert_true (!err.own);
-  assert_true (ctx->fsetup_count == 1);
-
-  bl_uword count;
-  ssc_output_data read;
-
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+  }
+  while (err.own != bl_nothing_to_do);
+
+  /*each group has its own output lane, they are merged by time on read*/
+  ssc_output_data read[2];
+  for (bl_uword i = 0; i < bl_arr_elems (read); ++i) {
+    bl_uword count;
+    err = ssc_read (ctx->sim, &count, &read[i], 1, merge_ahead_us * 10);
+    assert_true (!err.own && count == 1);
+  }
+  assert_true (read[0].gid == 1 && read[1].gid == 0);
+  assert_true (bl_timept32_get_diff (read[1].time, read[0].time) > 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void output_arena_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*more messages than what fits on the arena: it only works if the memory
+    of the deallocated ones is reclaimed*/
+  for (bl_uword msg = 0; msg < arena_messages; ++msg) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = fiber_match;
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+
+    bl_uword        count = 0;
+    ssc_output_data read;
+    while (count == 0) {
+      (void) ssc_try_run_some (ctx->sim);
+      err = ssc_read (ctx->sim, &count, &read, 1, 0);
+      assert_true (!err.own || err.own == bl_timeout);
+    }
+    assert_true (read.type == ssc_type_arena_bytes);
+    assert_true (ssc_output_is_bytes (&read));
+    assert_true (bl_memr16_size (read.data) == arena_msg_size);
+    for (bl_uword i = 0; i < arena_msg_size; ++i) {
+      assert_true (bl_memr16_beg_as (read.data, bl_u8)[i] == fiber_resp);
+    }
+    ssc_dealloc_read_data (ctx->sim, &read);
+  }
+  /*no simulation deallocation callback involved*/
+  assert_true (ctx->dealloc.count == 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void output_arena_owner_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (read.type == ssc_type_arena_bytes);
+      assert_true (bl_memr16_size (read.data) == arena_msg_size);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  /*the first reservation was taken over by the second fiber*/
+  assert_true (ctx->arena_commits == 1);
+  assert_true (ctx->arena_discarded == 1);
+  assert_true (received == 1);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void backpressure_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+
+  /*the fiber waits for room instead of dropping: everything arrives and in
+    production order*/
+  bl_uword received = 0;
+  while (received < backpressure_messages) {
+    bl_uword        count = 0;
+    ssc_output_data read;
+    (void) ssc_try_run_some (ctx->sim);
+    err = ssc_read (ctx->sim, &count, &read, 1, 0);
+    assert_true (!err.own || err.own == bl_timeout);
+    if (count == 0) {
+      continue;
+    }
+    assert_true (ssc_output_is_bytes (&read));
+    assert_true (bl_memr16_beg (read.data) == &backpressure_payload[received]);
+    ssc_dealloc_read_data (ctx->sim, &read);
+    ++received;
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void backpressure_shared_stack_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  /*nothing is read: both fibers end up waiting for room, each one after
+    the other used the shared stack*/
+  for (bl_uword i = 0; i < 8; ++i) {
+    (void) ssc_try_run_some (ctx->sim);
+  }
+  assert_true (ctx->dealloc.count == 0);
+
+  /*the outputs that they were waiting to send are deallocated on teardown*/
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->dealloc.count == 2);
+  assert_true (ctx->dealloc.size == 1);
+  assert_true (ctx->dealloc.id == 0);
+  assert_true (
+    (bl_u8 const*) ctx->dealloc.mem >= &backpressure_payload[0] &&
+    (bl_u8 const*) ctx->dealloc.mem <
+      &backpressure_payload[backpressure_messages]
+    );
+}
+/*---------------------------------------------------------------------------*/
+static void read_timeout_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*nothing produced: the reader sleeps for the whole timeout*/
+  bl_uword        count;
+  ssc_output_data read;
+  bl_timept32     start = bl_timept32_get();
+  err = ssc_read (ctx->sim, &count, &read, 1, queue_timeout_us);
+  bl_timept32 end = bl_timept32_get();
+  assert_true (err.own == bl_timeout);
+  assert_true (count == 0);
+  assert_true (bl_timept32_to_usec (end - start) >= queue_timeout_us);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+#ifdef __linux__
+static bool fd_is_readable (int fd, int timeout_ms)
+{
+  struct pollfd p;
+  p.fd      = fd;
+  p.events  = POLLIN;
+  p.revents = 0;
+  return poll (&p, 1, timeout_ms) == 1 && (p.revents & POLLIN);
+}
+/*---------------------------------------------------------------------------*/
+static void pollfds_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  int run_fd, read_fd;
+  err = ssc_get_pollfds (ctx->sim, &run_fd, &read_fd);
+  assert_true (!err.own);
+
+  /*driving the simulation only when the fds say so*/
+  assert_true (fd_is_readable (run_fd, 0));
+  while (ssc_try_run_some (ctx->sim).own != bl_nothing_to_do) {}
+  assert_true (!fd_is_readable (run_fd, 0));
+
+  bl_uword        count;
+  ssc_output_data read;
+  assert_true (fd_is_readable (read_fd, 0));
+  err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (err.own == bl_timeout);
+  assert_true (!fd_is_readable (read_fd, 0));
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  assert_true (fd_is_readable (run_fd, 0));
+  while (ssc_try_run_some (ctx->sim).own != bl_nothing_to_do) {}
+
+  assert_true (fd_is_readable (read_fd, 1000));
+  err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (!err.own && count == 1);
+  assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+  ssc_dealloc_read_data (ctx->sim, &read);
+  err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (err.own == bl_timeout);
+  assert_true (!fd_is_readable (read_fd, 0));
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static void dealloc_batch_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  ssc_output_data read[3];
+  for (bl_uword i = 0; i < bl_arr_elems (read); ++i) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = fiber_match;
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+  }
+  bl_uword received = 0;
+  while (received < bl_arr_elems (read)) {
+    (void) ssc_try_run_some (ctx->sim);
+    bl_uword count;
+    err = ssc_read(
+      ctx->sim, &count, &read[received], bl_arr_elems (read) - received, 0
+      );
+    assert_true (!err.own || err.own == bl_timeout);
+    received += count;
+  }
+  /*the whole array in a single simulation call*/
+  err = ssc_dealloc_read_data_batch (ctx->sim, read, received);
+  assert_true (!err.own);
+  assert_true (ctx->dealloc_batch_calls == 1);
+  assert_true (ctx->dealloc.count == 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void write_inline_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*the matching messages fit on the queue slots, the non matching one in
+    between is too big and it is allocated*/
+  bl_u8 data[64];
+  memset (data, 0, sizeof data);
+  data[0] = fiber_match;
+  err = ssc_write_inline (ctx->sim, 0, data, 1);
+  assert_true (!err.own);
+  data[0] = fiber_match - 1;
+  err = ssc_write_inline (ctx->sim, 0, data, sizeof data);
+  assert_true (!err.own);
+  data[0] = fiber_match;
+  err = ssc_write_inline (ctx->sim, 0, data, 1);
+  assert_true (!err.own);
+  err = ssc_write_inline (ctx->sim, 1, data, 1);
+  assert_true (err.own == bl_invalid);
+
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == 2);
+
+  /*only the big message used the bytestream pool*/
+  ssc_bstream_pool_stats stats;
+  ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  assert_true (stats.hits + stats.misses == 1);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void write_inline_disabled_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*"inline_input_size" is 0: even a message fitting on the slot padding is
+    allocated*/
+  bl_u8 data = fiber_match;
+  err = ssc_write_inline (ctx->sim, 0, &data, sizeof data);
+  assert_true (!err.own);
+
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == 1);
+
+  ssc_bstream_pool_stats stats;
+  ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  assert_true (stats.hits + stats.misses == 1);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void write_full_queue_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*nothing runs, so the group input queue fills up*/
+  bl_uword written = 0;
+  bl_u8*   send;
+  while (true) {
+    send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = fiber_match;
+    err   = ssc_try_write (ctx->sim, 0, send, 1);
+    if (err.own == bl_would_overflow) {
+      break;
+    }
+    assert_true (!err.own);
+    ++written;
+    assert_true (written <= 1024);
+  }
+  /*the rejected bytestream is still owned, the timed write frees it*/
+  *send = fiber_match;
+  err   = ssc_write_timed (ctx->sim, 0, send, 1, queue_timeout_us);
+  assert_true (err.own == bl_timeout);
+
+  /*the group consumes its input*/
+  err = ssc_try_run_some (ctx->sim);
+  assert_true (!err.own);
+  send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  err   = ssc_write_timed (ctx->sim, 0, send, 1, queue_timeout_us);
+  assert_true (!err.own);
+  ++written;
+
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == written);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static bl_u8* alloc_bstream_list (ssc* sim, bl_uword count)
+{
+  /*linked through their own memory*/
+  bl_u8* list = nullptr;
+  for (bl_uword i = 0; i < count; ++i) {
+    bl_u8* b = ssc_alloc_write_bytestream (sim, sizeof list);
+    assert_non_null (b);
+    memcpy (b, &list, sizeof list);
+    list = b;
+  }
+  return list;
+}
+/*---------------------------------------------------------------------------*/
+static void free_bstream_list (ssc* sim, bl_u8* list)
+{
+  while (list) {
+    bl_u8* next;
+    memcpy (&next, list, sizeof next);
+    /*writing to an invalid group frees the bytestream*/
+    bl_err err = ssc_write (sim, 1, list, 1);
+    assert_true (err.own == bl_invalid);
+    list = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void bstream_pool_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  ssc_bstream_pool_stats stats;
+  err = ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  assert_true (!err.own);
+  assert_true (stats.hits == 0 && stats.misses == 0);
+
+  /*writing to an invalid group frees the bytestream back to the pool*/
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  bl_u8* first = send;
+  err = ssc_write (ctx->sim, 1, send, 1);
+  assert_true (err.own == bl_invalid);
+  send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_true (send == first);
+  ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  assert_true (stats.hits == 1 && stats.misses == 1);
+
+  /*the recycled memory is usable as usual*/
+  *send = fiber_match;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == 1);
+
+  /*big sizes bypass the pool*/
+  send = ssc_alloc_write_bytestream (ctx->sim, 8192);
+  assert_non_null (send);
+  err = ssc_write (ctx->sim, 1, send, 1);
+  assert_true (err.own == bl_invalid);
+  ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  assert_true (stats.hits == 1 && stats.misses == 1);
+  assert_true (stats.released == 0);
+
+  /*the pool keeps a bounded amount of freed bytestreams*/
+  free_bstream_list (ctx->sim, alloc_bstream_list (ctx->sim, pool_burst));
+  ssc_bstream_pool_stats prev;
+  ssc_get_bstream_pool_stats (ctx->sim, &prev);
+  assert_true (prev.released > 0 && prev.released < pool_burst);
+  /*the class is full: the pool serves what it keeps and releases the rest*/
+  free_bstream_list (ctx->sim, alloc_bstream_list (ctx->sim, pool_burst));
+  ssc_get_bstream_pool_stats (ctx->sim, &stats);
+  bl_uword hits     = stats.hits - prev.hits;
+  bl_uword released = stats.released - prev.released;
+  assert_true (hits > 0 && released > 0);
+  assert_true (hits + released == pool_burst);
+  assert_true (stats.misses - prev.misses == released);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void write_multicast_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fsetup_count == multicast_groups);
+
+  ssc_group_id gids[multicast_groups];
+  for (bl_uword i = 0; i < bl_arr_elems (gids); ++i) {
+    gids[i] = (ssc_group_id) i;
+  }
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  bl_uword sent;
+  err = ssc_write_multicast(
+    ctx->sim, gids, bl_arr_elems (gids), send, 1, &sent
+    );
+  assert_true (!err.own);
+  assert_true (sent == multicast_groups);
+
+  bl_uword received = 0;
+  bl_uword groups   = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      groups |= 1 << read.gid;
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == multicast_groups);
+  assert_true (groups == (1 << multicast_groups) - 1);
+
+  /*an invalid group: nothing is sent*/
+  gids[0] = multicast_groups;
+  send    = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  err = ssc_write_multicast(
+    ctx->sim, gids, bl_arr_elems (gids), send, 1, &sent
+    );
+  assert_true (err.own == bl_invalid);
+  assert_true (sent == 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void write_multicast_partial_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*nothing runs, so the input queue of group 1 fills up. The messages don't
+    match, so the fiber doesn't answer them*/
+  bl_u8* send;
+  while (true) {
+    send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = (bl_u8) ~fiber_match;
+    err   = ssc_try_write (ctx->sim, 1, send, 1);
+    if (err.own == bl_would_overflow) {
+      break;
+    }
+    assert_true (!err.own);
+  }
+  err = ssc_write (ctx->sim, 1, send, 1); /*frees the rejected one*/
+  assert_true (err.own == bl_would_overflow);
+
+  ssc_group_id gids[multicast_groups];
+  for (bl_uword i = 0; i < bl_arr_elems (gids); ++i) {
+    gids[i] = (ssc_group_id) i;
+  }
+  send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber_match;
+  bl_uword sent;
+  err = ssc_write_multicast(
+    ctx->sim, gids, bl_arr_elems (gids), send, 1, &sent
+    );
+  assert_true (err.own == bl_would_overflow);
+  assert_true (sent == 1);
+
+  /*only the groups before the full one received it*/
+  bl_uword received = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    bl_uword        count;
+    ssc_output_data read;
+    while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+      assert_true (read.gid == gids[0]);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  while (err.own != bl_nothing_to_do);
+  assert_true (received == sent);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void input_log_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  /*the fibers of a group share the input log, each one reads every message
+    in order through its own cursor while the slots are reclaimed*/
+  bl_uword next[bl_arr_elems (input_log_echo)] = { 0 };
+  for (bl_uword i = 0; i < input_log_messages; ++i) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = (bl_u8) i;
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+    if ((i + 1) % input_log_chunk != 0) {
+      continue;
+    }
+    do {
+      err = ssc_try_run_some (ctx->sim);
+      assert_true (!err.own || err.own == bl_nothing_to_do);
+      bl_uword        count;
+      ssc_output_data read;
+      while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+        bl_u8 const* echo = bl_memr16_beg_as (read.data, bl_u8);
+        bl_uword f        = (echo >= input_log_echo[1]) ? 1 : 0;
+        assert_true (echo == &input_log_echo[f][next[f]]);
+        ++next[f];
+        ssc_dealloc_read_data (ctx->sim, &read);
+      }
+    }
+    while (err.own != bl_nothing_to_do);
+    assert_true (next[0] == i + 1 && next[1] == i + 1);
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void answer_after_blocking_timeout_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fsetup_count == 1);
+
+  bl_uword count;
+  ssc_output_data read;
+  err = ssc_run_some (ctx->sim, queue_timeout_us * 20);
+  assert_true (!err.own);
+  err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (err.own == bl_timeout);
+
+  err = ssc_run_some (ctx->sim, queue_timeout_us * 20);
+  assert_true (!err.own);
+
+  /*checking that the fiber did actually time out and went out of scope*/
+  err = ssc_read (ctx->sim, &count, &read, 1, queue_timeout_us * 20);
+  assert_true (!err.own);
+  assert_true (read.type == ssc_type_dynamic_bytes);
+  assert_true (read.gid == 0);
+  bl_memr16 rd = ssc_output_read_as_bytes (&read);
+  assert_true (!bl_memr16_is_null (rd));
+  assert_true (bl_memr16_size (rd) == 1);
+  assert_true (*bl_memr16_beg_as (rd, bl_u8) == fiber_resp);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->teardown_count == 1);
+}
+/*---------------------------------------------------------------------------*/
+static void timeout_correctly_cancelled_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fsetup_count == 1);
+
+  bl_uword count;
+  ssc_output_data read;
+
   err = ssc_try_run_some (ctx->sim);
   assert_true (!err.own); /*fiber blocked on queue with timeout active*/
 
@@ -468,13 +1618,188 @@ static void delay_test (void **state)
   assert_true (ctx->teardown_count == 1);
 }
 /*---------------------------------------------------------------------------*/
+static void run_broadcast (basic_tests_ctx* ctx, bl_uword fibers)
+{
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fsetup_count == fibers);
+
+  for (bl_uword msg = 0; msg < 2; ++msg) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = fiber_match;
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+
+    bl_uword received = 0;
+    while (received < fibers) {
+      (void) ssc_try_run_some (ctx->sim);
+      bl_uword        count;
+      ssc_output_data read;
+      err = ssc_read (ctx->sim, &count, &read, 1, 0);
+      if (err.own == bl_timeout) {
+        continue;
+      }
+      assert_true (!err.own);
+      assert_true (count == 1);
+      assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+      ssc_dealloc_read_data (ctx->sim, &read);
+      ++received;
+    }
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fteardown_count == fibers);
+}
+/*---------------------------------------------------------------------------*/
+static void broadcast_test (void **state)
+{
+  run_broadcast ((basic_tests_ctx*) *state, broadcast_fibers);
+}
+/*---------------------------------------------------------------------------*/
+static void lazy_stack_test (void **state)
+{
+  run_broadcast ((basic_tests_ctx*) *state, lazy_stack_fibers);
+}
+/*---------------------------------------------------------------------------*/
+static void shared_stack_test (void **state)
+{
+  run_broadcast ((basic_tests_ctx*) *state, shared_stack_fibers);
+}
+/*---------------------------------------------------------------------------*/
+static void stackless_test (void **state)
+{
+  run_broadcast ((basic_tests_ctx*) *state, stackless_fibers);
+}
+/*---------------------------------------------------------------------------*/
+static void spawn_test (void **state)
+{
+  basic_tests_ctx* ctx = (basic_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fsetup_count == 1);
+
+  for (bl_uword msg = 0; msg < spawn_messages; ++msg) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = fiber_match;
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+
+    bl_uword        count = 0;
+    ssc_output_data read;
+    while (count == 0) {
+      (void) ssc_try_run_some (ctx->sim);
+      err = ssc_read (ctx->sim, &count, &read, 1, 0);
+      assert_true (!err.own || err.own == bl_timeout);
+    }
+    assert_true (*bl_memr16_beg_as (read.data, bl_u8) == fiber_resp);
+    ssc_dealloc_read_data (ctx->sim, &read);
+    /*the spawned fiber finished after producing: torn down and recycled*/
+    assert_true (ctx->fsetup_count == msg + 2);
+    assert_true (ctx->fteardown_count == msg + 1);
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+  assert_true (ctx->fteardown_count == spawn_messages + 1);
+}
+/*---------------------------------------------------------------------------*/
+static bl_err create_with_run_flags (bl_u8 run_flags)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, fiber_to_test_the_queue, test_fiber_setup, test_fiber_teardown, &g_ctx
+    );
+  fibers[0].run_cfg.run_flags = run_flags;
+  memset (&g_ctx, 0, sizeof g_ctx);
+  g_env.cfg       = fibers;
+  g_env.cfg_count = bl_arr_elems (fibers);
+  g_env.ctx       = &g_ctx;
+  g_env.dealloc   = sim_dealloc_test;
+  g_env.teardown  = sim_on_teardown_test;
+
+  bl_err err = ssc_create (&g_ctx.sim, "", &g_env);
+  if (!err.own) {
+    ssc_destroy (g_ctx.sim);
+  }
+  return err;
+}
+/*---------------------------------------------------------------------------*/
+static void run_flags_test (void **state)
+{
+  /*every public flag is accepted by "ssc_add_fiber", the next bit isn't*/
+  for (bl_uword i = 0; i <= ssc_fiber_flags_biggest; ++i) {
+    assert_true (!create_with_run_flags (bl_u8_bit (i)).own);
+  }
+  bl_err err = create_with_run_flags (bl_u8_bit (ssc_fiber_flags_biggest + 1));
+  assert_true (err.own == bl_invalid);
+  /*combined: the shared stack takes precedence over the lazy one*/
+  err = create_with_run_flags(
+    fiber_set_shared_stack (fiber_set_lazy_stack (fiber_set_produce_only (0)))
+    );
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
 static const struct CMUnitTest tests[] = {
+  cmocka_unit_test (run_flags_test),
   cmocka_unit_test_setup_teardown(
     queue_no_match_test, queue_test_setup, test_teardown
     ),
   cmocka_unit_test_setup_teardown(
     queue_match_test, queue_test_setup, test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    input_log_test, input_log_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    write_batch_test, queue_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    bstream_pool_test, queue_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    write_full_queue_test, queue_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    write_inline_test, inline_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    write_inline_disabled_test, queue_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    output_merge_test, merge_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    output_arena_test, arena_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    output_arena_owner_test, arena_owner_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    dealloc_batch_test, dealloc_batch_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    backpressure_test, backpressure_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    backpressure_shared_stack_test,
+    backpressure_shared_stack_test_setup,
+    test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    read_timeout_test, queue_test_setup, test_teardown
+    ),
+#ifdef __linux__
+  cmocka_unit_test_setup_teardown(
+    pollfds_test, pollfds_test_setup, test_teardown
+    ),
+#endif
+  cmocka_unit_test_setup_teardown(
+    write_multicast_test, multicast_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    write_multicast_partial_test, multicast_test_setup, test_teardown
+    ),
   cmocka_unit_test_setup_teardown(
     answer_after_blocking_timeout_test, queue_timeout_test_setup, test_teardown
     ),
@@ -486,6 +1811,26 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     delay_test, delay_test_setup, test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    broadcast_test, broadcast_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    lazy_stack_test, lazy_stack_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    shared_stack_test, shared_stack_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    stackless_test, stackless_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    answer_after_blocking_timeout_test,
+    stackless_timeout_test_setup,
+    test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    spawn_test, spawn_test_setup, test_teardown
+    ),
 };
 /*---------------------------------------------------------------------------*/
 int basic_tests (void)
@@ -11,6 +11,12 @@ bl_err ssc_sim_on_setup(
 {
   sim_env* env             = passed_data;
   ssc_fiber_cfg const* cfg = env->cfg;
+  if (env->dealloc_batch) {
+    bl_err err = ssc_set_dealloc_batch (h, env->dealloc_batch);
+    if (err.own) {
+      return err;
+    }
+  }
   for (bl_uword i = 0; i < env->cfg_count; ++i) {
     bl_err err = ssc_add_fiber (h, cfg);
     if (err.own) {
@@ -17,6 +17,7 @@ typedef struct sim_env {
   bl_uword                          cfg_count;
   bl_uword                          context_switch_count;
   ssc_sim_env_dealloc_signature     dealloc;
+  ssc_sim_dealloc_batch_func        dealloc_batch; /*optional*/
   ssc_sim_env_on_teardown_signature teardown;
   void*                             ctx;
 }
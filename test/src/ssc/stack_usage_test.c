@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <bl/base/utility.h>
+
+#include <ssc/simulation/simulation.h>
+#include <ssc/simulator/simulator.h>
+
+#include <ssc/simulation_environment.h>
+
+#include <ssc/cmocka_pre.h>
+
+/*Fiber stack high-water-mark measurement and stack profiles*/
+/*---------------------------------------------------------------------------*/
+typedef struct stack_tests_ctx {
+  ssc* sim;
+}
+stack_tests_ctx;
+/*---------------------------------------------------------------------------*/
+/*TRANSLATION UNIT GLOBALS*/
+/*---------------------------------------------------------------------------*/
+enum {
+  heavy_stack_use = 32 * 1024,
+  fiber_count     = 2,
+};
+static char const profile_path[] = "ssc_stack_usage_test.profile";
+/*---------------------------------------------------------------------------*/
+static stack_tests_ctx g_ctx;
+static sim_env         g_env;
+static ssc_fiber_cfg   g_fibers[fiber_count];
+/*---------------------------------------------------------------------------*/
+/*SIMULATION*/
+/*---------------------------------------------------------------------------*/
+static void sim_on_teardown_test (void* sim_context)
+{
+  /*tested on basic_test*/
+}
+/*----------------------------------------------------------------------------*/
+static void sim_dealloc_test(
+  void const* mem, bl_uword size, ssc_group_id id, void* sim_context
+  )
+{
+  /*tested on basic_test*/
+}
+/*---------------------------------------------------------------------------*/
+static void light_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  while (true) {
+    (void) ssc_peek_input_head (h);
+    ssc_drop_input_head (h);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void heavy_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  volatile bl_u8 buffer[heavy_stack_use];
+  for (bl_uword i = 0; i < sizeof buffer; ++i) {
+    buffer[i] = (bl_u8) i;
+  }
+  light_fiber (h, fiber_context, sim_context);
+}
+/*---------------------------------------------------------------------------*/
+static void use_stack (void)
+{
+  volatile bl_u8 buffer[heavy_stack_use];
+  for (bl_uword i = 0; i < sizeof buffer; ++i) {
+    buffer[i] = (bl_u8) i;
+  }
+}
+static void (*volatile use_stack_call)(void) = use_stack;
+/*---------------------------------------------------------------------------*/
+static void returning_heavy_fiber(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  /*the stack is back to its minimum when the fiber blocks*/
+  use_stack_call();
+  light_fiber (h, fiber_context, sim_context);
+}
+/*---------------------------------------------------------------------------*/
+static void spawner_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  ssc_fiber_cfg cfg = ssc_fiber_cfg_rv(
+    0, heavy_fiber, nullptr, nullptr, nullptr
+    );
+  cfg.min_stack_size = heavy_stack_use * 2;
+  bl_err err = ssc_spawn_fiber (h, &cfg);
+  assert_true (!err.own);
+  light_fiber (h, fiber_context, sim_context);
+}
+/*---------------------------------------------------------------------------*/
+/*Tests*/
+/*---------------------------------------------------------------------------*/
+static void create_sim_with_fibers(
+  ssc_cfg const* cfg, ssc_fiber_func light, ssc_fiber_func heavy, bl_u8 flags
+  )
+{
+  g_fibers[0] = ssc_fiber_cfg_rv (0, light, nullptr, nullptr, nullptr);
+  g_fibers[1] = ssc_fiber_cfg_rv (0, heavy, nullptr, nullptr, nullptr);
+  g_fibers[0].run_cfg.run_flags = flags;
+  g_fibers[1].run_cfg.run_flags = flags;
+  memset (&g_ctx, 0, sizeof g_ctx);
+
+  g_env.cfg       = g_fibers;
+  g_env.cfg_count = bl_arr_elems (g_fibers);
+  g_env.ctx       = &g_ctx; /*this will become sim_context*/
+  g_env.dealloc   = sim_dealloc_test;
+  g_env.teardown  = sim_on_teardown_test;
+
+  bl_err err = ssc_create_with_cfg (&g_ctx.sim, "", &g_env, cfg);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void create_sim (ssc_cfg const* cfg)
+{
+  create_sim_with_fibers (cfg, light_fiber, heavy_fiber, 0);
+}
+/*---------------------------------------------------------------------------*/
+static void run_fibers (stack_tests_ctx* ctx)
+{
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  bl_uword runs = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    ++runs;
+    assert_true (runs < 1000);
+  }
+  while (err.own != bl_nothing_to_do);
+}
+/*---------------------------------------------------------------------------*/
+static int measure_test_setup (void **state)
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.measure_stacks = true;
+  create_sim (&cfg);
+  *state = (void*) &g_ctx;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int no_setup (void **state)
+{
+  /*the sim is created inside the test*/
+  *state = nullptr;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int test_teardown (void **state)
+{
+  stack_tests_ctx* ctx = (stack_tests_ctx*) *state;
+  if (!ctx) {
+    return 1;
+  }
+  ssc_destroy (ctx->sim);
+  remove (profile_path);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void measure_test (void **state)
+{
+  stack_tests_ctx* ctx = (stack_tests_ctx*) *state;
+  run_fibers (ctx);
+
+  ssc_fiber_stack_usage u[fiber_count];
+  bl_uword count;
+  bl_err err = ssc_get_stack_usage (ctx->sim, nullptr, 0, &count);
+  assert_true (!err.own);
+  assert_true (count == fiber_count);
+  err = ssc_get_stack_usage (ctx->sim, u, bl_arr_elems (u), &count);
+  assert_true (!err.own);
+  assert_true (count == fiber_count);
+  for (bl_uword i = 0; i < fiber_count; ++i) {
+    assert_true (u[i].group == 0);
+    assert_true (u[i].fiber == i);
+    assert_true (u[i].size >= g_fibers[i].min_stack_size);
+    assert_true (u[i].peak > 0 && u[i].peak < u[i].size);
+  }
+  assert_true (u[1].peak >= heavy_stack_use);
+  assert_true (u[0].peak < u[1].peak);
+
+  ssc_stack_usage_stats stats;
+  err = ssc_get_stack_usage_stats (ctx->sim, &stats);
+  assert_true (!err.own);
+  assert_true (stats.fibers == fiber_count);
+  assert_true (stats.size == u[0].size + u[1].size);
+  assert_true (stats.peak == u[0].peak + u[1].peak);
+  assert_true (stats.max_peak == u[1].peak);
+  assert_true (stats.overflows == 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void shared_stack_test (void **state)
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.measure_stacks = true;
+  create_sim_with_fibers(
+    &cfg, light_fiber, returning_heavy_fiber, fiber_set_shared_stack (0)
+    );
+  *state = (void*) &g_ctx;
+  run_fibers (&g_ctx);
+
+  ssc_fiber_stack_usage u[fiber_count];
+  bl_uword count;
+  bl_err err = ssc_get_stack_usage (g_ctx.sim, u, bl_arr_elems (u), &count);
+  assert_true (!err.own);
+  assert_true (count == fiber_count);
+  assert_true (u[0].size == u[1].size);
+  /*measured while suspended, not from the (small) part saved*/
+  assert_true (u[1].peak >= heavy_stack_use);
+  assert_true (u[1].peak < u[1].size);
+  assert_true (u[0].peak > 0 && u[0].peak < u[1].peak);
+
+  err = ssc_run_teardown (g_ctx.sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void spawned_test (void **state)
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.measure_stacks = true;
+  create_sim_with_fibers (&cfg, spawner_fiber, light_fiber, 0);
+  *state = (void*) &g_ctx;
+  run_fibers (&g_ctx);
+
+  ssc_fiber_stack_usage u[fiber_count + 1];
+  bl_uword count;
+  bl_err err = ssc_get_stack_usage (g_ctx.sim, u, bl_arr_elems (u), &count);
+  assert_true (!err.own);
+  assert_true (count == fiber_count + 1);
+  /*after the configured ones*/
+  assert_true (u[fiber_count].group == 0);
+  assert_true (u[fiber_count].fiber == fiber_count);
+  assert_true (u[fiber_count].size >= heavy_stack_use * 2);
+  assert_true (u[fiber_count].peak >= heavy_stack_use);
+  assert_true (u[fiber_count].peak < u[fiber_count].size);
+
+  err = ssc_run_teardown (g_ctx.sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void not_measuring_test (void **state)
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  create_sim (&cfg);
+  *state = (void*) &g_ctx;
+
+  bl_uword count;
+  bl_err err = ssc_get_stack_usage (g_ctx.sim, nullptr, 0, &count);
+  assert_true (err.own == bl_preconditions);
+}
+/*---------------------------------------------------------------------------*/
+static void profile_test (void **state)
+{
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.stack_profile = profile_path;
+  remove (profile_path);
+
+  /*first run: default sizes, the profile is written on destroy*/
+  create_sim (&cfg);
+  run_fibers (&g_ctx);
+  ssc_fiber_stack_usage first[fiber_count];
+  bl_uword count;
+  bl_err err = ssc_get_stack_usage (g_ctx.sim, first, fiber_count, &count);
+  assert_true (!err.own);
+  err = ssc_run_teardown (g_ctx.sim);
+  assert_true (!err.own);
+  err = ssc_destroy (g_ctx.sim);
+  assert_true (!err.own);
+
+  /*second run: the stacks are sized from the profile*/
+  create_sim (&cfg);
+  *state = (void*) &g_ctx;
+  run_fibers (&g_ctx);
+  ssc_fiber_stack_usage second[fiber_count];
+  err = ssc_get_stack_usage (g_ctx.sim, second, fiber_count, &count);
+  assert_true (!err.own);
+  for (bl_uword i = 0; i < fiber_count; ++i) {
+    assert_true (second[i].size >= first[i].peak);
+    assert_true (second[i].peak < second[i].size);
+  }
+  assert_true (second[1].size < first[1].size);
+  err = ssc_run_teardown (g_ctx.sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    measure_test, measure_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    not_measuring_test, no_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown (shared_stack_test, no_setup, test_teardown),
+  cmocka_unit_test_setup_teardown (spawned_test, no_setup, test_teardown),
+  cmocka_unit_test_setup_teardown (profile_test, no_setup, test_teardown),
+};
+/*---------------------------------------------------------------------------*/
+int stack_usage_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*---------------------------------------------------------------------------*/
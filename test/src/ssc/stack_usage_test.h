@@ -0,0 +1,6 @@
+#ifndef __SSC_STACK_USAGE_TEST_H__
+#define __SSC_STACK_USAGE_TEST_H__
+
+extern int stack_usage_tests (void);
+
+#endif
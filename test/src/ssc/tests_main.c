@@ -2,6 +2,9 @@
 #include <ssc/basic_test.h>
 #include <ssc/two_fiber_test.h>
 #include <ssc/ahead_of_time_test.h>
+#include <ssc/threads_test.h>
+#include <ssc/virtual_time_test.h>
+#include <ssc/stack_usage_test.h>
 
 int main (void)
 {
@@ -9,6 +12,9 @@ int main (void)
   if (basic_tests() != 0)     { ++failed; }
   if (two_fiber_tests() != 0) { ++failed; }
   if (ahead_of_time_tests() != 0) { ++failed; }
+  if (threads_tests() != 0) { ++failed; }
+  if (virtual_time_tests() != 0) { ++failed; }
+  if (stack_usage_tests() != 0) { ++failed; }
   printf ("\n[SUITE ERR ] %d suite(s)\n", failed);
   return failed;
 }
@@ -0,0 +1,252 @@
+#include <string.h>
+
+#include <bl/base/utility.h>
+#include <bl/base/time.h>
+
+#include <ssc/simulation/simulation.h>
+#include <ssc/simulator/simulator.h>
+
+#include <ssc/simulation_environment.h>
+
+#include <ssc/cmocka_pre.h>
+
+/*Fiber groups running on worker threads*/
+/*---------------------------------------------------------------------------*/
+typedef struct threads_tests_ctx {
+  ssc* sim;
+}
+threads_tests_ctx;
+/*---------------------------------------------------------------------------*/
+/*TRANSLATION UNIT GLOBALS*/
+/*---------------------------------------------------------------------------*/
+enum { group_count = 4 };
+/*---------------------------------------------------------------------------*/
+static const bl_u8    group_match[group_count] = { 0xa0, 0xa1, 0xa2, 0xa3 };
+static const bl_u8    group_resp[group_count]  = { 0xb0, 0xb1, 0xb2, 0xb3 };
+static const bl_uword read_timeout_us          = 1000000;
+static const bl_uword produce_delay_us         = 20000;
+/*---------------------------------------------------------------------------*/
+static threads_tests_ctx g_ctx;
+static sim_env           g_env;
+/*---------------------------------------------------------------------------*/
+/*SIMULATION*/
+/*---------------------------------------------------------------------------*/
+static void sim_on_teardown_test (void* sim_context)
+{
+  /*tested on basic_test*/
+}
+/*----------------------------------------------------------------------------*/
+static void sim_dealloc_test(
+  void const* mem, bl_uword size, ssc_group_id id, void* sim_context
+  )
+{
+  /*tested on basic_test*/
+}
+/*---------------------------------------------------------------------------*/
+static void echo_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  assert_true (sim_context == (void*) &g_env);
+  bl_uword gid    = (bl_uword) fiber_context;
+  bl_memr16 match = bl_memr16_rv ((void*) &group_match[gid], 1);
+  while (true) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    assert_true (*bl_memr16_beg_as (in, bl_u8) == group_match[gid]);
+    ssc_drop_input_head (h);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &group_resp[gid], 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void delayed_echo_fiber(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  bl_memr16 match = bl_memr16_rv ((void*) &group_match[0], 1);
+  while (true) {
+    bl_memr16 in = ssc_peek_input_head_match (h, match);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    /*the reader is already sleeping when the output is produced*/
+    (void) ssc_wait (h, 0, produce_delay_us);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &group_resp[0], 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*Tests*/
+/*---------------------------------------------------------------------------*/
+static void threads_test_setup_fibers(
+  void **state, ssc_fiber_cfg* fibers, bl_uword fibers_count
+  )
+{
+  memset (&g_ctx, 0, sizeof g_ctx);
+
+  *state          = nullptr;
+  g_env.cfg       = fibers;
+  g_env.cfg_count = fibers_count;
+  g_env.ctx       = &g_ctx; /*this will become sim_context*/
+  g_env.dealloc   = sim_dealloc_test;
+  g_env.teardown  = sim_on_teardown_test;
+
+  bl_err err = ssc_create (&g_ctx.sim, "", &g_env);
+  assert_true (!err.own);
+  *state = (void*) &g_ctx;
+}
+/*---------------------------------------------------------------------------*/
+static int threads_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[group_count];
+  for (bl_uword i = 0; i < group_count; ++i) {
+    fibers[i] = ssc_fiber_cfg_rv (i, echo_fiber, nullptr, nullptr, (void*) i);
+  }
+  threads_test_setup_fibers (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int delayed_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, delayed_echo_fiber, nullptr, nullptr, nullptr
+    );
+  threads_test_setup_fibers (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int test_teardown (void **state)
+{
+  threads_tests_ctx* ctx = (threads_tests_ctx*) *state;
+  if (!ctx) {
+    return 1;
+  }
+  ssc_destroy (ctx->sim);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void all_groups_answer_test (void **state)
+{
+  threads_tests_ctx* ctx = (threads_tests_ctx*) *state;
+  bl_err err = ssc_run_threads (ctx->sim, 2);
+  assert_true (!err.own);
+  /*the simulation is already running from the worker threads*/
+  err = ssc_run_setup (ctx->sim);
+  assert_true (err.own == bl_preconditions);
+
+  for (bl_uword i = 0; i < group_count; ++i) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = group_match[i];
+    err   = ssc_write (ctx->sim, i, send, 1);
+    assert_true (!err.own);
+  }
+  bl_uword received[group_count];
+  memset (received, 0, sizeof received);
+
+  for (bl_uword i = 0; i < group_count; ++i) {
+    bl_uword        count;
+    ssc_output_data read;
+    err = ssc_read (ctx->sim, &count, &read, 1, read_timeout_us);
+    assert_true (!err.own);
+    assert_true (count == 1);
+    assert_true (read.gid < group_count);
+    assert_true (read.type == ssc_type_static_bytes);
+    bl_memr16 rd = ssc_output_read_as_bytes (&read);
+    assert_true (bl_memr16_size (rd) == 1);
+    assert_true (*bl_memr16_beg_as (rd, bl_u8) == group_resp[read.gid]);
+    ++received[read.gid];
+    ssc_dealloc_read_data (ctx->sim, &read);
+  }
+  for (bl_uword i = 0; i < group_count; ++i) {
+    assert_true (received[i] == 1);
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void worker_stats_test (void **state)
+{
+  threads_tests_ctx* ctx = (threads_tests_ctx*) *state;
+  ssc_worker_stats stats;
+  /*no workers yet*/
+  bl_err err = ssc_get_worker_stats (ctx->sim, 0, &stats);
+  assert_true (err.own == bl_invalid);
+
+  err = ssc_run_threads (ctx->sim, 2);
+  assert_true (!err.own);
+  /*skewed traffic: only group 0 gets input*/
+  static const bl_uword msgs = 64;
+  for (bl_uword i = 0; i < msgs; ++i) {
+    bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+    assert_non_null (send);
+    *send = group_match[0];
+    err   = ssc_write (ctx->sim, 0, send, 1);
+    assert_true (!err.own);
+  }
+  for (bl_uword i = 0; i < msgs; ++i) {
+    bl_uword        count;
+    ssc_output_data read;
+    err = ssc_read (ctx->sim, &count, &read, 1, read_timeout_us);
+    assert_true (!err.own);
+    assert_true (count == 1);
+    assert_true (read.gid == 0);
+    ssc_dealloc_read_data (ctx->sim, &read);
+  }
+  bl_uword runs = 0;
+  for (bl_uword i = 0; i < 2; ++i) {
+    err = ssc_get_worker_stats (ctx->sim, i, &stats);
+    assert_true (!err.own);
+    assert_true (stats.steals <= stats.runs);
+    runs += stats.runs;
+  }
+  /*at least the setup run of every group*/
+  assert_true (runs >= group_count);
+  err = ssc_get_worker_stats (ctx->sim, 2, &stats);
+  assert_true (err.own == bl_invalid);
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void read_wakeup_test (void **state)
+{
+  threads_tests_ctx* ctx = (threads_tests_ctx*) *state;
+  bl_err err = ssc_run_threads (ctx->sim, 1);
+  assert_true (!err.own);
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = group_match[0];
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+
+  /*the reader is woken by the production, not by the timeout*/
+  bl_uword        count;
+  ssc_output_data read;
+  bl_timept32     start = bl_timept32_get();
+  err = ssc_read (ctx->sim, &count, &read, 1, read_timeout_us);
+  bl_timept32 end = bl_timept32_get();
+  assert_true (!err.own);
+  assert_true (count == 1);
+  assert_true (read.gid == 0);
+  assert_true (bl_timept32_to_usec (end - start) < read_timeout_us / 2);
+  ssc_dealloc_read_data (ctx->sim, &read);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    all_groups_answer_test, threads_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    worker_stats_test, threads_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    read_wakeup_test, delayed_test_setup, test_teardown
+    ),
+};
+/*---------------------------------------------------------------------------*/
+int threads_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*---------------------------------------------------------------------------*/
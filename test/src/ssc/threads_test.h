@@ -0,0 +1,6 @@
+#ifndef __SSC_THREADS_TEST_H__
+#define __SSC_THREADS_TEST_H__
+
+extern int threads_tests (void);
+
+#endif
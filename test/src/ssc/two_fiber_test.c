@@ -26,6 +26,8 @@ static const bl_u8    fiber1_resp      = 0xdd;
 static const bl_u8    fiber2_match     = 0xee;
 static const bl_u8    fiber2_resp      = 0xff;
 static const bl_uword queue_timeout_us = 1000;
+static const bl_u8    fiber2_mmatch    = 0xe0;
+static const bl_u8    fiber2_mask      = 0xf0;
 /*---------------------------------------------------------------------------*/
 static two_fiber_tests_ctx g_ctx;
 static sim_env             g_env;
@@ -95,6 +97,24 @@ static void queue_output_fiber2(
   }
 }
 /*---------------------------------------------------------------------------*/
+static void queue_output_mask_fiber2(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  assert_true (sim_context == (void*) &g_env);
+
+  bl_memr16 match = bl_memr16_rv ((void*) &fiber2_mmatch, 1);
+  bl_memr16 mask  = bl_memr16_rv ((void*) &fiber2_mask, 1);
+  while (true) {
+    bl_memr16 in = ssc_peek_input_head_match_mask (h, match, mask);
+    assert_true (!bl_memr16_is_null (in));
+    assert_true (bl_memr16_size (in) == 1);
+    assert_true ((*bl_memr16_beg_as (in, bl_u8) & fiber2_mask) == fiber2_mmatch);
+    ssc_drop_input_head (h);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &fiber2_resp, 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
 static void wait_wake_fiber1(
   ssc_handle h, void* fiber_context, void* sim_context
   )
@@ -224,6 +244,66 @@ static void queue_two_fiber_test (void **state)
   assert_true (!err.own);
 }
 /*---------------------------------------------------------------------------*/
+static int queue_match_mask_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[2];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, queue_output_fiber1, nullptr, nullptr, nullptr
+    );
+  fibers[1] = ssc_fiber_cfg_rv(
+    0, queue_output_mask_fiber2, nullptr, nullptr, nullptr
+    );
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void queue_match_mask_test (void **state)
+{
+  /*fiber 1 matches a full first byte (indexed), fiber 2 a partially masked
+    one (scanned). Both have to receive their messages only, even when they
+    arrive on the same batch as non matching ones.*/
+  static const bl_u8 msgs[] = { 0x11, 0xe7, 0xcc, 0x0e, 0xcd };
+  two_fiber_tests_ctx* ctx = (two_fiber_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+  err = ssc_try_run_some (ctx->sim);
+  assert_true (!err.own);
+
+  for (bl_uword round = 0; round < 3; ++round) {
+    for (bl_uword i = 0; i < bl_arr_elems (msgs); ++i) {
+      bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+      assert_non_null (send);
+      *send = msgs[i];
+      err   = ssc_write (ctx->sim, 0, send, 1);
+      assert_true (!err.own);
+    }
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own);
+
+    bl_uword resp1 = 0;
+    bl_uword resp2 = 0;
+    for (bl_uword i = 0; i < 2; ++i) {
+      bl_uword count;
+      ssc_output_data read;
+      err = ssc_read (ctx->sim, &count, &read, 1, 0);
+      assert_true (!err.own);
+      bl_memr16 rd = ssc_output_read_as_bytes (&read);
+      assert_true (bl_memr16_size (rd) == 1);
+      resp1 += *bl_memr16_beg_as (rd, bl_u8) == fiber1_resp;
+      resp2 += *bl_memr16_beg_as (rd, bl_u8) == fiber2_resp;
+      ssc_dealloc_read_data (ctx->sim, &read);
+    }
+    assert_true (resp1 == 1);
+    assert_true (resp2 == 1);
+    bl_uword count;
+    ssc_output_data read;
+    err = ssc_read (ctx->sim, &count, &read, 1, 0);
+    assert_true (err.own == bl_timeout);
+  }
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
 static int wait_wake_test_setup (void **state)
 {
   ssc_fiber_cfg fibers[2];
@@ -280,6 +360,69 @@ static void wait_wake_test (void **state)
   assert_true (!err.own);
 }
 /*---------------------------------------------------------------------------*/
+static const bl_uword wake_cancels_timeout_us = 50000;
+/*---------------------------------------------------------------------------*/
+static void wake_cancels_timeout_fiber2(
+  ssc_handle h, void* fiber_context, void* sim_context
+  )
+{
+  assert_true (sim_context == (void*) &g_env);
+
+  bool unexpired = ssc_wait (h, 1, wake_cancels_timeout_us);
+  assert_true (unexpired);
+  ssc_produce_static_output (h, bl_memr16_rv ((void*) &fiber2_resp, 1));
+  /*a leftover timer from the previous wait would wake this one*/
+  ssc_wait (h, 1, 0);
+  ssc_produce_static_output (h, bl_memr16_rv ((void*) &fiber2_resp, 1));
+}
+/*---------------------------------------------------------------------------*/
+static int wake_cancels_timeout_test_setup (void **state)
+{
+  ssc_fiber_cfg fibers[2];
+  fibers[0] = ssc_fiber_cfg_rv(
+    0, wait_wake_fiber1, nullptr, nullptr, nullptr
+    );
+  fibers[1] = ssc_fiber_cfg_rv(
+    0, wake_cancels_timeout_fiber2, nullptr, nullptr, nullptr
+    );
+  generic_test_setup (state, fibers, bl_arr_elems (fibers));
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void wake_cancels_timeout_test (void **state)
+{
+  two_fiber_tests_ctx* ctx = (two_fiber_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_uword count;
+  ssc_output_data read;
+
+  err = ssc_try_run_some (ctx->sim);
+  assert_true (!err.own);
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = fiber1_match;
+  err  = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+  }
+  while (err.own != bl_nothing_to_do);
+  check_has_response (ctx, fiber2_resp, 0);
+
+  /*running past the cancelled timeout*/
+  err = ssc_run_some (ctx->sim, wake_cancels_timeout_us * 3);
+  assert_true (err.own == bl_nothing_to_do || err.own == bl_timeout);
+  err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (err.own == bl_timeout);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
 static const bl_uword select_lowest_next_msgs     = 3;
 static const bl_uword select_lowest_short_timeout = 1000;
 /*---------------------------------------------------------------------------*/
@@ -347,9 +490,15 @@ static const struct CMUnitTest tests[] = {
   cmocka_unit_test_setup_teardown(
     queue_two_fiber_test, queue_two_fiber_test_setup, test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    queue_match_mask_test, queue_match_mask_test_setup, test_teardown
+    ),
   cmocka_unit_test_setup_teardown(
     wait_wake_test, wait_wake_test_setup, test_teardown
     ),
+  cmocka_unit_test_setup_teardown(
+    wake_cancels_timeout_test, wake_cancels_timeout_test_setup, test_teardown
+    ),
   cmocka_unit_test_setup_teardown(
     select_lowest_next_test, select_lowest_next_test_setup, test_teardown
     ),
@@ -0,0 +1,245 @@
+#include <string.h>
+
+#include <bl/base/utility.h>
+#include <bl/base/time.h>
+
+#include <ssc/simulation/simulation.h>
+#include <ssc/simulator/simulator.h>
+
+#include <ssc/simulation_environment.h>
+
+#include <ssc/cmocka_pre.h>
+
+/*Simulations created with "ssc_time_virtual" run as fast as possible*/
+/*---------------------------------------------------------------------------*/
+typedef struct vtime_tests_ctx {
+  ssc* sim;
+}
+vtime_tests_ctx;
+/*---------------------------------------------------------------------------*/
+/*TRANSLATION UNIT GLOBALS*/
+/*---------------------------------------------------------------------------*/
+enum { delay_count = 3 };
+/*many times the capacity of the output queue*/
+enum { burst_queue_size = 4, burst_messages = 64 };
+/*---------------------------------------------------------------------------*/
+static const bl_timeoft32 delay_us      = 10 * 1000000;
+static const bl_u8        delayed_resp  = 0xd0;
+static const bl_u8        input_resp    = 0xd1;
+/*---------------------------------------------------------------------------*/
+static vtime_tests_ctx g_ctx;
+static sim_env         g_env;
+/*---------------------------------------------------------------------------*/
+/*SIMULATION*/
+/*---------------------------------------------------------------------------*/
+static void sim_on_teardown_test (void* sim_context)
+{
+  /*tested on basic_test*/
+}
+/*----------------------------------------------------------------------------*/
+static void sim_dealloc_test(
+  void const* mem, bl_uword size, ssc_group_id id, void* sim_context
+  )
+{
+  /*tested on basic_test*/
+}
+/*---------------------------------------------------------------------------*/
+static void delay_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  for (bl_uword i = 0; i < delay_count; ++i) {
+    ssc_delay (h, delay_us);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &delayed_resp, 1));
+  }
+  while (true) {
+    bl_memr16 in = ssc_peek_input_head (h);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    ssc_produce_static_output (h, bl_memr16_rv ((void*) &input_resp, 1));
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void burst_fiber (ssc_handle h, void* fiber_context, void* sim_context)
+{
+  while (true) {
+    bl_memr16 in = ssc_peek_input_head (h);
+    assert_true (!bl_memr16_is_null (in));
+    ssc_drop_input_head (h);
+    for (bl_uword i = 0; i < burst_messages; ++i) {
+      ssc_produce_static_output (h, bl_memr16_rv ((void*) &input_resp, 1));
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*Tests*/
+/*---------------------------------------------------------------------------*/
+static bl_err vtime_create (ssc_fiber_func f, ssc_cfg* cfg)
+{
+  ssc_fiber_cfg fibers[1];
+  fibers[0] = ssc_fiber_cfg_rv (0, f, nullptr, nullptr, nullptr);
+  memset (&g_ctx, 0, sizeof g_ctx);
+
+  g_env.cfg       = fibers;
+  g_env.cfg_count = bl_arr_elems (fibers);
+  g_env.ctx       = &g_ctx; /*this will become sim_context*/
+  g_env.dealloc   = sim_dealloc_test;
+  g_env.teardown  = sim_on_teardown_test;
+
+  cfg->time_mode = ssc_time_virtual;
+  return ssc_create_with_cfg (&g_ctx.sim, "", &g_env, cfg);
+}
+/*---------------------------------------------------------------------------*/
+static int vtime_test_setup (void **state)
+{
+  *state = nullptr;
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  bl_err err = vtime_create (delay_fiber, &cfg);
+  assert_true (!err.own);
+  *state = (void*) &g_ctx;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int vtime_burst_test_setup (void **state)
+{
+  *state = nullptr;
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.min_out_queue_size = burst_queue_size;
+  bl_err err = vtime_create (burst_fiber, &cfg);
+  assert_true (!err.own);
+  *state = (void*) &g_ctx;
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int test_teardown (void **state)
+{
+  vtime_tests_ctx* ctx = (vtime_tests_ctx*) *state;
+  if (!ctx) {
+    return 1;
+  }
+  ssc_destroy (ctx->sim);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static void run_until_nothing_to_do (vtime_tests_ctx* ctx)
+{
+  bl_err err;
+  bl_uword runs = 0;
+  do {
+    err = ssc_try_run_some (ctx->sim);
+    assert_true (!err.own || err.own == bl_nothing_to_do);
+    ++runs;
+    assert_true (runs < 1000);
+  }
+  while (err.own != bl_nothing_to_do);
+}
+/*---------------------------------------------------------------------------*/
+static bl_timept32 read_response (vtime_tests_ctx* ctx, bl_u8 expected)
+{
+  bl_uword        count;
+  ssc_output_data read;
+  bl_err err = ssc_read (ctx->sim, &count, &read, 1, 0);
+  assert_true (!err.own);
+  assert_true (count == 1);
+  bl_memr16 rd = ssc_output_read_as_bytes (&read);
+  assert_true (bl_memr16_size (rd) == 1);
+  assert_true (*bl_memr16_beg_as (rd, bl_u8) == expected);
+  ssc_dealloc_read_data (ctx->sim, &read);
+  return read.time;
+}
+/*---------------------------------------------------------------------------*/
+static void delays_are_skipped_test (void **state)
+{
+  vtime_tests_ctx* ctx = (vtime_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_timept32 start = bl_timept32_get();
+  run_until_nothing_to_do (ctx);
+  /*30 seconds of simulation time took way less than that*/
+  assert_true (bl_timept32_get_diff (bl_timept32_get(), start) <
+    bl_usec_to_timept32 (delay_us)
+    );
+  bl_timept32 prev = read_response (ctx, delayed_resp);
+  for (bl_uword i = 1; i < delay_count; ++i) {
+    bl_timept32 t = read_response (ctx, delayed_resp);
+    assert_true (bl_timept32_get_diff (t, prev) == bl_usec_to_timept32 (delay_us));
+    prev = t;
+  }
+  /*the input is timestamped with the virtual clock*/
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = 0;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  run_until_nothing_to_do (ctx);
+  bl_timept32 t = read_response (ctx, input_resp);
+  assert_true (bl_timept32_get_diff (t, prev) >= 0);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void no_threads_test (void **state)
+{
+  vtime_tests_ctx* ctx = (vtime_tests_ctx*) *state;
+  bl_err err = ssc_run_threads (ctx->sim, 1);
+  assert_true (err.own == bl_invalid);
+}
+/*---------------------------------------------------------------------------*/
+static void queue_overflow_test (void **state)
+{
+  vtime_tests_ctx* ctx = (vtime_tests_ctx*) *state;
+  bl_err err = ssc_run_setup (ctx->sim);
+  assert_true (!err.own);
+
+  bl_u8* send = ssc_alloc_write_bytestream (ctx->sim, 1);
+  assert_non_null (send);
+  *send = 0;
+  err   = ssc_write (ctx->sim, 0, send, 1);
+  assert_true (!err.own);
+  /*the fiber doesn't wait for room, so the run ends and the excess output
+    is dropped*/
+  run_until_nothing_to_do (ctx);
+  bl_uword        received = 0;
+  bl_uword        count;
+  ssc_output_data read;
+  while (ssc_read (ctx->sim, &count, &read, 1, 0).own == bl_ok) {
+    ssc_dealloc_read_data (ctx->sim, &read);
+    ++received;
+  }
+  assert_true (received > 0 && received < burst_messages);
+
+  err = ssc_run_teardown (ctx->sim);
+  assert_true (!err.own);
+}
+/*---------------------------------------------------------------------------*/
+static void no_backpressure_test (void **state)
+{
+  /*"out_backpressure" could hang the virtual clock, see "ssc_cfg"*/
+  ssc_cfg cfg;
+  ssc_cfg_init (&cfg);
+  cfg.min_out_queue_size = burst_queue_size;
+  cfg.out_backpressure   = true;
+  bl_err err = vtime_create (burst_fiber, &cfg);
+  assert_true (err.own == bl_invalid);
+}
+/*---------------------------------------------------------------------------*/
+static const struct CMUnitTest tests[] = {
+  cmocka_unit_test_setup_teardown(
+    delays_are_skipped_test, vtime_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    no_threads_test, vtime_test_setup, test_teardown
+    ),
+  cmocka_unit_test_setup_teardown(
+    queue_overflow_test, vtime_burst_test_setup, test_teardown
+    ),
+  cmocka_unit_test (no_backpressure_test),
+};
+/*---------------------------------------------------------------------------*/
+int virtual_time_tests (void)
+{
+  return cmocka_run_group_tests (tests, nullptr, nullptr);
+}
+/*---------------------------------------------------------------------------*/
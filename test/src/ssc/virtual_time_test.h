@@ -0,0 +1,6 @@
+#ifndef __SSC_VIRTUAL_TIME_TEST_H__
+#define __SSC_VIRTUAL_TIME_TEST_H__
+
+extern int virtual_time_tests (void);
+
+#endif